@@ -0,0 +1,166 @@
+#include <iostream>
+#include <atomic>
+#include <chrono>
+#include <csignal>
+#include <string>
+#include <thread>
+#include "bandPool.h"
+#include "capturer.h"
+#include "effects.h"
+#include "filterGraph.h"
+#include "frameQueue.h"
+#include "metrics.h"
+#include "postProcessor.h"
+#include "utils.h"
+
+// Однопроцессный конвейер: Capturer, эффект worker и PostProcessor в отдельных потоках.
+// Стадии обмениваются cv::Mat через FrameQueue - без сериализации и сокетов.
+
+static std::atomic<bool> stop_requested(false);
+
+static void onSignal(int)
+{
+    stop_requested = true;
+}
+
+int main()
+{
+    Utils config;
+    config.loadConfig();
+
+    std::shared_ptr<const ConfigSnapshot> settings = config.getConfigSnapshot();
+    int queue_size = settings->pipeline.queue_size;
+    int maxFrames = settings->postprocessor.max_frames;
+    int timeoutDuration = settings->postprocessor.timeout_duration;
+    int reorderHold = settings->postprocessor.reorder_hold_ms;
+    std::string output_dir = settings->postprocessor.output_dir;
+
+    std::cout << "=== Pipeline (single process) ===" << std::endl;
+    std::cout << "Queue size: " << queue_size << std::endl;
+
+    BandPool effect_pool(settings->pipeline.effect_threads); // Полосы кадра в эффекте worker
+    std::cout << "Effect threads: " << effect_pool.getThreads() << std::endl;
+
+    // Параметры эффекта, частота кадров и буфер PostProcessor меняются без перезапуска
+    config.startControl(settings->pipeline.control_port);
+    config.startMetrics("pipeline", settings->pipeline.metrics_port, settings->pipeline.metrics_file);
+
+    Counter& processed_frames = MetricsRegistry::instance().counter("worker_frames_total");
+    Counter& effect_mismatches = MetricsRegistry::instance().counter("worker_effect_mismatch_total");
+    LatencyHistogram& process_time = MetricsRegistry::instance().histogram("worker_process_us");
+    Gauge& captured_depth = MetricsRegistry::instance().gauge("pipeline_captured_queue");
+    Gauge& processed_depth = MetricsRegistry::instance().gauge("pipeline_processed_queue");
+
+    FrameQueue<PipelineFrame> captured(queue_size); // Capturer -> worker
+    FrameQueue<PipelineFrame> processed(queue_size); // worker -> PostProcessor
+
+    std::signal(SIGINT, onSignal);
+    std::signal(SIGTERM, onSignal);
+
+    try
+    {
+        Capturer capturer(captured, config);
+        PostProcessor videoProcessor(maxFrames, timeoutDuration, output_dir, reorderHold);
+        videoProcessor.enableTracing(settings->postprocessor.trace_file, settings->postprocessor.trace_sample_every);
+        videoProcessor.start();
+
+        std::thread capture_thread([&]() {
+            capturer.run();
+            captured.close();
+        });
+
+        std::thread worker_thread([&]() {
+            PipelineFrame item;
+            FilterGraph graph; // Пустой - встроенный эффект
+            uint64_t graph_version = 0;
+            while (captured.pop(item))
+            {
+                std::shared_ptr<const ConfigSnapshot> current = config.getConfigSnapshot();
+                const PipelineConfig& effect = current->pipeline;
+                if (current->version != graph_version)
+                {
+                    graph_version = current->version;
+                    std::string error;
+                    if (graph.configure(effect.graph, error))
+                    {
+                        std::cout << "Filter graph: " << graph.describe() << std::endl;
+                    }
+                    else
+                    {
+                        std::cout << "- [FAIL] Filter graph: " << error << ", keeping " << graph.describe() << std::endl;
+                    }
+                }
+                uint64_t received_us = traceNowUs();
+                item.trace.addSpan(TraceStage::ServerQueue, item.trace.lastEndUs(), received_us);
+                cv::Mat result;
+                {
+                    ScopedTimer timer(process_time);
+                    if (graph.empty())
+                    {
+                        result = applyEffect(item.image, effect.quantization_levels, effect.canny_low,
+                                             effect.canny_high, &effect_pool);
+                    }
+                    else
+                    {
+                        graph.run(item.image, result, &effect_pool);
+                    }
+                }
+                item.trace.addSpan(TraceStage::Effect, received_us, traceNowUs());
+                processed_frames.add();
+                if (graph.empty() && effect.verify_effect_every > 0
+                    && processed_frames.get() % effect.verify_effect_every == 0)
+                {
+                    int differ = verifyEffect(item.image, result, effect.quantization_levels, effect.canny_low,
+                                              effect.canny_high);
+                    if (differ != 0)
+                    {
+                        effect_mismatches.add();
+                        std::cout << "- [FAIL] Effect differs from reference: " << differ << " bytes" << std::endl;
+                    }
+                }
+                if (!processed.push(PipelineFrame{result, item.id, item.trace}))
+                {
+                    break;
+                }
+            }
+            processed.close();
+        });
+
+        std::thread postprocess_thread([&]() {
+            PipelineFrame item;
+            uint64_t applied_version = config.getConfigSnapshot()->version;
+            while (processed.pop(item))
+            {
+                std::shared_ptr<const ConfigSnapshot> current = config.getConfigSnapshot();
+                if (current->version != applied_version)
+                {
+                    applied_version = current->version;
+                    videoProcessor.setBufferSize(current->postprocessor.max_frames);
+                    videoProcessor.setTimeout(current->postprocessor.timeout_duration);
+                    videoProcessor.setReorderHold(current->postprocessor.reorder_hold_ms);
+                }
+                videoProcessor.addFrame(item.image, item.id, item.trace);
+            }
+        });
+
+        while (!stop_requested)
+        {
+            std::this_thread::sleep_for(std::chrono::milliseconds(100));
+            captured_depth.set(captured.size());
+            processed_depth.set(processed.size());
+        }
+
+        std::cout << "Stopping pipeline..." << std::endl;
+        capturer.stop(); // Остальные стадии дочитают очереди и завершатся по close()
+        capture_thread.join();
+        worker_thread.join();
+        postprocess_thread.join();
+        videoProcessor.stop();
+        return 0;
+    }
+    catch (const std::exception& e)
+    {
+        std::cout << "- [FAIL] Pipeline error: " << e.what() << std::endl;
+        return -1;
+    }
+}
@@ -0,0 +1,103 @@
+#include <iostream>
+#include "postProcessor.h"
+#include "utils.h"
+
+int main()
+{
+    std::cout << "real" << std::endl;
+    Utils postprocessor;
+    postprocessor.loadConfig();
+
+    const PostProcessorConfig settings = postprocessor.getConfigSnapshot()->postprocessor;
+    std::string ip = settings.ip;
+    int port = settings.port;
+    std::string output_dir = settings.output_dir;
+    std::string proc_prefix = settings.processed_prefix;
+    std::string bare_prefix = settings.bare_prefix;
+    int maxFrames = settings.max_frames;
+    int timeoutDuration = settings.timeout_duration;
+    int reorderHold = settings.reorder_hold_ms;
+
+    static int image_counter = 1;
+
+    if (!postprocessor.initializeServer(ip, port))
+    {
+        return -1;
+    }
+
+    // Создаем экземпляр PostProcessor с указанием директории для сохранения видео
+    // Буфер на 90 кадров (30 кадров в каждой из 3 частей)
+    // Таймаут 5 секунд
+    // Директория для сохранения видео берется из конфигурации
+    PostProcessor videoProcessor(maxFrames, timeoutDuration, output_dir, reorderHold);
+    videoProcessor.enableTracing(settings.trace_file, settings.trace_sample_every);
+    videoProcessor.start(); // Запускаем постобработчик
+
+    // Размер буфера и таймауты меняются через канал управления без потери накопленных кадров
+    postprocessor.startControl(settings.control_port);
+    postprocessor.startMetrics("postprocessor", settings.metrics_port, settings.metrics_file);
+    uint64_t applied_version = postprocessor.getConfigSnapshot()->version;
+
+    std::cout << "PostProcessor started. Waiting for server..." << std::endl;
+
+    while (true)
+    {
+        std::cout << "\nWaiting for server..." << std::endl;
+
+        // Новые параметры применяются между кадрами
+        std::shared_ptr<const ConfigSnapshot> current = postprocessor.getConfigSnapshot();
+        if (current->version != applied_version)
+        {
+            applied_version = current->version;
+            videoProcessor.setBufferSize(current->postprocessor.max_frames);
+            videoProcessor.setTimeout(current->postprocessor.timeout_duration);
+            videoProcessor.setReorderHold(current->postprocessor.reorder_hold_ms);
+        }
+
+        // Ждем запрос от сервера
+        std::string request = postprocessor.receiveMessage();
+        if (request == "READY")
+        {
+            std::cout << "Server is ready. Receiving images..." << std::endl;
+
+            // Отправляем подтверждение, что готовы получать изображения
+            postprocessor.sendMessage("SEND_FIRST_IMAGE");
+
+            // Получаем первое изображение (обработанное)
+            cv::Mat processed_image = postprocessor.receiveImage();
+            if (!processed_image.empty())
+            {
+                std::string proc_filename = output_dir + proc_prefix + std::to_string(image_counter) + ".bmp";
+                // postprocessor.saveImage(processed_image, proc_filename);
+                // std::cout << "Saved processed image: " << proc_filename << std::endl;
+
+                // Добавляем кадр в PostProcessor
+                // Номер кадра из заголовка сообщения; у старого формата номера нет - считаем сами
+                uint64_t frame_id = postprocessor.hasLastFrameId() ? postprocessor.getLastFrameId() : image_counter;
+                videoProcessor.addFrame(processed_image, frame_id, postprocessor.getLastTrace());
+
+                // Подтверждаем получение первого изображения
+                postprocessor.sendMessage("SEND_SECOND_IMAGE");
+
+                // Получаем второе изображение (оригинальное)
+                cv::Mat original_image = postprocessor.receiveImage();
+                if (!original_image.empty())
+                {
+                    std::string bare_filename = output_dir + bare_prefix + std::to_string(image_counter) + ".bmp";
+                    // postprocessor.saveImage(original_image, bare_filename);
+                    // std::cout << "Saved original image: " << bare_filename << std::endl;
+
+                    // Подтверждаем завершение
+                    postprocessor.sendMessage("DONE");
+
+                    std::cout << "Postprocessing completed. Total: " << image_counter << std::endl;
+                    image_counter++;
+                }
+            }
+        }
+    }
+
+    videoProcessor.stop(); // Останавливаем постобработчик перед выходом
+
+    return 0;
+}
\ No newline at end of file
@@ -10,18 +10,40 @@
 #include <sstream>
 #include <filesystem> // Добавляем для работы с файловой системой
 #include "utils.h"
+#include "logger.h"
+#include "metrics.h"
+#include "framePool.h"
 
 namespace fs = std::filesystem;
 
+// Метрики постобработки
+struct PostProcessorMetrics
+{
+    Counter &frames = MetricsRegistry::instance().counter("postprocessor_frames_total");
+    Counter &placeholders = MetricsRegistry::instance().counter("postprocessor_placeholder_frames_total");
+    Gauge &reorder_pending = MetricsRegistry::instance().gauge("postprocessor_reorder_pending");
+    Gauge &reorder_late = MetricsRegistry::instance().gauge("postprocessor_reorder_late_frames"); // с начала работы
+    Gauge &reorder_duplicates = MetricsRegistry::instance().gauge("postprocessor_reorder_duplicate_frames");
+    Gauge &encoder_backlog = MetricsRegistry::instance().gauge("postprocessor_encoder_backlog"); // частей в записи
+    LatencyHistogram &encode_time = MetricsRegistry::instance().histogram("postprocessor_encode_us");
+};
+
+static PostProcessorMetrics &metrics()
+{
+    static PostProcessorMetrics instance;
+    return instance;
+}
+
 // Конструктор с параметрами по умолчанию
-PostProcessor::PostProcessor(int bufferSize, int timeoutMs, const std::string &outputDir)
+PostProcessor::PostProcessor(int bufferSize, int timeoutMs, const std::string &outputDir, int reorderHoldMs)
     : maxFrames(bufferSize),
       currentFrameIndex(0),
       firstRun(true),
       currentlyFilling(BufferPart::FIRST),
       isRunning(false),
       timeoutDuration(timeoutMs),
-      outputDirectory(outputDir)
+      outputDirectory(outputDir),
+      reorderBuffer(reorderHoldMs, bufferSize)
 {
     // Создаем директорию для сохранения видео, если она не существует
     if (!outputDirectory.empty())
@@ -44,6 +66,21 @@ PostProcessor::PostProcessor(int bufferSize, int timeoutMs, const std::string &o
         outputDirectory = "."; // Сохраняем в текущую директорию
     }
 
+    resizeBuffer(bufferSize);
+
+    // Инициализация времени последнего кадра
+    lastFrameTime = std::chrono::steady_clock::now();
+
+    std::cout << "PostProcessor инициализирован с размером буфера: "
+              << maxFrames << " кадров" << std::endl;
+    std::cout << "Размер одной части: " << bufferPartSize << " кадров" << std::endl;
+}
+
+// Разметка буфера под новый размер
+void PostProcessor::resizeBuffer(int bufferSize)
+{
+    maxFrames = bufferSize;
+
     // Проверка корректности размера буфера
     if (maxFrames % 3 != 0)
     {
@@ -60,12 +97,10 @@ PostProcessor::PostProcessor(int bufferSize, int timeoutMs, const std::string &o
     frameBuffer.resize(maxFrames);
     initializeBuffer();
 
-    // Инициализация времени последнего кадра
-    lastFrameTime = std::chrono::steady_clock::now();
-
-    std::cout << "PostProcessor инициализирован с размером буфера: "
-              << maxFrames << " кадров" << std::endl;
-    std::cout << "Размер одной части: " << bufferPartSize << " кадров" << std::endl;
+    // Заполнение начинается заново с первой части
+    currentFrameIndex = 0;
+    firstRun = true;
+    currentlyFilling = BufferPart::FIRST;
 }
 
 // Деструктор
@@ -82,7 +117,7 @@ void PostProcessor::initializeBuffer()
     {
         // Создаем черный кадр с минимальными размерами
         // Реальные размеры будут установлены при получении первого кадра
-        frameBuffer[i].frame = cv::Mat::zeros(480, 640, CV_8UC3);
+        frameBuffer[i].frame = createBlackFrame(640, 480);
         frameBuffer[i].index = -1; // Индекс -1 означает пустой кадр
     }
     std::cout << "Буфер инициализирован черными кадрами" << std::endl;
@@ -92,25 +127,71 @@ void PostProcessor::initializeBuffer()
 cv::Mat PostProcessor::createBlackFrame(int width, int height)
 {
     // Создаем матрицу заданного размера, заполненную нулями (черный цвет)
-    // CV_8UC3 означает: 8 бит на канал, 3 канала (BGR)
-    return cv::Mat::zeros(height, width, CV_8UC3);
+    // CV_8UC3 означает: 8 бит на канал, 3 канала (BGR); буфер берется из пула кадров
+    cv::Mat frame = FramePool::instance().create(height, width, CV_8UC3);
+    frame.setTo(cv::Scalar::all(0));
+    return frame;
 }
 
-// Добавление нового кадра в буфер
-void PostProcessor::addFrame(const cv::Mat &frame, int index)
+// Добавление нового кадра: сначала восстановление порядка, затем буфер
+void PostProcessor::addFrame(const cv::Mat &frame, uint64_t id, const FrameTrace &trace)
 {
     std::lock_guard<std::mutex> lock(bufferMutex); // Блокируем мьютекс для безопасного доступа
 
     // Проверяем, что кадр не пустой
     if (frame.empty())
     {
-        std::cerr << "Предупреждение: получен пустой кадр с индексом " << index << std::endl;
+        std::cerr << "Предупреждение: получен пустой кадр с индексом " << id << std::endl;
         return;
     }
 
     // Обновляем время получения последнего кадра
     lastFrameTime = std::chrono::steady_clock::now();
 
+    if (traceExporter && !trace.empty() && traceExporter->sampled(id))
+    {
+        pendingTraces[id] = PendingTrace{trace, traceNowUs()};
+    }
+
+    std::vector<OrderedFrame> ready;
+    reorderBuffer.push(frame, id, ready);
+    storeOrderedFrames(ready);
+    metrics().reorder_pending.set(reorderBuffer.getPendingFrames());
+    metrics().reorder_late.set(reorderBuffer.getLateFrames());
+    metrics().reorder_duplicates.set(reorderBuffer.getDuplicateFrames());
+}
+
+// Трасса кадра переходит в буфер вместе с ним; ожидание порядка - отдельный интервал
+void PostProcessor::takeTrace(int64_t index, FrameTrace &trace)
+{
+    trace = FrameTrace();
+    if (pendingTraces.empty() || index < 0)
+    {
+        return;
+    }
+
+    auto found = pendingTraces.find(static_cast<uint64_t>(index));
+    if (found != pendingTraces.end())
+    {
+        trace = found->second.trace;
+        trace.addSpan(TraceStage::Reorder, found->second.receivedUs, traceNowUs());
+    }
+    // Кадры с меньшими номерами уже выданы или заменены заглушками - их трассы не нужны
+    pendingTraces.erase(pendingTraces.begin(), pendingTraces.upper_bound(static_cast<uint64_t>(index)));
+}
+
+void PostProcessor::storeOrderedFrames(const std::vector<OrderedFrame> &frames)
+{
+    for (const auto &ordered : frames)
+    {
+        (ordered.placeholder ? metrics().placeholders : metrics().frames).add();
+        storeFrame(ordered.frame, static_cast<int64_t>(ordered.id));
+    }
+}
+
+// Добавление кадра в буфер на позицию по его номеру
+void PostProcessor::storeFrame(const cv::Mat &frame, int64_t index)
+{
     // Если это первый кадр, проверяем размеры черных кадров
     if (currentFrameIndex == 0)
     {
@@ -123,16 +204,16 @@ void PostProcessor::addFrame(const cv::Mat &frame, int index)
             }
         }
     }
-    currentFrameIndex = index % maxFrames;
+    currentFrameIndex = static_cast<int>(index % maxFrames);
     // Сохраняем кадр в буфер
     if (currentFrameIndex < maxFrames)
     {
         frame.copyTo(frameBuffer[currentFrameIndex].frame); // Копируем кадр
         frameBuffer[currentFrameIndex].index = index;       // Сохраняем индекс
+        takeTrace(index, frameBuffer[currentFrameIndex].trace);
         currentFrameIndex++;                                // Увеличиваем индекс
 
-        std::cout << "Кадр " << index << " добавлен в буфер на позицию "
-                  << currentFrameIndex - 1 << std::endl;
+        LOG_DEBUG("Кадр {} добавлен в буфер на позицию {}", index, currentFrameIndex - 1);
 
         // Проверяем, нужно ли сохранять часть буфера
         checkAndSaveIfNeeded();
@@ -161,12 +242,7 @@ void PostProcessor::checkAndSaveIfNeeded()
     else
     {
         int currentPart = currentFrameIndex / bufferPartSize;
-        std::cout << "currentPart " << currentPart << "\n";
-        std::cout << "currentlyFilling " << (int)currentlyFilling << "\n";
-        std::cout << "first cond " << (currentPart == 1 && (int)currentlyFilling == 0) << "\n";
-        std::cout << "second cond " << (currentPart == 2 && (int)currentlyFilling == 1) << "\n";
-        std::cout << "third cond " << (currentPart == 0 && (int)currentlyFilling == 2) << "\n";
-        std::cout << "all cond " << ((currentPart == 1 && (int)currentlyFilling == 0) || (currentPart == 2 && (int)currentlyFilling == 1) || (currentPart == 0 && (int)currentlyFilling == 2)) << "\n";
+        LOG_TRACE("currentPart {}, currentlyFilling {}", currentPart, (int)currentlyFilling);
         // При последующих прогонах проверяем границы частей
         if (
             (currentPart == 1 && (int)currentlyFilling == 0) ||
@@ -200,7 +276,7 @@ void PostProcessor::checkAndSaveIfNeeded()
 // Сохранение части буфера в видео
 void PostProcessor::savePartToVideo(BufferPart partToSave)
 {
-    std::cout << "start save\n";
+    LOG_DEBUG("start save");
 
     // Определяем индексы начала и конца сохраняемой части
     int startIdx, endIdx;
@@ -231,7 +307,7 @@ void PostProcessor::savePartToVideo(BufferPart partToSave)
         }
     }
 
-    std::cout << "exist frames: " << (hasFrames ? "true" : "false") << std::endl;
+    LOG_DEBUG("exist frames: {}", hasFrames);
 
     if (!hasFrames)
     {
@@ -246,13 +322,15 @@ void PostProcessor::savePartToVideo(BufferPart partToSave)
 
     {
         // std::lock_guard<std::mutex> lock(bufferMutex);
-        std::cout << "is mutex\n";
         // Копируем кадры из указанной части буфера
         for (int i = startIdx; i <= endIdx; i++)
         {
             FrameWithIndex frameCopy;
-            frameBuffer[i].frame.copyTo(frameCopy.frame);
+            frameCopy.frame = FramePool::instance().clone(frameBuffer[i].frame); // Вернется в пул после записи видео
             frameCopy.index = frameBuffer[i].index;
+            frameCopy.trace = frameBuffer[i].trace;
+            // Ожидание заполнения части - от записи в буфер до начала сохранения
+            frameCopy.trace.addSpan(TraceStage::Buffer, frameCopy.trace.lastEndUs(), traceNowUs());
             framesToSave.push_back(frameCopy);
         }
 
@@ -263,7 +341,7 @@ void PostProcessor::savePartToVideo(BufferPart partToSave)
         resetBufferPart(partToSave);
     }
 
-    std::cout << "created copying frames: " << framesToSave.size() << " frames\n";
+    LOG_DEBUG("created copying frames: {} frames", framesToSave.size());
 
     // Проверяем, что есть кадры для сохранения
     if (framesToSave.empty())
@@ -276,11 +354,13 @@ void PostProcessor::savePartToVideo(BufferPart partToSave)
     std::string localOutputDir = currentOutputDir;
 
     // Запускаем сохранение в отдельном потоке
-    std::thread saveThread([this, framesToSave, partToSave, localOutputDir]() mutable
+    metrics().encoder_backlog.add(1);
+    std::shared_ptr<TraceExporter> exporter = traceExporter;
+    std::thread saveThread([this, framesToSave, partToSave, localOutputDir, exporter]() mutable
                            {
         try
         {
-            std::cout << "start thread for part " << static_cast<int>(partToSave) << "\n";
+            LOG_DEBUG("start thread for part {}", static_cast<int>(partToSave));
             
             // Генерируем имя файла с временной меткой
             auto now = std::chrono::system_clock::now();
@@ -298,7 +378,7 @@ void PostProcessor::savePartToVideo(BufferPart partToSave)
             filename << "video_part_" << static_cast<int>(partToSave) << "_"
                      << std::put_time(&tm_now, "%Y%m%d_%H%M%S") << ".avi";
             
-            std::cout << "output directory: " << localOutputDir << "\n";
+            LOG_DEBUG("output directory: {}", localOutputDir);
             
             // Формируем полный путь для сохранения
             std::string fullPath;
@@ -325,12 +405,26 @@ void PostProcessor::savePartToVideo(BufferPart partToSave)
                 fullPath = filename.str();
             }
             
-            std::cout << "fullPath: " << fullPath << "\n";
+            LOG_DEBUG("fullPath: {}", fullPath);
             
             // Сохраняем кадры в видео
+            uint64_t encodeBeginUs = traceNowUs();
             saveFramesToVideo(framesToSave, fullPath);
+            uint64_t encodeEndUs = traceNowUs();
+
+            if (exporter)
+            {
+                for (auto &saved : framesToSave)
+                {
+                    if (!saved.trace.empty())
+                    {
+                        saved.trace.addSpan(TraceStage::Encode, encodeBeginUs, encodeEndUs);
+                        exporter->write(static_cast<uint64_t>(saved.index), saved.trace);
+                    }
+                }
+            }
             
-            std::cout << "Thread finished for part " << static_cast<int>(partToSave) << "\n";
+            LOG_DEBUG("Thread finished for part {}", static_cast<int>(partToSave));
         }
         catch (const std::exception& e)
         {
@@ -339,13 +433,13 @@ void PostProcessor::savePartToVideo(BufferPart partToSave)
         catch (...)
         {
             std::cerr << "Unknown exception in save thread" << std::endl;
-        } });
+        }
+        metrics().encoder_backlog.add(-1); });
 
     // Отсоединяем поток, чтобы он работал независимо
     saveThread.detach();
 
-    std::cout << "Thread detached for part " << static_cast<int>(partToSave)
-              << ". Frames to save: " << framesToSave.size() << std::endl;
+    LOG_DEBUG("Thread detached for part {}. Frames to save: {}", static_cast<int>(partToSave), framesToSave.size());
 
     std::cout << "Запущено сохранение части " << static_cast<int>(partToSave)
               << " в файл: " << outputDirectory << std::endl;
@@ -360,9 +454,9 @@ void PostProcessor::saveFramesToVideo(const std::vector<FrameWithIndex> &frames,
         return;
     }
 
+    auto started = std::chrono::steady_clock::now();
     try
     {
-        std::cout << "saveFramesToVideo\n";
         // Получаем размеры первого кадра
         cv::Size frameSize = frames[0].frame.size();
 
@@ -401,6 +495,8 @@ void PostProcessor::saveFramesToVideo(const std::vector<FrameWithIndex> &frames,
         // Закрываем видеофайл
         videoWriter.release();
 
+        metrics().encode_time.record(std::chrono::duration_cast<std::chrono::microseconds>(
+                                         std::chrono::steady_clock::now() - started).count());
         std::cout << "Видео сохранено: " << filename
                   << " (кадров: " << frames.size() << ")" << std::endl;
     }
@@ -441,12 +537,11 @@ void PostProcessor::resetBufferPart(BufferPart part)
     {
         if (!frameBuffer[i].frame.empty())
         {
-            // Сохраняем размеры для создания черного кадра
-            int width = frameBuffer[i].frame.cols;
-            int height = frameBuffer[i].frame.rows;
-            frameBuffer[i].frame = createBlackFrame(width, height);
+            // Буфер кадра принадлежит только frameBuffer (кадры копируются) - чистим на месте
+            frameBuffer[i].frame.setTo(cv::Scalar::all(0));
         }
         frameBuffer[i].index = -1; // Отмечаем как пустой
+        frameBuffer[i].trace = FrameTrace();
     }
 
     std::cout << "Часть буфера " << static_cast<int>(part)
@@ -458,7 +553,19 @@ void PostProcessor::flushAll()
 {
     std::lock_guard<std::mutex> lock(bufferMutex);
 
-    // Сохраняем все заполненные части буфера
+    // Кадры, ждущие пропущенных предшественников, тоже попадают в видео
+    std::vector<OrderedFrame> ready;
+    reorderBuffer.flush(ready);
+    storeOrderedFrames(ready);
+
+    saveFilledParts();
+
+    std::cout << "Все кадры сохранены в директорию: " << outputDirectory << std::endl;
+}
+
+// Сохранение всех заполненных частей буфера
+void PostProcessor::saveFilledParts()
+{
     if (currentFrameIndex > 0)
     {
         // Определяем, какие части нужно сохранить
@@ -479,8 +586,6 @@ void PostProcessor::flushAll()
             savePartToVideo(BufferPart::THIRD);
         }
     }
-
-    std::cout << "Все кадры сохранены в директорию: " << outputDirectory << std::endl;
 }
 
 // Поток проверки таймаута
@@ -491,11 +596,20 @@ void PostProcessor::timeoutChecker()
         std::this_thread::sleep_for(std::chrono::milliseconds(100)); // Проверяем каждые 100 мс
 
         auto now = std::chrono::steady_clock::now();
-        auto elapsed = std::chrono::duration_cast<std::chrono::milliseconds>(
-            now - lastFrameTime);
+        bool timedOut;
+        {
+            // Пропуски, ждущие дольше допустимого, заполняются заглушками
+            std::lock_guard<std::mutex> lock(bufferMutex);
+            std::vector<OrderedFrame> ready;
+            reorderBuffer.expire(ready);
+            storeOrderedFrames(ready);
+
+            // Таймаут может измениться на ходу - читаем под мьютексом
+            timedOut = now - lastFrameTime > timeoutDuration;
+        }
 
         // Если время с последнего кадра превысило таймаут
-        if (elapsed > timeoutDuration)
+        if (timedOut)
         {
             std::cout << "Таймаут истек, сохраняем оставшиеся кадры..." << std::endl;
             flushAll();
@@ -529,6 +643,9 @@ void PostProcessor::stop()
         }
         // Сохраняем все оставшиеся кадры
         flushAll();
+        std::cout << "Порядок кадров: опоздавших " << reorderBuffer.getLateFrames()
+                  << ", повторных " << reorderBuffer.getDuplicateFrames()
+                  << ", заменено заглушками " << reorderBuffer.getFilledFrames() << std::endl;
         std::cout << "PostProcessor остановлен" << std::endl;
     }
 }
@@ -552,84 +669,55 @@ void PostProcessor::setOutputDirectory(const std::string &dir)
     }
 }
 
-int main()
+// Изменение размера буфера: накопленное уходит в видео, заполнение начинается заново
+void PostProcessor::setBufferSize(int bufferSize)
 {
-    std::cout << "real" << std::endl;
-    Utils postprocessor;
-    postprocessor.loadConfig();
-
-    std::string ip = postprocessor.getConfig("postprocessor.ip");
-    int port = std::stoi(postprocessor.getConfig("postprocessor.port"));
-    std::string output_dir = postprocessor.getConfig("postprocessor.output_dir");
-    std::string proc_prefix = postprocessor.getConfig("postprocessor.processed_prefix");
-    std::string bare_prefix = postprocessor.getConfig("postprocessor.bare_prefix");
-    int maxFrames = std::stoi(postprocessor.getConfig("postprocessor.max_frames"));
-    int timeoutDuration = std::stoi(postprocessor.getConfig("postprocessor.timeout_duration"));
-
-    static int image_counter = 1;
-
-    if (!postprocessor.initializeServer(ip, port))
+    std::lock_guard<std::mutex> lock(bufferMutex);
+    // Размер округляется до кратного 3 так же, как в resizeBuffer
+    if (bufferSize < 3 || (bufferSize + 2) / 3 * 3 == maxFrames)
     {
-        return -1;
+        return;
     }
 
-    // Создаем экземпляр PostProcessor с указанием директории для сохранения видео
-    // Буфер на 90 кадров (30 кадров в каждой из 3 частей)
-    // Таймаут 5 секунд
-    // Директория для сохранения видео берется из конфигурации
-    PostProcessor videoProcessor(maxFrames, timeoutDuration, output_dir);
-    videoProcessor.start(); // Запускаем постобработчик
-
-    std::cout << "PostProcessor started. Waiting for server..." << std::endl;
-
-    while (true)
-    {
-        std::cout << "\nWaiting for server..." << std::endl;
-
-        // Ждем запрос от сервера
-        std::string request = postprocessor.receiveMessage();
-        if (request == "READY")
-        {
-            std::cout << "Server is ready. Receiving images..." << std::endl;
-
-            // Отправляем подтверждение, что готовы получать изображения
-            postprocessor.sendMessage("SEND_FIRST_IMAGE");
-
-            // Получаем первое изображение (обработанное)
-            cv::Mat processed_image = postprocessor.receiveImage();
-            if (!processed_image.empty())
-            {
-                postprocessor.setCurrentImage(processed_image);
-                std::string proc_filename = output_dir + proc_prefix + std::to_string(image_counter) + ".bmp";
-                // postprocessor.saveImage(proc_filename);
-                // std::cout << "Saved processed image: " << proc_filename << std::endl;
+    std::vector<OrderedFrame> ready;
+    reorderBuffer.flush(ready);
+    storeOrderedFrames(ready);
+    saveFilledParts();
 
-                // Добавляем кадр в PostProcessor
-                videoProcessor.addFrame(processed_image, image_counter); // Тут вместо image_counter передаем номер кадра
-
-                // Подтверждаем получение первого изображения
-                postprocessor.sendMessage("SEND_SECOND_IMAGE");
+    resizeBuffer(bufferSize);
+    reorderBuffer.setMaxPending(maxFrames);
+    std::cout << "Размер буфера изменен на " << maxFrames << " кадров" << std::endl;
+}
 
-                // Получаем второе изображение (оригинальное)
-                cv::Mat original_image = postprocessor.receiveImage();
-                if (!original_image.empty())
-                {
-                    postprocessor.setCurrentImage(original_image);
-                    std::string bare_filename = output_dir + bare_prefix + std::to_string(image_counter) + ".bmp";
-                    // postprocessor.saveImage(bare_filename);
-                    // std::cout << "Saved original image: " << bare_filename << std::endl;
+void PostProcessor::setTimeout(int timeoutMs)
+{
+    std::lock_guard<std::mutex> lock(bufferMutex);
+    timeoutDuration = std::chrono::milliseconds(timeoutMs);
+}
 
-                    // Подтверждаем завершение
-                    postprocessor.sendMessage("DONE");
+void PostProcessor::setReorderHold(int reorderHoldMs)
+{
+    std::lock_guard<std::mutex> lock(bufferMutex);
+    reorderBuffer.setMaxHold(reorderHoldMs);
+}
 
-                    std::cout << "Postprocessing completed. Total: " << image_counter << std::endl;
-                    image_counter += image_counter % 2 == 0 ? 20 : 1;
-                }
-            }
-        }
+void PostProcessor::enableTracing(const std::string &path, int sampleEvery)
+{
+    std::lock_guard<std::mutex> lock(bufferMutex);
+    pendingTraces.clear();
+    if (path.empty() || sampleEvery <= 0)
+    {
+        traceExporter.reset();
+        return;
     }
 
-    videoProcessor.stop(); // Останавливаем постобработчик перед выходом
-
-    return 0;
-}
\ No newline at end of file
+    auto exporter = std::make_shared<TraceExporter>(path, sampleEvery);
+    if (exporter->isOpen())
+    {
+        traceExporter = exporter;
+    }
+    else
+    {
+        traceExporter.reset();
+    }
+}
@@ -7,12 +7,19 @@
 #include <mutex>
 #include <chrono>
 #include <string>
+#include <cstdint>
+#include <map>
+#include <memory>
+#include "frameTrace.h"
+#include "reorderBuffer.h"
+#include "traceExporter.h"
 
 // Структура для хранения кадра с индексом
 struct FrameWithIndex
 {
     cv::Mat frame; // Сам кадр
-    int index;     // Индекс кадра
+    int64_t index; // Номер кадра, -1 - пустой кадр
+    FrameTrace trace; // Трасса, если кадр попал в выборку
 };
 
 // Перечисление для частей буфера
@@ -27,13 +34,16 @@ class PostProcessor
 {
 public:
     // Конструктор с директорией для сохранения
-    PostProcessor(int bufferSize = 90, int timeoutMs = 5000, const std::string &outputDir = "./videos");
+    // reorderHoldMs - сколько ждать пропущенный кадр, прежде чем заменить его черным
+    PostProcessor(int bufferSize = 90, int timeoutMs = 5000, const std::string &outputDir = "./videos",
+                  int reorderHoldMs = 200);
 
     // Деструктор
     ~PostProcessor();
 
-    // Добавление кадра в буфер
-    void addFrame(const cv::Mat &frame, int index);
+    // Добавление кадра с его номером; кадры могут приходить не по порядку.
+    // trace - интервалы предыдущих стадий, дополняется ожиданием порядка, буфером и записью
+    void addFrame(const cv::Mat &frame, uint64_t id, const FrameTrace &trace = FrameTrace());
 
     // Запуск постобработчика
     void start();
@@ -47,6 +57,15 @@ public:
     // Установка директории для сохранения видео
     void setOutputDirectory(const std::string &dir);
 
+    // Изменение параметров на ходу, между кадрами.
+    // При смене размера буфера накопленные кадры сначала сохраняются в видео, а не теряются.
+    void setBufferSize(int bufferSize);
+    void setTimeout(int timeoutMs);
+    void setReorderHold(int reorderHoldMs);
+
+    // Запись трасс каждого sampleEvery-го кадра в path (Chrome trace-event JSON)
+    void enableTracing(const std::string &path, int sampleEvery);
+
 private:
     // Размер буфера
     int maxFrames;
@@ -84,6 +103,37 @@ private:
     // Директория для сохранения видео
     std::string outputDirectory;
 
+    // Восстановление порядка кадров перед записью в буфер
+    ReorderBuffer reorderBuffer;
+
+    // Трасса кадра, ждущего своей очереди в reorderBuffer
+    struct PendingTrace
+    {
+        FrameTrace trace;
+        uint64_t receivedUs; // Время получения кадра PostProcessor'ом
+    };
+
+    // Запись трасс; разделяется с потоками сохранения, которые могут пережить смену файла
+    std::shared_ptr<TraceExporter> traceExporter;
+
+    // Трассы кадров из выборки по номеру кадра
+    std::map<uint64_t, PendingTrace> pendingTraces;
+
+    // Запись упорядоченных кадров в буфер (мьютекс уже захвачен)
+    void storeOrderedFrames(const std::vector<OrderedFrame> &frames);
+
+    // Запись кадра в буфер по его номеру (мьютекс уже захвачен)
+    void storeFrame(const cv::Mat &frame, int64_t index);
+
+    // Трасса кадра index из pendingTraces (пустая, если кадр не в выборке)
+    void takeTrace(int64_t index, FrameTrace &trace);
+
+    // Приведение размера к кратному 3 и разметка частей буфера
+    void resizeBuffer(int bufferSize);
+
+    // Сохранение всех заполненных частей буфера (мьютекс уже захвачен)
+    void saveFilledParts();
+
     // Инициализация буфера черными кадрами
     void initializeBuffer();
 
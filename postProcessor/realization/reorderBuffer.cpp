@@ -0,0 +1,135 @@
+#include "reorderBuffer.h"
+#include "logger.h"
+
+// Отставание номера, после которого поток считается перезапущенным, а не опоздавшим
+static const uint64_t RESTART_DISTANCE = 1000;
+
+// Сколько номеров заглушек помнить для различения опоздавших и повторных кадров
+static const size_t FILLED_HISTORY = 1024;
+
+ReorderBuffer::ReorderBuffer(int maxHoldMs, size_t maxPending)
+    : maxHold(maxHoldMs),
+      maxPending(maxPending > 0 ? maxPending : 1),
+      started(false),
+      nextId(0),
+      lastSize(640, 480),
+      lastType(CV_8UC3),
+      lateFrames(0),
+      duplicateFrames(0),
+      filledFrames(0)
+{
+}
+
+void ReorderBuffer::push(const cv::Mat &frame, uint64_t id, std::vector<OrderedFrame> &ready)
+{
+    if (!started)
+    {
+        started = true;
+        nextId = id;
+    }
+
+    // Источник начал нумерацию заново - выдаем удерживаемое и начинаем с нового номера
+    if (id + RESTART_DISTANCE < nextId)
+    {
+        LOG_INFO("Номера кадров начались заново с {}", id);
+        flush(ready);
+        filledIds.clear();
+        nextId = id;
+    }
+
+    if (id < nextId)
+    {
+        if (filledIds.count(id))
+        {
+            // Опоздания и повторы учитываются счетчиками; в журнал - только при отладке
+            lateFrames++;
+            LOG_DEBUG("Кадр {} опоздал, на его месте уже заглушка", id);
+        }
+        else
+        {
+            duplicateFrames++;
+            LOG_DEBUG("Кадр {} уже записан, повтор отброшен", id);
+        }
+        return;
+    }
+
+    if (pending.count(id))
+    {
+        duplicateFrames++;
+        LOG_DEBUG("Кадр {} уже ожидает записи, повтор отброшен", id);
+        return;
+    }
+
+    pending[id] = HeldFrame{frame, std::chrono::steady_clock::now()};
+    releaseContiguous(ready);
+
+    // Ожидание пропуска не должно расти без предела
+    while (pending.size() > maxPending)
+    {
+        releaseFirstGap(ready);
+    }
+}
+
+void ReorderBuffer::expire(std::vector<OrderedFrame> &ready)
+{
+    auto now = std::chrono::steady_clock::now();
+    while (!pending.empty() && now - pending.begin()->second.arrived > maxHold)
+    {
+        releaseFirstGap(ready);
+    }
+}
+
+void ReorderBuffer::flush(std::vector<OrderedFrame> &ready)
+{
+    while (!pending.empty())
+    {
+        releaseFirstGap(ready);
+    }
+}
+
+void ReorderBuffer::releaseContiguous(std::vector<OrderedFrame> &ready)
+{
+    auto it = pending.begin();
+    while (it != pending.end() && it->first == nextId)
+    {
+        lastSize = it->second.frame.size();
+        lastType = it->second.frame.type();
+        ready.push_back(OrderedFrame{it->second.frame, it->first, false});
+        it = pending.erase(it);
+        nextId++;
+    }
+}
+
+void ReorderBuffer::releaseFirstGap(std::vector<OrderedFrame> &ready)
+{
+    if (pending.empty())
+    {
+        return;
+    }
+
+    uint64_t firstHeld = pending.begin()->first;
+    if (firstHeld - nextId > maxPending)
+    {
+        // Столько заглушек подряд - это разрыв потока, а не потери
+        LOG_WARN("Разрыв нумерации {} -> {}, заглушки не вставляются", nextId, firstHeld);
+        nextId = firstHeld;
+    }
+    else if (firstHeld > nextId)
+    {
+        LOG_DEBUG("Кадры {}-{} не пришли, заменены заглушками", nextId, firstHeld - 1);
+    }
+
+    for (; nextId < firstHeld; nextId++)
+    {
+        ready.push_back(OrderedFrame{cv::Mat::zeros(lastSize, lastType), nextId, true});
+        filledIds.insert(nextId);
+        filledFrames++;
+    }
+
+    while (filledIds.size() > FILLED_HISTORY)
+    {
+        filledIds.erase(filledIds.begin());
+    }
+
+    releaseContiguous(ready);
+}
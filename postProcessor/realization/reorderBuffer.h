@@ -0,0 +1,72 @@
+#ifndef REORDERBUFFER_H
+#define REORDERBUFFER_H
+
+#include <opencv2/opencv.hpp>
+#include <chrono>
+#include <cstdint>
+#include <map>
+#include <set>
+#include <vector>
+
+// Кадр, готовый к записи в видео, в порядке номеров
+struct OrderedFrame
+{
+    cv::Mat frame;      // Кадр или черная заглушка на месте потерянного
+    uint64_t id;        // Номер кадра
+    bool placeholder;   // true - кадр так и не пришел
+};
+
+// Восстановление порядка кадров от параллельных worker'ов.
+// Непрерывная последовательность номеров выдается сразу; пропуск ждет не дольше
+// maxHold, после чего заполняется заглушкой. Опоздавшие и повторные кадры отбрасываются.
+class ReorderBuffer
+{
+public:
+    explicit ReorderBuffer(int maxHoldMs = 200, size_t maxPending = 90);
+
+    // Добавление кадра; готовые кадры дописываются в ready
+    void push(const cv::Mat &frame, uint64_t id, std::vector<OrderedFrame> &ready);
+
+    // Выдача кадров, пропуски перед которыми ждут дольше maxHold
+    void expire(std::vector<OrderedFrame> &ready);
+
+    // Выдача всех удерживаемых кадров с заполнением пропусков
+    void flush(std::vector<OrderedFrame> &ready);
+
+    // Изменение срока ожидания и глубины на ходу; удерживаемые кадры сохраняются
+    void setMaxHold(int maxHoldMs) { maxHold = std::chrono::milliseconds(maxHoldMs); }
+    void setMaxPending(size_t value) { maxPending = value; }
+
+    uint64_t getLateFrames() const { return lateFrames; }
+    uint64_t getDuplicateFrames() const { return duplicateFrames; }
+    uint64_t getFilledFrames() const { return filledFrames; }
+    size_t getPendingFrames() const { return pending.size(); }
+
+private:
+    struct HeldFrame
+    {
+        cv::Mat frame;
+        std::chrono::steady_clock::time_point arrived;
+    };
+
+    // Выдача непрерывной последовательности начиная с nextId
+    void releaseContiguous(std::vector<OrderedFrame> &ready);
+
+    // Заполнение пропусков заглушками до первого удерживаемого кадра и его выдача
+    void releaseFirstGap(std::vector<OrderedFrame> &ready);
+
+    std::chrono::milliseconds maxHold;
+    size_t maxPending;               // Больше удерживать нельзя - пропуск заполняется сразу
+    bool started;                    // Получен первый кадр
+    uint64_t nextId;                 // Номер следующего кадра на выдачу
+    std::map<uint64_t, HeldFrame> pending; // Кадры, пришедшие раньше предшественников
+    std::set<uint64_t> filledIds;    // Недавние номера, замененные заглушками
+    cv::Size lastSize;               // Размер заглушки
+    int lastType;
+
+    uint64_t lateFrames;      // Пришли после заполнения их места заглушкой
+    uint64_t duplicateFrames; // Повторно пришедшие номера
+    uint64_t filledFrames;    // Выданные заглушки
+};
+
+#endif // REORDERBUFFER_H
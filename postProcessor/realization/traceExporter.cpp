@@ -0,0 +1,77 @@
+#include "traceExporter.h"
+#include <algorithm>
+#include <vector>
+#include "logger.h"
+
+TraceExporter::TraceExporter(const std::string &path, int sampleEvery)
+    : out(path, std::ios::out | std::ios::trunc),
+      isOpened(false),
+      firstEvent(true),
+      sampleEvery(sampleEvery > 0 ? static_cast<uint64_t>(sampleEvery) : 0)
+{
+    if (!out)
+    {
+        LOG_WARN("Не удалось открыть файл трассы {}", path);
+        return;
+    }
+    isOpened = true;
+    out << "[\n";
+    LOG_INFO("Трасса кадров пишется в {}, каждый {}-й кадр", path, sampleEvery);
+}
+
+TraceExporter::~TraceExporter()
+{
+    std::lock_guard<std::mutex> lock(outMutex);
+    if (isOpened)
+    {
+        out << "\n]\n";
+    }
+}
+
+void TraceExporter::write(uint64_t id, const FrameTrace &trace)
+{
+    if (!isOpened || trace.empty())
+    {
+        return;
+    }
+
+    std::lock_guard<std::mutex> lock(outMutex);
+
+    // Стадия дописывает вложенный интервал раньше внешнего (applyEffect до worker'а):
+    // по началу, внешний первым - тогда промежутки считаются только между стадиями
+    std::vector<TraceSpan> spans(trace.spans, trace.spans + trace.span_count);
+    std::stable_sort(spans.begin(), spans.end(), [](const TraceSpan &a, const TraceSpan &b)
+                     { return a.begin_us != b.begin_us ? a.begin_us < b.begin_us : a.end_us > b.end_us; });
+
+    uint64_t reached_us = trace.capture_us;
+    for (const TraceSpan &span : spans)
+    {
+        // Часы разных машин могут расходиться - интервалы "назад во времени" пропускаются
+        if (span.end_us < span.begin_us)
+        {
+            continue;
+        }
+        if (span.begin_us > reached_us)
+        {
+            writeEvent("transit", id, reached_us, span.begin_us);
+        }
+        writeEvent(traceStageName(static_cast<TraceStage>(span.stage)), id, span.begin_us, span.end_us);
+        if (span.end_us > reached_us)
+        {
+            reached_us = span.end_us;
+        }
+    }
+    out.flush();
+}
+
+void TraceExporter::writeEvent(const char *name, uint64_t id, uint64_t begin_us, uint64_t end_us)
+{
+    if (!firstEvent)
+    {
+        out << ",\n";
+    }
+    firstEvent = false;
+    out << "{\"name\":\"" << name << "\",\"cat\":\"frame\",\"ph\":\"X\""
+        << ",\"ts\":" << begin_us << ",\"dur\":" << end_us - begin_us
+        << ",\"pid\":1,\"tid\":" << id << ",\"args\":{\"frame\":" << id << "}}";
+}
@@ -0,0 +1,41 @@
+#ifndef TRACEEXPORTER_H
+#define TRACEEXPORTER_H
+
+#include <cstdint>
+#include <fstream>
+#include <mutex>
+#include <string>
+#include "frameTrace.h"
+
+// Запись трасс кадров в формате Chrome trace-event (JSON-массив событий),
+// файл открывается в Perfetto или chrome://tracing.
+// Каждый кадр - отдельная строка (tid = номер кадра), стадии - события "X",
+// промежутки между стадиями (очереди и сеть) - события "transit".
+// Записывается каждый sampleEvery-й кадр, чтобы файл не рос на каждом кадре.
+class TraceExporter
+{
+public:
+    TraceExporter(const std::string &path, int sampleEvery);
+
+    // Закрывает JSON-массив
+    ~TraceExporter();
+
+    bool isOpen() const { return isOpened; }
+
+    // Попадает ли кадр в выборку
+    bool sampled(uint64_t id) const { return sampleEvery > 0 && id % sampleEvery == 0; }
+
+    // Запись всех интервалов кадра; вызывается из потоков сохранения
+    void write(uint64_t id, const FrameTrace &trace);
+
+private:
+    void writeEvent(const char *name, uint64_t id, uint64_t begin_us, uint64_t end_us);
+
+    std::ofstream out;
+    std::mutex outMutex;
+    bool isOpened;
+    bool firstEvent;
+    uint64_t sampleEvery;
+};
+
+#endif // TRACEEXPORTER_H
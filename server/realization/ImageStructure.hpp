@@ -1,71 +1,286 @@
 #pragma once
 
 #include <cstddef>
+#include <cstdint>
 #include <cstring>
+#include <climits>
+#include <algorithm>
+#include <vector>
 #include <opencv2/core/mat.hpp>
 #include <opencv2/core/types.hpp>
 #include <opencv2/opencv.hpp>
-#include <sstream>
-#include <string>
 #include <zmq.hpp>
+#include "zeroCopy.h"
+#include "framePool.h"
+#include "deltaCodec.h"
+
+// Заголовок кадра на проводе. Все поля - little-endian, без выравнивания.
+// За заголовком следуют size байт данных: для RAW это rows строк по step байт,
+// для DELTA - разность с предыдущим кадром (см. deltaCodec.h).
+// Размер заголовка кратен 16, чтобы пиксели любых типов оставались выровненными.
+#pragma pack(push, 1)
+struct ImageHeader
+{
+    uint32_t magic;       // IMAGE_MAGIC
+    uint16_t version;     // IMAGE_VERSION
+    uint16_t header_size; // sizeof(ImageHeader), смещение до данных
+    uint64_t id;          // номер кадра
+    uint64_t size;        // байт данных после заголовка
+    uint32_t rows;
+    uint32_t cols;
+    // Поля версии 2
+    int32_t type;         // тип OpenCV: CV_8UC1, CV_16UC1, CV_8UC4, ...
+    uint16_t encoding;    // ImageEncoding, с версии 3 (в версии 2 всегда 0)
+    uint16_t reserved;
+    uint64_t step;        // байт на строку, не меньше cols * elemSize
+    // Поля версии 4: интервал захвата для трассировки (мкс системных часов, 0 - нет)
+    uint64_t capture_begin_us;
+    uint64_t capture_end_us;
+};
+#pragma pack(pop)
+
+enum ImageEncoding : uint16_t
+{
+    IMAGE_ENCODING_RAW = 0,   // полный кадр, он же ключевой для DELTA
+    IMAGE_ENCODING_DELTA = 1  // изменившиеся плитки относительно предыдущего кадра
+};
+
+static const uint32_t IMAGE_MAGIC = 0x47414D49; // "IMAG"
+static const uint16_t IMAGE_VERSION = 4;
+
+// Версия 3 не передавала время захвата
+static const uint16_t IMAGE_VERSION_3 = 3;
+static const uint16_t IMAGE_HEADER_SIZE_V3 = 48;
+
+// Версия 2 не знала о разностном кодировании; размер заголовка как у версии 3
+static const uint16_t IMAGE_VERSION_2 = 2;
+
+// Версия 1 не передавала тип: всегда CV_8UC3 без промежутков между строками
+static const uint16_t IMAGE_VERSION_1 = 1;
+static const uint16_t IMAGE_HEADER_SIZE_V1 = 32;
 
 struct ImageStructure
 {
-    ImageStructure(cv::Mat& m, size_t id = 0) :m_(m), id(id){};
+    ImageStructure(cv::Mat& m, uint64_t id = 0) :id(id), m_(m){};
 
-    size_t id;
+    uint64_t id;
     cv::Mat& m_;
+    uint64_t capture_begin_us = 0; // Интервал захвата кадра (трассировка)
+    uint64_t capture_end_us = 0;
 
-    std::string serialize()
+    // Сериализация сразу в сообщение нужного размера: заголовок + строки пикселей.
+    // Тип матрицы сохраняется как есть, строки укладываются без промежутков.
+    // Буфер сообщения берется из FramePool и возвращается туда после отправки.
+    zmq::message_t serialize()
     {
-        // Фиксированная структура байтов
-        cv::Mat fixed;
-
-        // if (m_.channels() == 1)
-        // {
-            // cv::cvtColor(m_, m_, cv::COLOR_GRAY2BGR);
-        // }
-        if (m_.type() != CV_8UC3) {
-            m_.convertTo(fixed, CV_8UC3);
+        size_t row_bytes = m_.cols * m_.elemSize();
+        size_t size = row_bytes * m_.rows;
+
+        zmq::message_t msg = FramePool::instance().createMessage(sizeof(ImageHeader) + size);
+        uchar* out = static_cast<uchar*>(msg.data());
+        writeHeader(out, IMAGE_ENCODING_RAW, size);
+        out += sizeof(ImageHeader);
+
+        if (m_.isContinuous()) {
+            memcpy(out, m_.data, size);
         } else {
-            fixed = m_; // zero-copy
+            for (int i = 0; i < m_.rows; i++) {
+                memcpy(out + i * row_bytes, m_.ptr(i), row_bytes);
+            }
+        }
+
+        return msg;
+    }
+
+    // Сериализация с межкадровым кодированием: ключевой кадр целиком или разность.
+    // После отправки вызывающий обязан сделать encoder.commit() или encoder.rollback().
+    zmq::message_t serialize(DeltaEncoder& encoder)
+    {
+        std::vector<uchar> delta;
+        if (!encoder.encode(m_, id, delta)) {
+            return serialize();
         }
 
-        size_t size = fixed.total() * fixed.elemSize();
-        size_t rows = fixed.rows;
-        size_t cols = fixed.cols;
-        
-        std::stringstream ss;
+        zmq::message_t msg = FramePool::instance().createMessage(sizeof(ImageHeader) + delta.size());
+        uchar* out = static_cast<uchar*>(msg.data());
+        writeHeader(out, IMAGE_ENCODING_DELTA, delta.size());
+        memcpy(out + sizeof(ImageHeader), delta.data(), delta.size());
+        return msg;
+    }
 
-        ss.write((char*)&id, sizeof(id));
-        ss.write((char*)&size, sizeof(size));
-        ss.write((char*)&rows, sizeof(rows));
-        ss.write((char*)&cols, sizeof(cols));
-        ss.write((char*)fixed.data, size);
+    // Десериализация без копирования: m_ становится видом на пиксели внутри сообщения.
+    // Возвращает false, если заголовок испорчен, размеры не сходятся с длиной сообщения
+    // или кадр закодирован разностью (для нее нужен DeltaDecoder).
+    bool deserialize(zmq::message_t&& image)
+    {
+        ParsedHeader header;
+        if (!parseHeader(image, header) || header.encoding != IMAGE_ENCODING_RAW) {
+            return false;
+        }
+        if (header.size != header.step * header.rows) {
+            return false;
+        }
 
-        return ss.str();
+        id = header.id;
+        capture_begin_us = header.capture_begin_us;
+        capture_end_us = header.capture_end_us;
+        m_ = wrapMessageInMat(std::move(image), (int)header.rows, (int)header.cols, header.type,
+                              header.step, header.header_size);
+        return true;
     }
 
-    void deserialize(const std::string& image)
+    // Десериализация потока с межкадровым кодированием.
+    // Ключевой кадр принимается без копирования и становится опорным для decoder.
+    // false - кадр испорчен или разность не от нашего опорного кадра (ждем ключевой).
+    bool deserialize(zmq::message_t&& image, DeltaDecoder& decoder)
     {
-        std::stringstream ss(image);
-        
-        size_t size; 
-        size_t rows; 
-        size_t cols;
-        
-        ss.read((char*)&id, sizeof(id));
-        ss.read((char*)&size, sizeof(size));
-        ss.read((char*)&rows, sizeof(rows));
-        ss.read((char*)&cols, sizeof(cols));
-
-        m_ = cv::Mat(cv::Size(cols,rows),CV_8UC3);
-        ss.read((char*)m_.data, size);
+        ParsedHeader header;
+        if (!parseHeader(image, header)) {
+            return false;
+        }
+
+        if (header.encoding == IMAGE_ENCODING_RAW) {
+            if (!deserialize(std::move(image))) {
+                return false;
+            }
+            decoder.setKeyframe(m_, id);
+            return true;
+        }
+        if (header.encoding != IMAGE_ENCODING_DELTA) {
+            return false;
+        }
+
+        const uchar* data = static_cast<const uchar*>(image.data()) + header.header_size;
+        cv::Mat frame = decoder.applyDelta(data, header.size, (int)header.rows, (int)header.cols,
+                                           header.type, header.id);
+        if (frame.empty()) {
+            return false;
+        }
+
+        id = header.id;
+        capture_begin_us = header.capture_begin_us;
+        capture_end_us = header.capture_end_us;
+        m_ = frame;
+        return true;
+    }
+
+private:
+    struct ParsedHeader
+    {
+        uint16_t header_size;
+        uint16_t encoding;
+        uint64_t id;
+        uint64_t size;
+        uint32_t rows;
+        uint32_t cols;
+        int type;
+        uint64_t step;
+        uint64_t capture_begin_us;
+        uint64_t capture_end_us;
+    };
+
+    void writeHeader(uchar* out, uint16_t encoding, size_t size) const
+    {
+        ImageHeader header;
+        header.magic = toWireOrder(IMAGE_MAGIC);
+        header.version = toWireOrder(IMAGE_VERSION);
+        header.header_size = toWireOrder<uint16_t>(sizeof(ImageHeader));
+        header.id = toWireOrder<uint64_t>(id);
+        header.size = toWireOrder<uint64_t>(size);
+        header.rows = toWireOrder<uint32_t>(m_.rows);
+        header.cols = toWireOrder<uint32_t>(m_.cols);
+        header.type = toWireOrder<int32_t>(m_.type());
+        header.encoding = toWireOrder<uint16_t>(encoding);
+        header.reserved = 0;
+        header.step = toWireOrder<uint64_t>(m_.cols * m_.elemSize());
+        header.capture_begin_us = toWireOrder<uint64_t>(capture_begin_us);
+        header.capture_end_us = toWireOrder<uint64_t>(capture_end_us);
+        memcpy(out, &header, sizeof(header));
+    }
+
+    // Разбор и проверка заголовка всех версий; size проверяется на длину сообщения
+    static bool parseHeader(const zmq::message_t& image, ParsedHeader& parsed)
+    {
+        if (image.size() < IMAGE_HEADER_SIZE_V1) {
+            return false;
+        }
+
+        ImageHeader header;
+        memset(&header, 0, sizeof(header));
+        memcpy(&header, image.data(), std::min(image.size(), sizeof(header)));
+
+        uint32_t magic = fromWireOrder(header.magic);
+        uint16_t version = fromWireOrder(header.version);
+        parsed.header_size = fromWireOrder(header.header_size);
+        parsed.id = fromWireOrder(header.id);
+        parsed.size = fromWireOrder(header.size);
+        parsed.rows = fromWireOrder(header.rows);
+        parsed.cols = fromWireOrder(header.cols);
+        parsed.type = fromWireOrder(header.type);
+        parsed.encoding = fromWireOrder(header.encoding);
+        parsed.step = fromWireOrder(header.step);
+        parsed.capture_begin_us = 0;
+        parsed.capture_end_us = 0;
+
+        if (magic != IMAGE_MAGIC) {
+            return false;
+        }
+        if (version == IMAGE_VERSION_1 && parsed.header_size == IMAGE_HEADER_SIZE_V1) {
+            parsed.type = CV_8UC3;
+            parsed.encoding = IMAGE_ENCODING_RAW;
+            parsed.step = (uint64_t)parsed.cols * CV_ELEM_SIZE(CV_8UC3);
+        } else if (version == IMAGE_VERSION_2 && parsed.header_size == IMAGE_HEADER_SIZE_V3) {
+            parsed.encoding = IMAGE_ENCODING_RAW;
+        } else if (version == IMAGE_VERSION_3 && parsed.header_size == IMAGE_HEADER_SIZE_V3) {
+            // Время захвата не передавалось
+        } else if (version == IMAGE_VERSION && parsed.header_size == sizeof(ImageHeader)) {
+            parsed.capture_begin_us = fromWireOrder(header.capture_begin_us);
+            parsed.capture_end_us = fromWireOrder(header.capture_end_us);
+        } else {
+            return false;
+        }
+        if (image.size() < parsed.header_size) {
+            return false;
+        }
+
+        if (parsed.rows == 0 || parsed.cols == 0 || parsed.rows > INT_MAX || parsed.cols > INT_MAX) {
+            return false;
+        }
+        if (parsed.type < 0 || CV_MAT_TYPE(parsed.type) != parsed.type) {
+            return false;
+        }
+
+        uint64_t row_bytes = (uint64_t)parsed.cols * CV_ELEM_SIZE(parsed.type);
+        if (parsed.step < row_bytes || parsed.step > (uint64_t)SIZE_MAX / parsed.rows) {
+            return false;
+        }
+        return image.size() - parsed.header_size == parsed.size;
+    }
+
+    static bool isBigEndianHost()
+    {
+        const uint16_t probe = 1;
+        return *reinterpret_cast<const uint8_t*>(&probe) == 0;
+    }
+
+    template <typename T>
+    static T toWireOrder(T value)
+    {
+        if (!isBigEndianHost()) {
+            return value;
+        }
+        T swapped;
+        const uint8_t* src = reinterpret_cast<const uint8_t*>(&value);
+        uint8_t* dst = reinterpret_cast<uint8_t*>(&swapped);
+        for (size_t i = 0; i < sizeof(T); i++) {
+            dst[i] = src[sizeof(T) - 1 - i];
+        }
+        return swapped;
     }
 
-    void deserialize(zmq::message_t image)
+    template <typename T>
+    static T fromWireOrder(T value)
     {
-        std::string im_str((char*)image.data(),image.size());
-        deserialize(std::move(im_str));
+        return toWireOrder(value);
     }
-};
\ No newline at end of file
+};
@@ -0,0 +1,392 @@
+#include <iostream>
+#include <algorithm>
+#include <cerrno>
+#include <chrono>
+#include <cstdlib>
+#include <thread>
+#include "capturer.h"
+#include "ImageStructure.hpp"
+#include "metrics.h"
+
+// Метрики захвата
+struct CapturerMetrics
+{
+    Counter& captured = MetricsRegistry::instance().counter("capturer_frames_total");
+    Counter& bytes = MetricsRegistry::instance().counter("capturer_bytes_total");
+    Counter& dropped = MetricsRegistry::instance().counter("capturer_dropped_frames_total");
+    Counter& skipped = MetricsRegistry::instance().counter("capturer_skipped_frames_total");
+    Counter& replaced = MetricsRegistry::instance().counter("capturer_replaced_frames_total");
+    Counter& paced = MetricsRegistry::instance().counter("capturer_paced_frames_total");
+    Counter& delta_mismatches = MetricsRegistry::instance().counter("capturer_delta_mismatch_total");
+    LatencyHistogram& encode_time = MetricsRegistry::instance().histogram("capturer_encode_us");
+    Gauge& credits = MetricsRegistry::instance().gauge("capturer_credits");
+    Gauge& queue = MetricsRegistry::instance().gauge("capturer_queue");
+};
+
+// Предел накопленных кредитов: ошибочный или чужой "CREDIT <n>" не отключает управление потоком
+static const int64_t MAX_CREDITS = 1024;
+
+static CapturerMetrics& metrics()
+{
+    static CapturerMetrics instance;
+    return instance;
+}
+
+Capturer::Capturer(Utils& settings) : frame_counter(0)
+    , zmq_ctx(1) // Инициализация контекста ZeroMQ с одним потоком ввода-вывода
+    , socket(zmq_ctx, zmq::socket_type::push) // Инициализация сокета PUSH
+    , credit_socket(zmq_ctx, zmq::socket_type::pull)
+    , use_credits(false)
+    , credits(0)
+    , skipped_frames(0)
+    , replaced_frames(0)
+    , use_delta(false)
+    , verify_delta(false)
+    , delta_threshold(0)
+    , delta_mismatches(0)
+    , paced_frames(0)
+    , settings(settings)
+    , output(nullptr)
+    , running(false)
+{
+    std::cout << "=== Capturer Initialization ===" << std::endl;
+    temp_dir = "./camera_capture";
+    std::filesystem::create_directories(temp_dir);
+
+    std::shared_ptr<const ConfigSnapshot> config = settings.getConfigSnapshot();
+
+    init_camera();
+    init_zmq(config->server);
+    init_delta(config->server);
+    std::cout << "======================================================" << std::endl;
+}
+
+Capturer::Capturer(FrameQueue<PipelineFrame>& queue, Utils& settings) : frame_counter(0)
+    , zmq_ctx(1)
+    , use_credits(false)
+    , credits(0)
+    , skipped_frames(0)
+    , replaced_frames(0)
+    , use_delta(false)
+    , verify_delta(false)
+    , delta_threshold(0)
+    , delta_mismatches(0)
+    , paced_frames(0)
+    , settings(settings)
+    , output(&queue)
+    , running(false)
+{
+    std::cout << "=== Capturer Initialization (in-process) ===" << std::endl;
+    temp_dir = "./camera_capture";
+    std::filesystem::create_directories(temp_dir);
+    init_camera();
+    std::cout << "======================================================" << std::endl;
+}
+
+void Capturer::init_camera()
+{
+    std::cout << "Searching for camera..." << std::endl;
+    for (int i = 0; i < 10; i++)
+    {
+        cap.open(i); // Попытка открыть камеру с текущим ID
+        if (cap.isOpened()) // Проверка успешности открытия камеры
+        {
+            cap.set(cv::CAP_PROP_FRAME_WIDTH, 640); // Установка ширины кадра
+            cap.set(cv::CAP_PROP_FRAME_HEIGHT, 480); // Установка высоты кадра
+            cap.set(cv::CAP_PROP_FPS, 30); // Установка частоты кадров
+            std::cout << "- [ OK ] Camera found at ID: " << i << std::endl;
+            return;
+        }
+    }
+    throw std::runtime_error("- [FAIL] No camera found!");
+}
+
+void Capturer::init_zmq(const ServerConfig& config)
+{
+    try {
+        // Неотправленные кадры устаревают: очередь держим короткой
+        int send_buffer_limit = config.send_queue_depth;
+        socket.set(zmq::sockopt::sndhwm, send_buffer_limit); // Установка лимита буфера отправки
+
+        socket.set(zmq::sockopt::linger, 0); // Установка нулевого времени ожидания при закрытии сокета
+        socket.set(zmq::sockopt::immediate, 1); // Включение немедленной отправки
+
+        socket.bind("tcp://localhost:5555"); // Привязка сокета
+
+        std::cout << "- [ OK ] ZMQ socket bound" << std::endl;
+        std::cout << "- [ INFO ] Send buffer limit (HWM): " << send_buffer_limit << " messages" << std::endl;
+
+        int credit_port = config.credit_port;
+        use_credits = credit_port > 0;
+        if (use_credits) {
+            credit_socket.set(zmq::sockopt::linger, 0);
+            credit_socket.bind("tcp://localhost:" + std::to_string(credit_port));
+            std::cout << "- [ OK ] Credit socket bound on port " << credit_port << std::endl;
+        }
+    }
+    catch (const zmq::error_t& e) {
+        throw std::runtime_error(std::string("- [FAIL] ZMQ bind error: ") + e.what());
+    }
+}
+
+void Capturer::init_delta(const ServerConfig& config)
+{
+    int keyframe_interval = config.delta_keyframe_interval;
+    int tile_size = config.delta_tile_size;
+    int threshold = config.delta_threshold;
+
+    use_delta = keyframe_interval > 0;
+    if (use_delta) {
+        delta_encoder = DeltaEncoder(keyframe_interval, tile_size, threshold);
+        std::cout << "- [ INFO ] Delta coding: keyframe every " << keyframe_interval
+            << " frames, tile " << tile_size << ", threshold " << threshold << std::endl;
+        std::cout << "- [ INFO ] Receivers must decode with DeltaDecoder, otherwise only keyframes are readable" << std::endl;
+        verify_delta = config.delta_verify;
+        delta_threshold = threshold;
+        if (verify_delta) {
+            std::cout << "- [ INFO ] Delta verification enabled: every sent frame is decoded and compared" << std::endl;
+        }
+    } else {
+        std::cout << "- [ INFO ] Delta coding disabled, sending full frames" << std::endl;
+    }
+}
+
+bool Capturer::deliver(cv::Mat& frame, const FrameTrace& trace, size_t& delivered_size)
+{
+    if (output) {
+        // В очередь уходит заголовок Mat, пиксели не копируются.
+        // Если стадия не успевает, вытесняется самый старый кадр - задержка не растет
+        delivered_size = frame.total() * frame.elemSize();
+        bool replaced = false;
+        if (!output->pushDropOldest(PipelineFrame{frame, frame_counter, trace}, replaced)) {
+            return false;
+        }
+        if (replaced) {
+            metrics().replaced.add();
+        }
+        metrics().queue.set(output->size());
+        if (replaced && ++replaced_frames % 50 == 0) {
+            std::cout << "- [ WARN ] Queue full, replaced " << replaced_frames << " stale frames total" << std::endl;
+        }
+        return true;
+    }
+
+    // Сериализация кадра
+    zmq::message_t msg;
+    {
+        ScopedTimer timer(metrics().encode_time);
+        ImageStructure is1(frame, frame_counter); // Создание структуры изображения с кадром и номером
+        if (trace.span_count > 0) {
+            is1.capture_begin_us = trace.spans[0].begin_us;
+            is1.capture_end_us = trace.spans[0].end_us;
+        }
+        msg = use_delta ? is1.serialize(delta_encoder) : is1.serialize(); // Сериализация прямо в сообщение ZeroMQ
+    }
+    delivered_size = msg.size();
+
+    // После send сообщение пустое: для сверки нужна копия
+    zmq::message_t sent_copy;
+    if (verify_delta) {
+        sent_copy.copy(msg);
+    }
+
+    zmq::send_flags flags = zmq::send_flags::dontwait; // Установка флага неблокирующей отправки
+    auto result = socket.send(msg, flags); // Попытка отправить сообщение
+
+    if (!result.has_value()) { // Проверка, удалось ли отправить сообщение
+        delta_encoder.rollback(); // Получатель кадр не увидит - опорный не меняется
+        return false;
+    }
+    delta_encoder.commit(); // Кадр ушел - теперь он опорный для следующей разности
+    if (verify_delta) {
+        verify_delta_frame(std::move(sent_copy), frame);
+    }
+    return true;
+}
+
+void Capturer::verify_delta_frame(zmq::message_t&& sent, const cv::Mat& frame)
+{
+    // Декодер видит только ушедшие кадры, как получатель: если откат кодера сломан,
+    // следующая разность окажется построенной не от его опорного кадра
+    cv::Mat decoded;
+    ImageStructure received(decoded);
+    bool decoded_ok = received.deserialize(std::move(sent), verify_decoder);
+
+    double difference = -1;
+    if (decoded_ok && received.id == frame_counter && decoded.size() == frame.size()
+        && decoded.type() == frame.type()) {
+        difference = cv::norm(decoded, frame, cv::NORM_INF);
+    }
+    if (difference >= 0 && difference <= delta_threshold) {
+        return;
+    }
+
+    delta_mismatches++;
+    metrics().delta_mismatches.add();
+    if (delta_mismatches != 1 && delta_mismatches % 50 != 0) {
+        return; // После потери опорного кадра ошибки идут подряд до ключевого
+    }
+    if (difference < 0) {
+        std::cout << "- [FAIL] Delta verification: frame " << frame_counter << " could not be decoded ("
+            << verify_decoder.getSkippedDeltas() << " deltas skipped, " << delta_mismatches << " mismatches total)" << std::endl;
+    } else {
+        std::cout << "- [FAIL] Delta verification: frame " << frame_counter << " differs by " << difference
+            << " > threshold " << delta_threshold << " (" << delta_mismatches << " mismatches total)" << std::endl;
+    }
+}
+
+void Capturer::setDemand(std::function<bool()> ready)
+{
+    demand = std::move(ready);
+}
+
+void Capturer::run()
+{
+    std::cout << "=== Capturer Started ===" << std::endl;
+    std::cout << "Displaying camera feed..." << std::endl;
+
+    cv::Mat frame; // Матрица для хранения текущего кадра
+    int dropped_frames = 0; // Счётчик пропущенных кадров
+    auto next_frame_time = std::chrono::steady_clock::now();
+    running = true;
+
+    while (running)
+    {
+        // Ограничение частоты: до срока следующего кадра камера только опустошается
+        int target_fps = settings.getConfigSnapshot()->server.target_fps;
+        auto now = std::chrono::steady_clock::now();
+        if (target_fps > 0 && now < next_frame_time) {
+            if (!cap.grab()) {
+                std::this_thread::sleep_for(std::chrono::milliseconds(100));
+            }
+            paced_frames++;
+            metrics().paced.add();
+            if (paced_frames % 100 == 0) {
+                std::cout << "- [ INFO ] Limited to " << target_fps << " fps, skipped " << paced_frames << " frames total" << std::endl;
+            }
+            continue;
+        }
+        if (target_fps > 0) {
+            // Срок считается от предыдущего, чтобы частота не уплывала из-за задержек камеры
+            auto period = std::chrono::microseconds(1000000 / target_fps);
+            next_frame_time = std::max(next_frame_time + period, now);
+        }
+
+        bool receiver_busy = false;
+        if (use_credits) {
+            receive_credits(0);
+            receiver_busy = credits <= 0;
+        } else if (output && demand) {
+            receiver_busy = !demand();
+        }
+        if (receiver_busy) {
+            // Получатель занят: кадр забирается из камеры без декодирования и пропускается
+            if (!cap.grab()) {
+                std::this_thread::sleep_for(std::chrono::milliseconds(100));
+            }
+            skipped_frames++;
+            metrics().skipped.add();
+            if (skipped_frames % 50 == 0) {
+                std::cout << "- [ WARN ] Receiver busy, skipped " << skipped_frames << " frames total" << std::endl;
+            }
+            continue;
+        }
+
+        FrameTrace trace;
+        trace.capture_us = traceNowUs();
+        if (!cap.read(frame) || frame.empty()) // Попытка захватить кадр
+        {
+            std::cout << "- [FAIL] Failed to grab frame" << std::endl;
+            std::this_thread::sleep_for(std::chrono::milliseconds(100));
+            continue;
+        }
+
+        trace.addSpan(TraceStage::Capture, trace.capture_us, traceNowUs());
+
+        size_t serialized_size = 0;
+        if (!deliver(frame, trace, serialized_size)) { // Попытка передать кадр дальше
+            dropped_frames++; // Увеличение счётчика пропущенных кадров
+            metrics().dropped.add();
+            if (dropped_frames % 50 == 0) {
+                std::cout << "- [ WARN ] Buffer full, dropped " << dropped_frames << " frames total" << std::endl; // Каждые 50 пропущенных кадров выводить предупреждение
+            }
+            continue;
+        }
+        if (use_credits) {
+            credits--;
+            metrics().credits.set(credits);
+        }
+        metrics().captured.add();
+        metrics().bytes.add(serialized_size);
+
+        // Вывод информации об отправленном кадре
+        std::cout << "- [ OK ] Sent frame: " << frame_counter 
+            << " Size: " << frame.cols << "x" << frame.rows
+            << " Channels: " << frame.channels()
+            << " Serialized size: " << serialized_size << " bytes" << std::endl;
+
+
+        if (frame_counter) {
+            std::string filename = (temp_dir / ("frame_" + std::to_string(frame_counter) + ".jpg")).string();
+            cv::imwrite(filename, frame); 
+            //std::cout << "  Saved: " << filename << std::endl; // Вывод сообщения о сохранении
+        }
+
+        std::cout << "- [ OK ] Captured frame: " << frame_counter++
+            << " Size: " << frame.cols << "x" << frame.rows
+            << " Channels: " << frame.channels() << std::endl;
+
+        if (output) {
+            frame.release(); // Буфер теперь принадлежит очереди - следующий read() выделит новый
+        }
+
+    //if (cv::waitKey(1) == 27) break;
+    }
+
+    cap.release(); // Освобождение ресурсов камеры
+    cv::destroyAllWindows(); // Закрытие всех окон OpenCV
+}
+
+void Capturer::receive_credits(int wait_ms)
+{
+    try {
+        zmq::pollitem_t items[] = {{static_cast<void*>(credit_socket), 0, ZMQ_POLLIN, 0}};
+        zmq::poll(items, 1, std::chrono::milliseconds(wait_ms));
+        if (!(items[0].revents & ZMQ_POLLIN)) {
+            return;
+        }
+
+        zmq::message_t msg;
+        while (credit_socket.recv(msg, zmq::recv_flags::dontwait)) {
+            std::string text = msg.to_string();
+            if (text.compare(0, 6, "CREDIT") != 0) {
+                std::cout << "- [ WARN ] Unknown flow control message: " << text << std::endl;
+                continue;
+            }
+
+            // "CREDIT" - один кадр, "CREDIT <n>" - n > 0 кадров; иначе сообщение отбрасывается
+            long long granted = 1;
+            if (text.size() > 6) {
+                const char* begin = text.c_str() + 6;
+                char* end = nullptr;
+                errno = 0;
+                granted = std::strtoll(begin, &end, 10);
+                if (end == begin || *end != '\0' || errno == ERANGE || granted <= 0) {
+                    std::cout << "- [ WARN ] Invalid credit message: " << text << std::endl;
+                    continue;
+                }
+            }
+            // Получатель не может разрешить больше MAX_CREDITS кадров вперед
+            credits = std::min<int64_t>(credits + std::min<long long>(granted, MAX_CREDITS), MAX_CREDITS);
+            metrics().credits.set(credits);
+        }
+    }
+    catch (const zmq::error_t& e) {
+        std::cout << "- [FAIL] Credit receive error: " << e.what() << std::endl;
+    }
+}
+
+void Capturer::stop()
+{
+    running = false;
+}
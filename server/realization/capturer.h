@@ -0,0 +1,100 @@
+#ifndef _CAPTURER_H_
+#define _CAPTURER_H_
+
+#include <atomic>
+#include <cstdint>
+#include <filesystem>
+#include <functional>
+#include <string>
+#include <opencv2/opencv.hpp>
+#include <zmq.hpp>
+#include "deltaCodec.h"
+#include "frameQueue.h"
+#include "frameTrace.h"
+#include "utils.h"
+
+// Захват кадров с камеры.
+// Кадры уходят либо в сокет PUSH (отдельный процесс сервера),
+// либо в очередь внутри процесса (режим pipeline) без сериализации.
+//
+// Управление потоком в режиме PUSH (server.credit_port > 0): получатель присылает
+// на сокет PULL сообщения "CREDIT" или "CREDIT <n>", каждое разрешает отправить n кадров.
+// Кредиты присылает внешний получатель потока PUSH; сообщения с n <= 0 отбрасываются,
+// накопленные кредиты ограничены сверху.
+// В очередь внутри процесса кадр не захватывается, пока потребитель занят (setDemand):
+// в режиме dispatcher - пока нет свободных worker'ов, а в очереди уже ждет кадр.
+// Без кредитов кадр только захватывается (grab) и пропускается без декодирования,
+// поэтому в очереди не копятся устаревшие кадры. В очередь внутри процесса при
+// переполнении вытесняется самый старый кадр, а не новый.
+//
+// Поток PUSH читают внешние получатели: кадр разбирается ImageStructure::deserialize.
+// При межкадровом кодировании (server.delta_keyframe_interval > 0) получателю нужен
+// свой DeltaDecoder на соединение и deserialize(msg, decoder); без него разностные
+// кадры отбрасываются и остаются только ключевые. server.delta_verify включает проверку
+// кодека на месте: каждый ушедший кадр декодируется так же, как у получателя, и сверяется
+// с исходным (ключевые кадры, разности и откат неотправленных кадров).
+//
+// Частота кадров (server.target_fps) читается из снимка конфигурации на каждом кадре,
+// поэтому ее можно снизить через канал управления; лишние кадры пропускаются через grab.
+class Capturer
+{
+private:
+    cv::VideoCapture cap; // Объект для захвата видео с камеры
+    uint64_t frame_counter; // Счётчик кадров
+    std::filesystem::path temp_dir;
+
+    zmq::context_t zmq_ctx; // Контекст ZeroMQ
+    zmq::socket_t socket; // Сокет ZeroMQ для отправки данных
+    zmq::socket_t credit_socket; // Кредиты от получателя (PULL)
+
+    bool use_credits; // Отправка только по кредитам получателя
+    int64_t credits; // Сколько кадров еще можно отправить
+    uint64_t skipped_frames; // Пропущено из-за отсутствия кредитов
+    uint64_t replaced_frames; // Вытеснено из очереди более новыми кадрами
+
+    bool use_delta; // Межкадровое кодирование включено
+    DeltaEncoder delta_encoder; // Разность с предыдущим отправленным кадром
+    bool verify_delta; // Сверка отправленного с тем, что восстановит получатель (server.delta_verify)
+    DeltaDecoder verify_decoder; // Декодер получателя: видит только ушедшие кадры
+    int delta_threshold; // Допустимое отличие восстановленного кадра
+    uint64_t delta_mismatches;
+
+    uint64_t paced_frames; // Пропущено ради server.target_fps
+
+    Utils& settings; // Источник снимков конфигурации, принадлежит владельцу Capturer
+    FrameQueue<PipelineFrame>* output; // Очередь режима pipeline, nullptr - отправка в сокет
+    std::function<bool()> demand; // Потребитель очереди готов принять кадр; пусто - всегда
+    std::atomic<bool> running; // Флаг работы цикла захвата
+
+public:
+    // Отправка кадров в сокет PUSH; конфигурация уже загружена в settings
+    explicit Capturer(Utils& settings);
+
+    // Передача кадров в очередь того же процесса
+    Capturer(FrameQueue<PipelineFrame>& queue, Utils& settings);
+
+    // Готовность потребителя очереди; задается до run()
+    void setDemand(std::function<bool()> ready);
+
+    void run();
+
+    // Остановка цикла захвата из другого потока
+    void stop();
+
+private:
+    void init_camera();
+    void init_zmq(const ServerConfig& config); // Глубина очереди отправки и кредиты (server.send_queue_depth, server.credit_port)
+    void init_delta(const ServerConfig& config); // Настройки межкадрового кодирования из config.yaml (server.delta_*)
+
+    // Прием всех пришедших кредитов; wait_ms - сколько ждать, если кредитов нет
+    void receive_credits(int wait_ms);
+
+    // Отправка кадра дальше по конвейеру; false - кадр отброшен.
+    // trace - время захвата, уходит вместе с кадром
+    bool deliver(cv::Mat& frame, const FrameTrace& trace, size_t& delivered_size);
+
+    // Декодирование ушедшего сообщения и сравнение с кадром; расхождение - в лог и метрику
+    void verify_delta_frame(zmq::message_t&& sent, const cv::Mat& frame);
+};
+
+#endif // _CAPTURER_H_
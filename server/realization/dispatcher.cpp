@@ -0,0 +1,294 @@
+#include <iostream>
+#include <algorithm>
+#include "dispatcher.h"
+#include "frameWire.h"
+#include "metrics.h"
+
+// Метрики балансировщика
+struct DispatcherMetrics
+{
+    Counter& dispatched = MetricsRegistry::instance().counter("dispatcher_frames_dispatched_total");
+    Counter& lost = MetricsRegistry::instance().counter("dispatcher_frames_lost_total");
+    LatencyHistogram& worker_time = MetricsRegistry::instance().histogram("dispatcher_worker_us");
+    Gauge& workers = MetricsRegistry::instance().gauge("dispatcher_workers");
+    Gauge& idle = MetricsRegistry::instance().gauge("dispatcher_idle_workers");
+    Gauge& input_queue = MetricsRegistry::instance().gauge("dispatcher_input_queue");
+    Gauge& output_queue = MetricsRegistry::instance().gauge("dispatcher_output_queue");
+};
+
+static DispatcherMetrics& metrics()
+{
+    static DispatcherMetrics instance;
+    return instance;
+}
+
+Dispatcher::Dispatcher(FrameQueue<PipelineFrame>& input, FrameQueue<DispatchResult>& output,
+                       const std::string& address, const std::string& codec_name, int worker_timeout_ms)
+    : input(input)
+    , output(output)
+    , zmq_ctx(1)
+    , socket(zmq_ctx, zmq::socket_type::router)
+    , codec(CodecRegistry::instance().find(codec_name))
+    , worker_timeout(worker_timeout_ms)
+    , dispatched_frames(0)
+    , lost_frames(0)
+    , idle_workers(0)
+    , running(false)
+{
+    if (!codec) {
+        std::cout << "- [ WARN ] Unknown codec '" << codec_name << "', using raw" << std::endl;
+        codec = CodecRegistry::instance().find(CodecId::Raw);
+    }
+
+    try {
+        socket.set(zmq::sockopt::router_mandatory, 1); // Отправка ушедшему worker'у - ошибка, а не тихий сброс
+        socket.set(zmq::sockopt::linger, 0);
+        socket.set(zmq::sockopt::sndtimeo, 1000);
+        socket.bind(address);
+
+        std::cout << "- [ OK ] Dispatcher bound to " << address << " (codec " << codec->name() << ")" << std::endl;
+    }
+    catch (const zmq::error_t& e) {
+        throw std::runtime_error(std::string("- [FAIL] Dispatcher bind error: ") + e.what());
+    }
+}
+
+void Dispatcher::run()
+{
+    std::cout << "=== Dispatcher Started ===" << std::endl;
+    running = true;
+    last_report = std::chrono::steady_clock::now();
+
+    while (running)
+    {
+        try {
+            // Пока есть свободные worker'ы, очередь кадров опрашивается чаще
+            zmq::pollitem_t items[] = {{static_cast<void*>(socket), 0, ZMQ_POLLIN, 0}};
+            zmq::poll(items, 1, std::chrono::milliseconds(idle.empty() ? 100 : 5));
+
+            if (items[0].revents & ZMQ_POLLIN) {
+                handleMessage();
+            }
+        }
+        catch (const zmq::error_t& e) {
+            std::cout << "- [FAIL] Dispatcher receive error: " << e.what() << std::endl;
+        }
+
+        expireWorkers();
+        dispatchFrames();
+        idle_workers = idle.size();
+        reportStats();
+    }
+}
+
+void Dispatcher::stop()
+{
+    running = false;
+}
+
+size_t Dispatcher::getIdleWorkers() const
+{
+    return idle_workers;
+}
+
+void Dispatcher::handleMessage()
+{
+    // Конверт REQ: routing id, пустой разделитель, тело
+    std::vector<zmq::message_t> parts;
+    do {
+        parts.emplace_back();
+        socket.recv(parts.back(), zmq::recv_flags::none);
+    } while (parts.back().more());
+
+    if (parts.size() < 3 || parts[1].size() != 0) {
+        std::cout << "- [ WARN ] Malformed message from worker (" << parts.size() << " parts)" << std::endl;
+        return;
+    }
+
+    std::string worker = parts[0].to_string();
+    auto known = workers.find(worker);
+    if (known == workers.end()) {
+        std::cout << "- [ INFO ] Worker connected (" << workers.size() + 1 << " total)" << std::endl;
+        known = workers.emplace(worker, WorkerState()).first;
+    }
+    WorkerState& state = known->second;
+
+    if (parts.size() == 3 && parts[2].to_string() == "READY") {
+        if (!state.busy && std::find(idle.begin(), idle.end(), worker) == idle.end()) {
+            idle.push_back(worker);
+            state.since = std::chrono::steady_clock::now();
+        }
+        return;
+    }
+
+    // Обработанный кадр: заголовок + данные или одно сообщение BMP (старый формат)
+    cv::Mat processed;
+    FrameTrace trace;
+    if (parts.size() == 4) {
+        uint64_t frame_id = 0;
+        const ImageCodec* received_codec = nullptr;
+        processed = decodeFrame(parts[2], std::move(parts[3]), frame_id, received_codec, &trace);
+    } else if (parts.size() == 3) {
+        const uchar* data = static_cast<const uchar*>(parts[2].data());
+        processed = cv::imdecode(std::vector<uchar>(data, data + parts[2].size()), cv::IMREAD_COLOR);
+    }
+
+    try {
+        replyText(worker, "DONE"); // REQ ждет ответ на каждое сообщение
+    }
+    catch (const zmq::error_t& e) {
+        std::cout << "- [ WARN ] Failed to confirm result: " << e.what() << std::endl;
+    }
+
+    if (!state.busy) {
+        std::cout << "- [ WARN ] Unexpected result from idle worker" << std::endl;
+        return;
+    }
+
+    double elapsed_ms = std::chrono::duration<double, std::milli>(
+        std::chrono::steady_clock::now() - state.since).count();
+    state.busy = false;
+    state.since = std::chrono::steady_clock::now();
+    state.completed++;
+    state.last_ms = elapsed_ms;
+    state.average_ms = state.completed == 1 ? elapsed_ms : 0.8 * state.average_ms + 0.2 * elapsed_ms;
+    metrics().worker_time.record(static_cast<uint64_t>(elapsed_ms * 1000));
+
+    if (processed.empty()) {
+        lost_frames++;
+        metrics().lost.add();
+        std::cout << "- [ WARN ] Failed to decode result of frame " << state.frame.id << std::endl;
+    } else if (!output.tryPush(DispatchResult{state.frame, processed, worker,
+                                              trace.empty() ? state.frame.trace : trace})) {
+        std::cout << "- [ WARN ] Result queue full, frame " << state.frame.id << " dropped" << std::endl;
+    }
+    state.frame = PipelineFrame();
+}
+
+void Dispatcher::dispatchFrames()
+{
+    while (!idle.empty())
+    {
+        PipelineFrame frame;
+        if (!input.popFor(frame, std::chrono::milliseconds(0))) {
+            return;
+        }
+
+        // Ожидание в очереди - от конца захвата до отправки worker'у
+        frame.trace.addSpan(TraceStage::ServerQueue, frame.trace.lastEndUs(), traceNowUs());
+
+        zmq::message_t header;
+        zmq::message_t payload;
+        const ImageCodec* used_codec = codec;
+        encodeFrame(frame.image, frame.id, used_codec, header, payload, &frame.trace);
+
+        bool sent = false;
+        while (!sent && !idle.empty())
+        {
+            // Свободный worker с наименьшим средним временем обработки; новые (0 мс) - первыми
+            auto best = std::min_element(idle.begin(), idle.end(), [this](const std::string& a, const std::string& b) {
+                return workers[a].average_ms < workers[b].average_ms;
+            });
+            std::string worker = *best;
+            idle.erase(best);
+
+            try {
+                reply(worker, header, payload);
+                sent = true;
+            }
+            catch (const zmq::error_t& e) {
+                std::cout << "- [ WARN ] Worker unreachable, removed: " << e.what() << std::endl;
+                workers.erase(worker);
+                // Сообщения после неудачной отправки могли быть израсходованы - кодируем заново
+                used_codec = codec;
+                encodeFrame(frame.image, frame.id, used_codec, header, payload, &frame.trace);
+                continue;
+            }
+
+            WorkerState& state = workers[worker];
+            state.busy = true;
+            state.frame = frame;
+            state.since = std::chrono::steady_clock::now();
+            dispatched_frames++;
+            metrics().dispatched.add();
+        }
+
+        if (!sent) {
+            lost_frames++;
+            metrics().lost.add();
+        }
+    }
+}
+
+void Dispatcher::expireWorkers()
+{
+    auto now = std::chrono::steady_clock::now();
+
+    // REQ worker сам бросает ожидание по таймауту - устаревший READY не используем
+    idle.erase(std::remove_if(idle.begin(), idle.end(), [&](const std::string& worker) {
+        return now - workers[worker].since > worker_timeout;
+    }), idle.end());
+
+    for (auto it = workers.begin(); it != workers.end();)
+    {
+        const WorkerState& state = it->second;
+        bool waiting = std::find(idle.begin(), idle.end(), it->first) != idle.end();
+        if (state.busy && now - state.since > worker_timeout) {
+            lost_frames++;
+            metrics().lost.add();
+            std::cout << "- [ WARN ] Worker timed out on frame " << state.frame.id << ", removed" << std::endl;
+            it = workers.erase(it);
+        } else if (!state.busy && !waiting && now - state.since > worker_timeout) {
+            it = workers.erase(it); // Отключился после последнего ответа
+        } else {
+            ++it;
+        }
+    }
+}
+
+void Dispatcher::reportStats()
+{
+    metrics().workers.set(workers.size());
+    metrics().idle.set(idle.size());
+    metrics().input_queue.set(input.size());
+    metrics().output_queue.set(output.size());
+
+    auto now = std::chrono::steady_clock::now();
+    if (now - last_report < std::chrono::seconds(5)) {
+        return;
+    }
+    last_report = now;
+
+    std::cout << "- [ INFO ] Dispatched: " << dispatched_frames << ", lost: " << lost_frames
+        << ", workers: " << workers.size() << " (idle " << idle.size() << ")" << std::endl;
+
+    int index = 0;
+    for (const auto& entry : workers)
+    {
+        const WorkerState& state = entry.second;
+        std::cout << "    worker " << index++ << ": " << (state.busy ? "busy" : "idle")
+            << ", frames " << state.completed
+            << ", avg " << state.average_ms << " ms"
+            << ", last " << state.last_ms << " ms" << std::endl;
+    }
+}
+
+void Dispatcher::reply(const std::string& worker, zmq::message_t& header, zmq::message_t& payload)
+{
+    zmq::message_t identity(worker.data(), worker.size());
+    zmq::message_t delimiter;
+    socket.send(identity, zmq::send_flags::sndmore);
+    socket.send(delimiter, zmq::send_flags::sndmore);
+    socket.send(header, zmq::send_flags::sndmore);
+    socket.send(payload, zmq::send_flags::none);
+}
+
+void Dispatcher::replyText(const std::string& worker, const std::string& text)
+{
+    zmq::message_t identity(worker.data(), worker.size());
+    zmq::message_t delimiter;
+    zmq::message_t body(text.data(), text.size());
+    socket.send(identity, zmq::send_flags::sndmore);
+    socket.send(delimiter, zmq::send_flags::sndmore);
+    socket.send(body, zmq::send_flags::none);
+}
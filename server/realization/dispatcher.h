@@ -0,0 +1,80 @@
+#ifndef _DISPATCHER_H_
+#define _DISPATCHER_H_
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <map>
+#include <string>
+#include <vector>
+#include <opencv2/opencv.hpp>
+#include <zmq.hpp>
+#include "codecs.h"
+#include "frameQueue.h"
+#include "frameTrace.h"
+
+// Результат обработки кадра worker'ом
+struct DispatchResult
+{
+    PipelineFrame original; // Кадр с камеры
+    cv::Mat processed; // Ответ worker'а
+    std::string worker; // routing id worker'а
+    FrameTrace trace; // Трасса кадра, дополненная worker'ом
+};
+
+// Балансировщик нагрузки между N worker'ами (сокет ROUTER).
+// Worker работает по прежнему протоколу REQ: READY -> кадр -> обработанный кадр -> DONE.
+// Свободные worker'ы копятся в очереди; кадр уходит свободному worker'у с наименьшим
+// средним временем обработки, время каждого кадра учитывается в статистике worker'а.
+class Dispatcher
+{
+private:
+    // Состояние одного worker'а
+    struct WorkerState
+    {
+        bool busy = false;
+        PipelineFrame frame; // Кадр в обработке
+        std::chrono::steady_clock::time_point since; // Начало ожидания кадра или его обработки
+        uint64_t completed = 0;
+        double average_ms = 0; // Скользящее среднее времени обработки
+        double last_ms = 0;
+    };
+
+    FrameQueue<PipelineFrame>& input;
+    FrameQueue<DispatchResult>& output;
+
+    zmq::context_t zmq_ctx;
+    zmq::socket_t socket; // ROUTER, к нему подключаются worker'ы
+    const ImageCodec* codec;
+
+    std::map<std::string, WorkerState> workers; // routing id -> состояние
+    std::vector<std::string> idle; // Worker'ы, приславшие READY
+    std::chrono::milliseconds worker_timeout; // Кадр без ответа дольше - worker считается потерянным
+    std::chrono::steady_clock::time_point last_report;
+
+    uint64_t dispatched_frames;
+    uint64_t lost_frames;
+    std::atomic<size_t> idle_workers; // Копия idle.size() для потока захвата
+    std::atomic<bool> running;
+
+public:
+    Dispatcher(FrameQueue<PipelineFrame>& input, FrameQueue<DispatchResult>& output,
+               const std::string& address, const std::string& codec_name, int worker_timeout_ms);
+
+    void run();
+    void stop();
+
+    // Сколько worker'ов ждут кадр; читается из других потоков
+    size_t getIdleWorkers() const;
+
+private:
+    void handleMessage();
+    void dispatchFrames();
+    void expireWorkers();
+    void reportStats();
+
+    void reply(const std::string& worker, zmq::message_t& header, zmq::message_t& payload);
+    void replyText(const std::string& worker, const std::string& text);
+};
+
+#endif // _DISPATCHER_H_
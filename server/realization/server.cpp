@@ -1,144 +1,105 @@
-#include <iostream>
-#include <stdio.h>
-#include <opencv2/opencv.hpp>
-#include <chrono>
-#include <thread>
-#include <filesystem>
-#include <zmq.hpp>
-#include "ImageStructure.hpp"
-
-class Capturer
-{
-private:
-    cv::VideoCapture cap; // Объект для захвата видео с камеры
-    uint64_t frame_counter; // Счётчик кадров
-    std::filesystem::path temp_dir;
-
-    zmq::context_t zmq_ctx; // Контекст ZeroMQ
-    zmq::socket_t socket; // Сокет ZeroMQ для отправки данных
-
-public:
-    Capturer() : frame_counter(0)
-        , zmq_ctx(1) // Инициализация контекста ZeroMQ с одним потоком ввода-вывода
-        , socket(zmq_ctx, zmq::socket_type::push) // Инициализация сокета PUSH
-    {
-        std::cout << "=== Capturer Initialization ===" << std::endl;
-        temp_dir = "./camera_capture";
-        std::filesystem::create_directories(temp_dir);
-        init_camera();
-        init_zmq();
-        std::cout << "======================================================" << std::endl;
-    }
-
-private:
-    void init_camera()
-    {
-        std::cout << "Searching for camera..." << std::endl;
-        for (int i = 0; i < 10; i++)
-        {
-            cap.open(i); // Попытка открыть камеру с текущим ID
-            if (cap.isOpened()) // Проверка успешности открытия камеры
-            {
-                cap.set(cv::CAP_PROP_FRAME_WIDTH, 640); // Установка ширины кадра
-                cap.set(cv::CAP_PROP_FRAME_HEIGHT, 480); // Установка высоты кадра
-                cap.set(cv::CAP_PROP_FPS, 30); // Установка частоты кадров
-                std::cout << "- [ OK ] Camera found at ID: " << i << std::endl;
-                return;
-            }
-        }
-        throw std::runtime_error("- [FAIL] No camera found!");
-    }
-
-    void init_zmq()
-    {
-        try {
-            int send_buffer_limit = 100;
-            socket.set(zmq::sockopt::sndhwm, send_buffer_limit); // Установка лимита буфера отправки
-
-            socket.set(zmq::sockopt::linger, 0); // Установка нулевого времени ожидания при закрытии сокета
-            socket.set(zmq::sockopt::immediate, 1); // Включение немедленной отправки
-
-            socket.bind("tcp://localhost:5555"); // Привязка сокета
-
-            std::cout << "- [ OK ] ZMQ socket bound" << std::endl;
-            std::cout << "- [ INFO ] Send buffer limit (HWM): " << send_buffer_limit << " messages" << std::endl;
-        }
-        catch (const zmq::error_t& e) {
-            throw std::runtime_error(std::string("- [FAIL] ZMQ bind error: ") + e.what());
-        }
-    }
-
-public:
-    void run()
-    {
-        std::cout << "=== Capturer Started ===" << std::endl;
-        std::cout << "Displaying camera feed..." << std::endl;
-
-        cv::Mat frame; // Матрица для хранения текущего кадра
-        int dropped_frames = 0; // Счётчик пропущенных кадров
-
-        while (true)
-        {
-            if (!cap.read(frame) || frame.empty()) // Попытка захватить кадр
-            {
-                std::cout << "- [FAIL] Failed to grab frame" << std::endl;
-                std::this_thread::sleep_for(std::chrono::milliseconds(100));
-                continue;
-            }
-
-            // Сериализация кадра
-            ImageStructure is1(frame, frame_counter); // Создание структуры изображения с кадром и номером
-            auto serialized = is1.serialize(); // Сериализация структуры
-
-            zmq::message_t msg(serialized.size()); // Создание сообщения ZeroMQ
-            memcpy(msg.data(), serialized.data(), serialized.size()); // Копирование данных в сообщение
-
-            zmq::send_flags flags = zmq::send_flags::dontwait; // Установка флага неблокирующей отправки
-            auto result = socket.send(msg, flags); // Попытка отправить сообщение
-
-            if (!result.has_value()) { // Проверка, удалось ли отправить сообщение
-                dropped_frames++; // Увеличение счётчика пропущенных кадров
-                if (dropped_frames % 50 == 0) {
-                    std::cout << "- [ WARN ] Buffer full, dropped " << dropped_frames << " frames total" << std::endl; // Каждые 50 пропущенных кадров выводить предупреждение
-                }
-                continue;
-            }
-            // Вывод информации об отправленном кадре
-            std::cout << "- [ OK ] Sent frame: " << frame_counter 
-                << " Size: " << frame.cols << "x" << frame.rows
-                << " Channels: " << frame.channels()
-                << " Serialized size: " << serialized.size() << " bytes" << std::endl;
-
-
-            if (frame_counter) {
-                std::string filename = (temp_dir / ("frame_" + std::to_string(frame_counter) + ".jpg")).string();
-                cv::imwrite(filename, frame); 
-                //std::cout << "  Saved: " << filename << std::endl; // Вывод сообщения о сохранении
-            }
-
-            std::cout << "- [ OK ] Captured frame: " << frame_counter++
-                << " Size: " << frame.cols << "x" << frame.rows
-                << " Channels: " << frame.channels() << std::endl;
-
-        //if (cv::waitKey(1) == 27) break;
-        }
-
-        cap.release(); // Освобождение ресурсов камеры
-        cv::destroyAllWindows(); // Закрытие всех окон OpenCV
-    }
-};
-
-int main()
-{
-    try
-    {
-        Capturer capturer;
-        capturer.run();
-        return 0;
-    }
-    catch (const std::exception& e)
-    {
-        std::cout << "- [FAIL] Capturer error: " << e.what() << std::endl;
-        return -1;
-    }
-}
+#include <iostream>
+#include <thread>
+#include "capturer.h"
+#include "dispatcher.h"
+#include "utils.h"
+
+// Передача результатов worker'ов в postprocessor по протоколу READY/SEND_FIRST_IMAGE/SEND_SECOND_IMAGE/DONE
+static void forwardResults(FrameQueue<DispatchResult>& results, const std::string& pp_ip, int pp_port)
+{
+    Utils pp_client;
+    pp_client.loadConfig(); // Кодек канала postprocessor.codec
+
+    // Одно соединение на все кадры: обрыв восстанавливается внутри Utils
+    if (!pp_client.initializeClient(pp_ip, pp_port)) {
+        return;
+    }
+
+    DispatchResult result;
+    while (results.pop(result))
+    {
+        if (pp_client.getConnectionState() != ConnectionState::Connected) {
+            std::cout << "- [ WARN ] Postprocessor not connected, frame " << result.original.id << " queued in socket" << std::endl;
+        }
+
+        pp_client.sendMessage("READY");
+        if (pp_client.receiveMessage() != "SEND_FIRST_IMAGE") {
+            continue;
+        }
+        pp_client.sendImage(result.processed, result.original.id, result.trace);
+
+        if (pp_client.receiveMessage() != "SEND_SECOND_IMAGE") {
+            continue;
+        }
+        pp_client.sendImage(result.original.image, result.original.id);
+
+        if (pp_client.receiveMessage() == "DONE") {
+            std::cout << "- [ OK ] Postprocessor completed frame " << result.original.id << std::endl;
+        }
+    }
+}
+
+// Балансировка кадров камеры между worker'ами (server.mode: dispatcher)
+static int runDispatcher(Utils& settings)
+{
+    std::shared_ptr<const ConfigSnapshot> snapshot = settings.getConfigSnapshot();
+    const ConfigSnapshot& config = *snapshot; // Параметры запуска; Capturer сам следит за изменениями
+    std::string address = "tcp://" + config.server.ip + ":" + std::to_string(config.server.port);
+    std::string codec = config.server.codec.empty() ? "raw" : config.server.codec;
+    size_t queue_size = config.server.queue_size;
+    int worker_timeout = config.server.worker_timeout;
+    std::string pp_ip = config.postprocessor.ip;
+    int pp_port = config.postprocessor.port;
+
+    FrameQueue<PipelineFrame> frames(queue_size); // Capturer -> Dispatcher
+    FrameQueue<DispatchResult> results(queue_size); // Dispatcher -> postprocessor
+
+    Capturer capturer(frames, settings);
+    Dispatcher dispatcher(frames, results, address, codec, worker_timeout);
+
+    // Пока все worker'ы заняты, хватает одного кадра в очереди - остальные не декодируются
+    capturer.setDemand([&]() {
+        return dispatcher.getIdleWorkers() > 0 || frames.size() == 0;
+    });
+
+    std::thread capture_thread([&]() {
+        capturer.run();
+        frames.close();
+    });
+    std::thread forward_thread([&]() {
+        forwardResults(results, pp_ip, pp_port);
+    });
+
+    dispatcher.run();
+
+    capturer.stop();
+    results.close();
+    capture_thread.join();
+    forward_thread.join();
+    return 0;
+}
+
+int main()
+{
+    try
+    {
+        Utils config;
+        config.loadConfig();
+
+        std::shared_ptr<const ConfigSnapshot> settings = config.getConfigSnapshot();
+        config.startControl(settings->server.control_port); // server.target_fps без перезапуска
+        config.startMetrics("server", settings->server.metrics_port, settings->server.metrics_file);
+        if (settings->server.mode == "dispatcher") {
+            return runDispatcher(config);
+        }
+
+        Capturer capturer(config);
+        capturer.run();
+        return 0;
+    }
+    catch (const std::exception& e)
+    {
+        std::cout << "- [FAIL] Capturer error: " << e.what() << std::endl;
+        return -1;
+    }
+}
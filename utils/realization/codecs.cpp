@@ -0,0 +1,207 @@
+#include <algorithm>
+#include <utility>
+
+#include <opencv2/imgcodecs.hpp>
+
+#ifdef UTILS_WITH_LZ4
+#include <lz4.h>
+#endif
+
+#include "codecs.h"
+#include "framePool.h"
+#include "zeroCopy.h"
+
+static bool sameGeometry(const cv::Mat &image, const FrameGeometry &geometry)
+{
+    return image.rows == geometry.rows && image.cols == geometry.cols && image.type() == geometry.type;
+}
+
+// ============================================================================
+// RAW: пиксели как есть, без копирования в обе стороны
+// ============================================================================
+
+class RawCodec : public ImageCodec
+{
+public:
+    CodecId id() const override { return CodecId::Raw; }
+    std::string name() const override { return "raw"; }
+
+    zmq::message_t encode(const cv::Mat &image) const override
+    {
+        return wrapMatInMessage(image);
+    }
+
+    cv::Mat decode(zmq::message_t &&payload, const FrameGeometry &geometry) const override
+    {
+        uint64_t row_bytes = (uint64_t)geometry.cols * CV_ELEM_SIZE(geometry.type);
+        uint64_t needed = (uint64_t)geometry.step * (geometry.rows - 1) + row_bytes;
+        if (payload.size() < needed)
+        {
+            return cv::Mat();
+        }
+        return wrapMessageInMat(std::move(payload), geometry.rows, geometry.cols,
+                                geometry.type, geometry.step);
+    }
+};
+
+// ============================================================================
+// BMP / JPEG / PNG: кодеки OpenCV
+// ============================================================================
+
+class OpenCVCodec : public ImageCodec
+{
+public:
+    OpenCVCodec(CodecId codec_id, const std::string &codec_name, const std::string &extension,
+                std::vector<int> params, std::vector<int> depths, std::vector<int> channels)
+        : codec_id(codec_id), codec_name(codec_name), extension(extension), params(std::move(params)),
+          depths(std::move(depths)), channels(std::move(channels))
+    {
+    }
+
+    CodecId id() const override { return codec_id; }
+    std::string name() const override { return codec_name; }
+
+    bool supports(int type) const override
+    {
+        return std::find(depths.begin(), depths.end(), CV_MAT_DEPTH(type)) != depths.end() &&
+               std::find(channels.begin(), channels.end(), CV_MAT_CN(type)) != channels.end();
+    }
+
+    zmq::message_t encode(const cv::Mat &image) const override
+    {
+        std::vector<uchar> buffer;
+        try
+        {
+            if (!cv::imencode(extension, image, buffer, params))
+            {
+                return zmq::message_t();
+            }
+        }
+        catch (const cv::Exception &)
+        {
+            // Неподдерживаемая глубина или число каналов
+            return zmq::message_t();
+        }
+        return wrapBufferInMessage(std::move(buffer));
+    }
+
+    cv::Mat decode(zmq::message_t &&payload, const FrameGeometry &geometry) const override
+    {
+        // Вид на сообщение без копирования, imdecode читает прямо из него
+        cv::Mat encoded(1, (int)payload.size(), CV_8UC1, payload.data());
+        cv::Mat image = cv::imdecode(encoded, cv::IMREAD_UNCHANGED);
+        return sameGeometry(image, geometry) ? image : cv::Mat();
+    }
+
+private:
+    CodecId codec_id;
+    std::string codec_name;
+    std::string extension;
+    std::vector<int> params;
+    std::vector<int> depths;   // глубины, которые формат хранит без преобразования
+    std::vector<int> channels; // и числа каналов
+};
+
+// ============================================================================
+// LZ4: быстрое сжатие без потерь для медленных сетевых каналов
+// ============================================================================
+
+#ifdef UTILS_WITH_LZ4
+class Lz4Codec : public ImageCodec
+{
+public:
+    CodecId id() const override { return CodecId::Lz4; }
+    std::string name() const override { return "lz4"; }
+
+    zmq::message_t encode(const cv::Mat &image) const override
+    {
+        // Сжимаем строки подряд, разрывные матрицы (ROI) сначала копируем
+        FramePool &pool = FramePool::instance();
+        cv::Mat packed = image.isContinuous() ? image : pool.clone(image);
+        int source_size = (int)(packed.total() * packed.elemSize());
+
+        // Буфер на худший случай из пула; сообщение занимает только сжатую часть
+        size_t capacity = (size_t)LZ4_compressBound(source_size);
+        char *buffer = static_cast<char *>(pool.acquire(capacity));
+        int compressed = LZ4_compress_default(reinterpret_cast<const char *>(packed.data), buffer,
+                                              source_size, (int)capacity);
+        if (compressed <= 0)
+        {
+            pool.release(buffer, capacity);
+            return zmq::message_t();
+        }
+        return pool.wrapInMessage(buffer, (size_t)compressed, capacity);
+    }
+
+    cv::Mat decode(zmq::message_t &&payload, const FrameGeometry &geometry) const override
+    {
+        cv::Mat image = FramePool::instance().create(geometry.rows, geometry.cols, geometry.type);
+        int expected = (int)(image.total() * image.elemSize());
+
+        int decompressed = LZ4_decompress_safe(static_cast<const char *>(payload.data()),
+                                               reinterpret_cast<char *>(image.data),
+                                               (int)payload.size(), expected);
+        return decompressed == expected ? image : cv::Mat();
+    }
+};
+#endif
+
+// ============================================================================
+// РЕЕСТР
+// ============================================================================
+
+CodecRegistry::CodecRegistry()
+{
+    add(std::make_unique<RawCodec>());
+    add(std::make_unique<OpenCVCodec>(CodecId::Bmp, "bmp", ".bmp", std::vector<int>(),
+                                      std::vector<int>{CV_8U}, std::vector<int>{1, 3}));
+    add(std::make_unique<OpenCVCodec>(CodecId::Jpeg, "jpeg", ".jpg",
+                                      std::vector<int>{cv::IMWRITE_JPEG_QUALITY, 90},
+                                      std::vector<int>{CV_8U}, std::vector<int>{1, 3}));
+    add(std::make_unique<OpenCVCodec>(CodecId::Png, "png", ".png",
+                                      std::vector<int>{cv::IMWRITE_PNG_COMPRESSION, 1},
+                                      std::vector<int>{CV_8U, CV_16U}, std::vector<int>{1, 3, 4}));
+#ifdef UTILS_WITH_LZ4
+    add(std::make_unique<Lz4Codec>());
+#endif
+}
+
+CodecRegistry &CodecRegistry::instance()
+{
+    static CodecRegistry registry;
+    return registry;
+}
+
+void CodecRegistry::add(std::unique_ptr<ImageCodec> codec)
+{
+    uint8_t key = static_cast<uint8_t>(codec->id());
+    codecs[key] = std::move(codec);
+}
+
+const ImageCodec *CodecRegistry::find(CodecId id) const
+{
+    auto it = codecs.find(static_cast<uint8_t>(id));
+    return it != codecs.end() ? it->second.get() : nullptr;
+}
+
+const ImageCodec *CodecRegistry::find(const std::string &name) const
+{
+    for (const auto &entry : codecs)
+    {
+        if (entry.second->name() == name)
+        {
+            return entry.second.get();
+        }
+    }
+    return nullptr;
+}
+
+std::vector<std::string> CodecRegistry::names() const
+{
+    std::vector<std::string> result;
+    for (const auto &entry : codecs)
+    {
+        result.push_back(entry.second->name());
+    }
+    return result;
+}
@@ -0,0 +1,74 @@
+#ifndef _CODECS_H_
+#define _CODECS_H_
+
+#include <cstdint>
+#include <map>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include <opencv2/core.hpp>
+#include <zmq.hpp>
+
+// Идентификаторы кодеков на проводе. Значения не менять - по ним получатель
+// выбирает декодер, поэтому узлы с разными настройками понимают друг друга.
+enum class CodecId : uint8_t
+{
+    Raw = 0,
+    Bmp = 1,
+    Jpeg = 2,
+    Png = 3,
+    Lz4 = 4
+};
+
+// Геометрия кадра из заголовка сообщения
+struct FrameGeometry
+{
+    int rows;
+    int cols;
+    int type;
+    size_t step; // байт на строку в полезной нагрузке (для Raw)
+};
+
+// Кодек полезной нагрузки кадра
+class ImageCodec
+{
+public:
+    virtual ~ImageCodec() = default;
+
+    virtual CodecId id() const = 0;
+    virtual std::string name() const = 0;
+
+    // Передает ли кодек тип OpenCV без изменений (глубина и число каналов).
+    // Кадры других типов отправляются в Raw: кодер мог бы молча привести их к своему типу,
+    // и получатель отбросил бы кадр из-за несовпадения с заголовком
+    virtual bool supports(int type) const { (void)type; return true; }
+
+    // Пустое сообщение - кодирование не удалось
+    virtual zmq::message_t encode(const cv::Mat &image) const = 0;
+
+    // Пустая матрица - данные не сходятся с геометрией из заголовка
+    virtual cv::Mat decode(zmq::message_t &&payload, const FrameGeometry &geometry) const = 0;
+};
+
+// Реестр кодеков. Встроенные кодеки регистрируются при первом обращении,
+// собственные нужно добавлять до начала передачи.
+class CodecRegistry
+{
+public:
+    static CodecRegistry &instance();
+
+    void add(std::unique_ptr<ImageCodec> codec);
+
+    const ImageCodec *find(CodecId id) const;
+    const ImageCodec *find(const std::string &name) const;
+
+    std::vector<std::string> names() const;
+
+private:
+    CodecRegistry();
+
+    std::map<uint8_t, std::unique_ptr<ImageCodec>> codecs;
+};
+
+#endif // _CODECS_H_
@@ -0,0 +1,502 @@
+#include <climits>
+#include <stdexcept>
+#include <filesystem>
+#include <yaml-cpp/yaml.h>
+
+#include "configSnapshot.h"
+#include "codecs.h"
+#include "logger.h"
+
+#ifdef __linux__
+#include <poll.h>
+#include <sys/inotify.h>
+#include <unistd.h>
+#endif
+
+// ============================================================================
+// РАЗБОР
+// ============================================================================
+
+const LinkConfig *ConfigSnapshot::findLink(int port) const
+{
+    const LinkConfig *links[] = {&server, &worker, &postprocessor};
+    for (const LinkConfig *link : links)
+    {
+        if (link->port == port)
+        {
+            return link;
+        }
+    }
+    return nullptr;
+}
+
+// Скаляры дерева в плоскую таблицу "секция.ключ" -> значение
+static void flatten(const YAML::Node &node, const std::string &prefix,
+                    std::unordered_map<std::string, std::string> &values)
+{
+    if (node.IsScalar())
+    {
+        values[prefix] = node.Scalar();
+        return;
+    }
+    if (!node.IsMap())
+    {
+        return;
+    }
+
+    for (const auto &child : node)
+    {
+        std::string key = child.first.as<std::string>();
+        flatten(child.second, prefix.empty() ? key : prefix + "." + key, values);
+    }
+}
+
+static void readString(const YAML::Node &section, const std::string &name, const char *key, std::string &value)
+{
+    if (!section[key])
+    {
+        return;
+    }
+
+    try
+    {
+        value = section[key].as<std::string>();
+    }
+    catch (const YAML::Exception &e)
+    {
+        LOG_WARN("Config {}.{}: {}, using default", name, key, e.what());
+    }
+}
+
+static void readInt(const YAML::Node &section, const std::string &name, const char *key, int &value,
+                    int min_value = INT_MIN, int max_value = INT_MAX)
+{
+    if (!section[key])
+    {
+        return;
+    }
+
+    try
+    {
+        int parsed = section[key].as<int>();
+        if (parsed < min_value || parsed > max_value)
+        {
+            LOG_WARN("Config {}.{} = {} is out of range [{}, {}], using {}", name, key, parsed, min_value, max_value, value);
+            return;
+        }
+        value = parsed;
+    }
+    catch (const YAML::Exception &e)
+    {
+        LOG_WARN("Config {}.{}: {}, using {}", name, key, e.what(), value);
+    }
+}
+
+static void readBool(const YAML::Node &section, const std::string &name, const char *key, bool &value)
+{
+    if (!section[key])
+    {
+        return;
+    }
+
+    try
+    {
+        value = section[key].as<bool>();
+    }
+    catch (const YAML::Exception &e)
+    {
+        LOG_WARN("Config {}.{}: {}, using {}", name, key, e.what(), value);
+    }
+}
+
+// Граф фильтров: список узлов-отображений. Ошибка разбора отключает граф целиком -
+// частично прочитанный граф мог бы дать другой эффект
+static void readGraph(const YAML::Node &section, const std::string &name, FilterGraphConfig &graph)
+{
+    if (!section["graph"])
+    {
+        return;
+    }
+
+    try
+    {
+        const YAML::Node root = section["graph"];
+        if (!root.IsMap() || !root["nodes"].IsSequence())
+        {
+            LOG_WARN("Config {}.graph: expected 'nodes' list, using built-in effect", name);
+            return;
+        }
+        readString(root, name + ".graph", "output", graph.output);
+
+        for (const auto &item : root["nodes"])
+        {
+            if (!item.IsMap())
+            {
+                throw std::runtime_error("node is not a map");
+            }
+
+            FilterNodeConfig node;
+            for (const auto &entry : item)
+            {
+                std::string key = entry.first.as<std::string>();
+                const YAML::Node &value = entry.second;
+                if (key == "input" || key == "inputs")
+                {
+                    if (value.IsSequence())
+                    {
+                        for (const auto &input : value)
+                        {
+                            node.inputs.push_back(input.as<std::string>());
+                        }
+                    }
+                    else
+                    {
+                        node.inputs.push_back(value.as<std::string>());
+                    }
+                }
+                else if (!value.IsScalar())
+                {
+                    throw std::runtime_error("node key '" + key + "' is not a scalar");
+                }
+                else if (key == "name")
+                {
+                    node.name = value.Scalar();
+                }
+                else if (key == "type")
+                {
+                    node.type = value.Scalar();
+                }
+                else
+                {
+                    node.params[key] = value.Scalar();
+                }
+            }
+            graph.nodes.push_back(node);
+        }
+    }
+    catch (const std::exception &e)
+    {
+        LOG_WARN("Config {}.graph: {}, using built-in effect", name, e.what());
+        graph = FilterGraphConfig();
+    }
+}
+
+// Пороги Canny задаются парой: low больше high - ошибка, оба порога берутся по умолчанию
+static void checkCannyThresholds(const std::string &name, int &low, int &high, int default_low, int default_high,
+                                 std::unordered_map<std::string, std::string> &values)
+{
+    if (low <= high)
+    {
+        return;
+    }
+    LOG_WARN("Config {}.canny_low = {} exceeds canny_high = {}, using {} and {}", name, low, high, default_low,
+             default_high);
+    low = default_low;
+    high = default_high;
+    values[name + ".canny_low"] = std::to_string(low);
+    values[name + ".canny_high"] = std::to_string(high);
+}
+
+static void readLink(const YAML::Node &section, const std::string &name, LinkConfig &link)
+{
+    readString(section, name, "ip", link.ip);
+    readInt(section, name, "port", link.port, 0, 65535);
+    readString(section, name, "codec", link.codec);
+    readInt(section, name, "window", link.window, 1);
+    readInt(section, name, "batch_frames", link.batch_frames, 1);
+    readInt(section, name, "batch_ms", link.batch_ms, 0);
+    readInt(section, name, "heartbeat_ms", link.heartbeat_ms, 0);
+    readInt(section, name, "heartbeat_timeout_ms", link.heartbeat_timeout_ms, 0);
+
+    if (!link.codec.empty() && !CodecRegistry::instance().find(link.codec))
+    {
+        LOG_WARN("Config {}.codec: unknown codec '{}'", name, link.codec);
+    }
+}
+
+std::shared_ptr<ConfigSnapshot> parseConfigSnapshot(const std::string &path)
+{
+    YAML::Node root;
+    try
+    {
+        root = YAML::LoadFile(path);
+    }
+    catch (const YAML::Exception &e)
+    {
+        LOG_ERROR("Error loading config file: {}", e.what());
+        return nullptr;
+    }
+
+    auto snapshot = std::make_shared<ConfigSnapshot>();
+    snapshot->path = path;
+    flatten(root, "", snapshot->values);
+
+    const YAML::Node server = root["server"];
+    ServerConfig &sc = snapshot->server;
+    readLink(server, "server", sc);
+    readString(server, "server", "input_image", sc.input_image);
+    readString(server, "server", "mode", sc.mode);
+    readInt(server, "server", "queue_size", sc.queue_size, 1);
+    readInt(server, "server", "worker_timeout", sc.worker_timeout, 1);
+    readInt(server, "server", "send_queue_depth", sc.send_queue_depth, 1);
+    readInt(server, "server", "credit_port", sc.credit_port, 0, 65535);
+    readInt(server, "server", "delta_keyframe_interval", sc.delta_keyframe_interval, 0);
+    readInt(server, "server", "delta_tile_size", sc.delta_tile_size, 1);
+    readInt(server, "server", "delta_threshold", sc.delta_threshold, 0, 255);
+    readBool(server, "server", "delta_verify", sc.delta_verify);
+    readInt(server, "server", "target_fps", sc.target_fps, 0, 1000);
+    readInt(server, "server", "control_port", sc.control_port, 0, 65535);
+    readInt(server, "server", "metrics_port", sc.metrics_port, 0, 65535);
+    readString(server, "server", "metrics_file", sc.metrics_file);
+    if (sc.mode != "push" && sc.mode != "dispatcher")
+    {
+        LOG_WARN("Config server.mode: unknown mode '{}', using push", sc.mode);
+        sc.mode = "push";
+    }
+
+    const YAML::Node worker = root["worker"];
+    WorkerConfig &wc = snapshot->worker;
+    readLink(worker, "worker", wc);
+    readString(worker, "worker", "output_dir", wc.output_dir);
+    readInt(worker, "worker", "quantization_levels", wc.quantization_levels, 1, 256);
+    readInt(worker, "worker", "canny_low", wc.canny_low, 0, 1000);
+    readInt(worker, "worker", "canny_high", wc.canny_high, 0, 1000);
+    checkCannyThresholds("worker", wc.canny_low, wc.canny_high, WorkerConfig().canny_low, WorkerConfig().canny_high,
+                         snapshot->values);
+    readInt(worker, "worker", "verify_effect_every", wc.verify_effect_every, 0);
+    readInt(worker, "worker", "effect_threads", wc.effect_threads, 0, 256);
+    readGraph(worker, "worker", wc.graph);
+    readInt(worker, "worker", "control_port", wc.control_port, 0, 65535);
+    readInt(worker, "worker", "metrics_port", wc.metrics_port, 0, 65535);
+    readString(worker, "worker", "metrics_file", wc.metrics_file);
+
+    const YAML::Node postprocessor = root["postprocessor"];
+    PostProcessorConfig &pc = snapshot->postprocessor;
+    readLink(postprocessor, "postprocessor", pc);
+    readString(postprocessor, "postprocessor", "output_dir", pc.output_dir);
+    readString(postprocessor, "postprocessor", "processed_prefix", pc.processed_prefix);
+    readString(postprocessor, "postprocessor", "bare_prefix", pc.bare_prefix);
+    readInt(postprocessor, "postprocessor", "max_frames", pc.max_frames, 3);
+    readInt(postprocessor, "postprocessor", "timeout_duration", pc.timeout_duration, 1);
+    readInt(postprocessor, "postprocessor", "reorder_hold_ms", pc.reorder_hold_ms, 0);
+    readInt(postprocessor, "postprocessor", "control_port", pc.control_port, 0, 65535);
+    readInt(postprocessor, "postprocessor", "metrics_port", pc.metrics_port, 0, 65535);
+    readString(postprocessor, "postprocessor", "metrics_file", pc.metrics_file);
+    readString(postprocessor, "postprocessor", "trace_file", pc.trace_file);
+    readInt(postprocessor, "postprocessor", "trace_sample_every", pc.trace_sample_every, 0);
+
+    const YAML::Node pipeline = root["pipeline"];
+    PipelineConfig &plc = snapshot->pipeline;
+    readInt(pipeline, "pipeline", "queue_size", plc.queue_size, 1);
+    readInt(pipeline, "pipeline", "quantization_levels", plc.quantization_levels, 1, 256);
+    readInt(pipeline, "pipeline", "canny_low", plc.canny_low, 0, 1000);
+    readInt(pipeline, "pipeline", "canny_high", plc.canny_high, 0, 1000);
+    checkCannyThresholds("pipeline", plc.canny_low, plc.canny_high, PipelineConfig().canny_low,
+                         PipelineConfig().canny_high, snapshot->values);
+    readInt(pipeline, "pipeline", "verify_effect_every", plc.verify_effect_every, 0);
+    readInt(pipeline, "pipeline", "effect_threads", plc.effect_threads, 0, 256);
+    readGraph(pipeline, "pipeline", plc.graph);
+    readInt(pipeline, "pipeline", "control_port", plc.control_port, 0, 65535);
+    readInt(pipeline, "pipeline", "metrics_port", plc.metrics_port, 0, 65535);
+    readString(pipeline, "pipeline", "metrics_file", plc.metrics_file);
+
+    readInt(root["metrics"], "metrics", "interval_ms", snapshot->metrics.interval_ms, 10);
+
+    const YAML::Node frame_pool = root["frame_pool"];
+    readInt(frame_pool, "frame_pool", "max_cached_mb", snapshot->frame_pool.max_cached_mb, 0, 1 << 20);
+    readBool(frame_pool, "frame_pool", "opencv_default", snapshot->frame_pool.opencv_default);
+
+    const YAML::Node logging = root["logging"];
+    readString(logging, "logging", "level", snapshot->logging.level);
+    LogLevel level;
+    if (!Logger::parseLevel(snapshot->logging.level, level))
+    {
+        LOG_WARN("Config logging.level: unknown level '{}', using info", snapshot->logging.level);
+        snapshot->logging.level = "info";
+    }
+
+    return snapshot;
+}
+
+// ============================================================================
+// ИЗМЕНЕНИЕ НА ХОДУ
+// ============================================================================
+
+// Параметр, который стадии читают из снимка на границе кадра
+struct LiveSetting
+{
+    const char *key;
+    int min_value;
+    int max_value;
+    int &(*field)(ConfigSnapshot &);
+};
+
+static const LiveSetting LIVE_SETTINGS[] = {
+    {"server.target_fps", 0, 1000, [](ConfigSnapshot &c) -> int & { return c.server.target_fps; }},
+    {"worker.quantization_levels", 1, 256, [](ConfigSnapshot &c) -> int & { return c.worker.quantization_levels; }},
+    {"worker.canny_low", 0, 1000, [](ConfigSnapshot &c) -> int & { return c.worker.canny_low; }},
+    {"worker.canny_high", 0, 1000, [](ConfigSnapshot &c) -> int & { return c.worker.canny_high; }},
+    {"worker.verify_effect_every", 0, INT_MAX, [](ConfigSnapshot &c) -> int & { return c.worker.verify_effect_every; }},
+    {"postprocessor.max_frames", 3, INT_MAX, [](ConfigSnapshot &c) -> int & { return c.postprocessor.max_frames; }},
+    {"postprocessor.timeout_duration", 1, INT_MAX, [](ConfigSnapshot &c) -> int & { return c.postprocessor.timeout_duration; }},
+    {"postprocessor.reorder_hold_ms", 0, INT_MAX, [](ConfigSnapshot &c) -> int & { return c.postprocessor.reorder_hold_ms; }},
+    {"pipeline.quantization_levels", 1, 256, [](ConfigSnapshot &c) -> int & { return c.pipeline.quantization_levels; }},
+    {"pipeline.canny_low", 0, 1000, [](ConfigSnapshot &c) -> int & { return c.pipeline.canny_low; }},
+    {"pipeline.canny_high", 0, 1000, [](ConfigSnapshot &c) -> int & { return c.pipeline.canny_high; }},
+    {"pipeline.verify_effect_every", 0, INT_MAX, [](ConfigSnapshot &c) -> int & { return c.pipeline.verify_effect_every; }},
+};
+
+bool applyLiveSetting(ConfigSnapshot &snapshot, const std::string &key, const std::string &value,
+                      std::string &error)
+{
+    for (const LiveSetting &setting : LIVE_SETTINGS)
+    {
+        if (key != setting.key)
+        {
+            continue;
+        }
+
+        int parsed = 0;
+        try
+        {
+            size_t used = 0;
+            parsed = std::stoi(value, &used);
+            if (used != value.size())
+            {
+                throw std::invalid_argument(value);
+            }
+        }
+        catch (const std::exception &)
+        {
+            error = "'" + value + "' is not an integer";
+            return false;
+        }
+
+        if (parsed < setting.min_value || parsed > setting.max_value)
+        {
+            error = value + " is out of range [" + std::to_string(setting.min_value) + ", " +
+                    std::to_string(setting.max_value) + "]";
+            return false;
+        }
+
+        // Пара порогов Canny проверяется вместе: новое значение не должно нарушить low <= high
+        int &field = setting.field(snapshot);
+        int previous = field;
+        field = parsed;
+        if (snapshot.worker.canny_low > snapshot.worker.canny_high ||
+            snapshot.pipeline.canny_low > snapshot.pipeline.canny_high)
+        {
+            field = previous;
+            error = key + " = " + value + " would make canny_low exceed canny_high";
+            return false;
+        }
+
+        snapshot.values[key] = std::to_string(parsed);
+        return true;
+    }
+
+    error = snapshot.values.count(key) ? key + " is applied only at startup" : "unknown key " + key;
+    return false;
+}
+
+std::vector<std::string> liveSettingKeys()
+{
+    std::vector<std::string> keys;
+    for (const LiveSetting &setting : LIVE_SETTINGS)
+    {
+        keys.push_back(setting.key);
+    }
+    return keys;
+}
+
+// ============================================================================
+// СЛЕЖЕНИЕ ЗА ФАЙЛОМ
+// ============================================================================
+
+ConfigWatcher::ConfigWatcher(const std::string &path, std::function<void()> on_change)
+    : on_change(std::move(on_change)), inotify_fd(-1), running(false)
+{
+    std::filesystem::path file(path);
+    directory = file.has_parent_path() ? file.parent_path().string() : ".";
+    file_name = file.filename().string();
+
+#ifdef __linux__
+    inotify_fd = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+    if (inotify_fd < 0)
+    {
+        LOG_ERROR("Config watch error: inotify_init1 failed");
+        return;
+    }
+
+    // Редакторы часто пишут новый файл и переименовывают его поверх старого
+    if (inotify_add_watch(inotify_fd, directory.c_str(), IN_CLOSE_WRITE | IN_MOVED_TO) < 0)
+    {
+        LOG_ERROR("Config watch error: cannot watch {}", directory);
+        close(inotify_fd);
+        inotify_fd = -1;
+        return;
+    }
+
+    running = true;
+    thread = std::thread(&ConfigWatcher::run, this);
+    LOG_INFO("Watching config file: {}", path);
+#else
+    LOG_WARN("Config watching is not supported on this platform");
+#endif
+}
+
+ConfigWatcher::~ConfigWatcher()
+{
+    running = false;
+    if (thread.joinable())
+    {
+        thread.join();
+    }
+#ifdef __linux__
+    if (inotify_fd >= 0)
+    {
+        close(inotify_fd);
+    }
+#endif
+}
+
+bool ConfigWatcher::isWatching() const
+{
+    return running;
+}
+
+void ConfigWatcher::run()
+{
+#ifdef __linux__
+    alignas(inotify_event) char buffer[4096];
+
+    while (running)
+    {
+        pollfd item = {inotify_fd, POLLIN, 0};
+        if (poll(&item, 1, 200) <= 0 || !(item.revents & POLLIN))
+        {
+            continue;
+        }
+
+        bool changed = false;
+        ssize_t length;
+        while ((length = read(inotify_fd, buffer, sizeof(buffer))) > 0)
+        {
+            for (char *ptr = buffer; ptr < buffer + length;)
+            {
+                const inotify_event *event = reinterpret_cast<const inotify_event *>(ptr);
+                if (event->len > 0 && file_name == event->name)
+                {
+                    changed = true;
+                }
+                ptr += sizeof(inotify_event) + event->len;
+            }
+        }
+
+        if (changed)
+        {
+            on_change();
+        }
+    }
+#endif
+}
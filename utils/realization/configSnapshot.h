@@ -0,0 +1,187 @@
+#ifndef _CONFIG_SNAPSHOT_H_
+#define _CONFIG_SNAPSHOT_H_
+
+#include <atomic>
+#include <cstdint>
+#include <functional>
+#include <map>
+#include <memory>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+// Настройки канала между стадиями (общие поля секций server, worker, postprocessor)
+struct LinkConfig
+{
+    std::string ip = "localhost";
+    int port = 0;
+    std::string codec; // пусто - кодек не задан
+    int window = 4;
+    int batch_frames = 1;
+    int batch_ms = 0;
+    int heartbeat_ms = 1000;         // интервал PING ZMTP, 0 - без heartbeat
+    int heartbeat_timeout_ms = 3000; // без ответа дольше - соединение разрывается и восстанавливается
+};
+
+// Узел графа фильтров (worker/realization/filterGraph.h). Ключи узла кроме name, type
+// и input/inputs попадают в params строками, проверяются при сборке графа
+struct FilterNodeConfig
+{
+    std::string name;
+    std::string type;
+    std::vector<std::string> inputs; // имена узлов или "source" - входной кадр
+    std::map<std::string, std::string> params;
+
+    bool operator==(const FilterNodeConfig &other) const
+    {
+        return name == other.name && type == other.type && inputs == other.inputs && params == other.params;
+    }
+};
+
+struct FilterGraphConfig
+{
+    std::vector<FilterNodeConfig> nodes; // пусто - встроенный мультипликационный эффект
+    std::string output;                  // узел-результат; пусто - последний узел
+
+    bool operator==(const FilterGraphConfig &other) const
+    {
+        return nodes == other.nodes && output == other.output;
+    }
+    bool operator!=(const FilterGraphConfig &other) const { return !(*this == other); }
+};
+
+struct ServerConfig : LinkConfig
+{
+    std::string input_image;
+    std::string mode = "push";
+    int queue_size = 4;
+    int worker_timeout = 10000;
+    int send_queue_depth = 2;
+    int credit_port = 0;
+    int delta_keyframe_interval = 0;
+    int delta_tile_size = 32;
+    int delta_threshold = 0;
+    bool delta_verify = false; // каждый отправленный кадр декодируется, как у получателя, и сверяется с исходным
+    int target_fps = 0; // 0 - без ограничения, кадры идут с частотой камеры
+    int control_port = 0;
+    int metrics_port = 0;
+    std::string metrics_file;
+};
+
+struct WorkerConfig : LinkConfig
+{
+    std::string output_dir;
+    int quantization_levels = 4;
+    int canny_low = 50;
+    int canny_high = 150;
+    int verify_effect_every = 0; // каждый n-й кадр сверяется с эталонной реализацией эффекта, 0 - без сверки
+    int effect_threads = 1;      // потоков на один кадр (полосы строк), 0 - по числу ядер; только при запуске
+    FilterGraphConfig graph;     // обработка кадра графом фильтров вместо встроенного эффекта
+    int control_port = 0;
+    int metrics_port = 0;
+    std::string metrics_file;
+};
+
+struct PostProcessorConfig : LinkConfig
+{
+    std::string output_dir;
+    std::string processed_prefix;
+    std::string bare_prefix;
+    int max_frames = 90;
+    int timeout_duration = 5000;
+    int reorder_hold_ms = 200;
+    int control_port = 0;
+    int metrics_port = 0;
+    std::string metrics_file;
+    std::string trace_file;     // Chrome trace-event JSON, пусто - трассировка выключена
+    int trace_sample_every = 0; // каждый n-й кадр попадает в трассу, 0 - ни один
+};
+
+struct PipelineConfig
+{
+    int queue_size = 4;
+    int quantization_levels = 4;
+    int canny_low = 50;
+    int canny_high = 150;
+    int verify_effect_every = 0;
+    int effect_threads = 1;
+    FilterGraphConfig graph;
+    int control_port = 0;
+    int metrics_port = 0;
+    std::string metrics_file;
+};
+
+struct MetricsConfig
+{
+    int interval_ms = 1000;
+};
+
+// Пул буферов кадров (framePool.h)
+struct FramePoolConfig
+{
+    int max_cached_mb = 256;      // свободных буферов храним не больше; 0 - пул не хранит ничего
+    bool opencv_default = false;  // пул как аллокатор OpenCV по умолчанию (временные матрицы эффектов); только при запуске
+};
+
+struct LoggingConfig
+{
+    std::string level = "info"; // trace, debug, info, warn, error, off
+};
+
+// Разобранная и проверенная конфигурация. Снимок неизменяем: при перезагрузке
+// создается новый и подменяется целиком, читатели продолжают работать со своим.
+struct ConfigSnapshot
+{
+    ServerConfig server;
+    WorkerConfig worker;
+    PostProcessorConfig postprocessor;
+    PipelineConfig pipeline;
+    LoggingConfig logging;
+    MetricsConfig metrics;
+    FramePoolConfig frame_pool;
+
+    // Все скалярные значения по путям вида "server.ip" - для getConfig
+    std::unordered_map<std::string, std::string> values;
+
+    std::string path; // файл, из которого прочитан снимок
+    uint64_t version = 0; // растет с каждой перезагрузкой
+
+    // Секция канала с заданным портом; nullptr - такой нет
+    const LinkConfig *findLink(int port) const;
+};
+
+// Разбор файла в снимок; nullptr - файл не читается или не YAML (причина в лог).
+// Неверные значения заменяются значениями по умолчанию с предупреждением.
+std::shared_ptr<ConfigSnapshot> parseConfigSnapshot(const std::string &path);
+
+// Изменение параметра, который стадии перечитывают на каждом кадре (канал управления).
+// Остальные параметры применяются только при запуске - для них вернется false.
+bool applyLiveSetting(ConfigSnapshot &snapshot, const std::string &key, const std::string &value,
+                      std::string &error);
+
+// Пути параметров, которые можно менять на ходу
+std::vector<std::string> liveSettingKeys();
+
+// Слежение за изменением файла конфигурации (inotify, только Linux).
+// Следит за каталогом файла, поэтому замечает и запись на месте, и замену файла редактором.
+class ConfigWatcher
+{
+public:
+    ConfigWatcher(const std::string &path, std::function<void()> on_change);
+    ~ConfigWatcher();
+
+    bool isWatching() const;
+
+private:
+    void run();
+
+    std::string directory;
+    std::string file_name;
+    std::function<void()> on_change;
+    int inotify_fd;
+    std::atomic<bool> running;
+    std::thread thread;
+};
+
+#endif // _CONFIG_SNAPSHOT_H_
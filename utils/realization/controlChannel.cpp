@@ -0,0 +1,76 @@
+#include <chrono>
+#include <zmq.hpp>
+
+#include "controlChannel.h"
+#include "logger.h"
+
+// Как часто поток проверяет флаг остановки
+static const int CONTROL_POLL_MS = 200;
+
+ControlChannel::ControlChannel(const std::string &ip, int port, std::function<std::string(const std::string &)> handler)
+    : handler(std::move(handler)), running(true)
+{
+    thread = std::thread(&ControlChannel::run, this, "tcp://" + ip + ":" + std::to_string(port));
+}
+
+ControlChannel::~ControlChannel()
+{
+    running = false;
+    if (thread.joinable())
+    {
+        thread.join();
+    }
+}
+
+bool ControlChannel::isListening() const
+{
+    return running;
+}
+
+void ControlChannel::run(std::string address)
+{
+    // Свой контекст: канал не зависит от сокетов передачи кадров
+    zmq::context_t context(1);
+    zmq::socket_t socket(context, zmq::socket_type::rep);
+
+    try
+    {
+        socket.set(zmq::sockopt::linger, 0);
+        socket.bind(address);
+        LOG_INFO("Control channel listening on: {}", address);
+    }
+    catch (const zmq::error_t &e)
+    {
+        LOG_ERROR("Control channel error: {}", e.what());
+        running = false;
+        return;
+    }
+
+    while (running)
+    {
+        try
+        {
+            zmq::pollitem_t items[] = {{static_cast<void *>(socket), 0, ZMQ_POLLIN, 0}};
+            zmq::poll(items, 1, std::chrono::milliseconds(CONTROL_POLL_MS));
+            if (!(items[0].revents & ZMQ_POLLIN))
+            {
+                continue;
+            }
+
+            zmq::message_t request;
+            if (!socket.recv(request, zmq::recv_flags::none))
+            {
+                continue;
+            }
+
+            std::string command = request.to_string();
+            std::string reply = handler(command);
+            LOG_INFO("Control: {} -> {}", command, reply);
+            socket.send(zmq::buffer(reply), zmq::send_flags::none);
+        }
+        catch (const zmq::error_t &e)
+        {
+            LOG_ERROR("Control channel error: {}", e.what());
+        }
+    }
+}
@@ -0,0 +1,28 @@
+#ifndef _CONTROL_CHANNEL_H_
+#define _CONTROL_CHANNEL_H_
+
+#include <atomic>
+#include <functional>
+#include <string>
+#include <thread>
+
+// Канал управления стадией: сокет REP в отдельном потоке.
+// Каждый запрос - одна текстовая команда, ответ строит обработчик.
+// Команды разбираются в Utils (см. Utils::startControl).
+class ControlChannel
+{
+public:
+    ControlChannel(const std::string &ip, int port, std::function<std::string(const std::string &)> handler);
+    ~ControlChannel();
+
+    bool isListening() const;
+
+private:
+    void run(std::string address);
+
+    std::function<std::string(const std::string &)> handler;
+    std::atomic<bool> running;
+    std::thread thread;
+};
+
+#endif // _CONTROL_CHANNEL_H_
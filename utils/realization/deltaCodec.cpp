@@ -0,0 +1,334 @@
+#include <algorithm>
+#include <cstdlib>
+#include <cstring>
+
+#include "deltaCodec.h"
+#include "framePool.h"
+
+// ============================================================================
+// ЗАПИСЬ И ЧТЕНИЕ ЧИСЕЛ (little-endian, независимо от платформы)
+// ============================================================================
+
+static void putUint(std::vector<uchar> &out, uint64_t value, int bytes)
+{
+    for (int i = 0; i < bytes; i++)
+    {
+        out.push_back(static_cast<uchar>(value >> (8 * i)));
+    }
+}
+
+static void putVarint(std::vector<uchar> &out, uint64_t value)
+{
+    while (value >= 0x80)
+    {
+        out.push_back(static_cast<uchar>(value | 0x80));
+        value >>= 7;
+    }
+    out.push_back(static_cast<uchar>(value));
+}
+
+// Чтение с проверкой границ
+struct ByteReader
+{
+    const uchar *data;
+    size_t size;
+    size_t pos;
+
+    bool getUint(uint64_t &value, int bytes)
+    {
+        if (size - pos < (size_t)bytes)
+        {
+            return false;
+        }
+        value = 0;
+        for (int i = 0; i < bytes; i++)
+        {
+            value |= (uint64_t)data[pos++] << (8 * i);
+        }
+        return true;
+    }
+
+    bool getVarint(uint64_t &value)
+    {
+        value = 0;
+        for (int shift = 0; shift < 64; shift += 7)
+        {
+            if (pos >= size)
+            {
+                return false;
+            }
+            uchar byte = data[pos++];
+            value |= (uint64_t)(byte & 0x7F) << shift;
+            if (!(byte & 0x80))
+            {
+                return true;
+            }
+        }
+        return false;
+    }
+};
+
+static const size_t DELTA_HEADER_SIZE = 16;
+
+// Плитка с номером index в сетке tiles_x по горизонтали
+static cv::Rect tileRect(int index, int tiles_x, int tile_size, int rows, int cols)
+{
+    int x = (index % tiles_x) * tile_size;
+    int y = (index / tiles_x) * tile_size;
+    return cv::Rect(x, y, std::min(tile_size, cols - x), std::min(tile_size, rows - y));
+}
+
+// ============================================================================
+// КОДЕР
+// ============================================================================
+
+DeltaEncoder::DeltaEncoder(int keyframe_interval, int tile_size, int threshold)
+    : keyframe_interval(std::max(1, keyframe_interval)),
+      tile_size(std::max(8, std::min(tile_size, 1024))),
+      threshold(std::max(0, threshold)),
+      reference_id(0),
+      frames_since_keyframe(0),
+      force_keyframe(true),
+      pending_id(0),
+      pending_keyframe(false),
+      has_pending(false)
+{
+}
+
+bool DeltaEncoder::tileChanged(const cv::Mat &frame, const cv::Rect &tile) const
+{
+    size_t row_bytes = tile.width * frame.elemSize();
+    for (int y = tile.y; y < tile.y + tile.height; y++)
+    {
+        const uchar *a = frame.ptr(y) + tile.x * frame.elemSize();
+        const uchar *b = reference.ptr(y) + tile.x * frame.elemSize();
+
+        if (threshold == 0)
+        {
+            if (memcmp(a, b, row_bytes) != 0)
+            {
+                return true;
+            }
+            continue;
+        }
+
+        for (size_t i = 0; i < row_bytes; i++)
+        {
+            if (std::abs((int)a[i] - (int)b[i]) > threshold)
+            {
+                return true;
+            }
+        }
+    }
+    return false;
+}
+
+bool DeltaEncoder::encode(const cv::Mat &frame, uint64_t frame_id, std::vector<uchar> &delta)
+{
+    delta.clear();
+    has_pending = true;
+    pending_id = frame_id;
+
+    bool keyframe = force_keyframe || reference.empty() ||
+                    frames_since_keyframe + 1 >= keyframe_interval ||
+                    frame.size() != reference.size() || frame.type() != reference.type();
+    if (keyframe)
+    {
+        pending = FramePool::instance().clone(frame);
+        pending_keyframe = true;
+        return false;
+    }
+
+    // Опорный кадр получателя после применения этой разности
+    pending = FramePool::instance().clone(reference);
+    pending_keyframe = false;
+
+    int tiles_x = (frame.cols + tile_size - 1) / tile_size;
+    int tiles_y = (frame.rows + tile_size - 1) / tile_size;
+    size_t elem = frame.elemSize();
+
+    putUint(delta, reference_id, 8);
+    putUint(delta, tile_size, 2);
+    putUint(delta, 0, 2);
+    putUint(delta, 0, 4); // число плиток, заполняется в конце
+
+    uint32_t changed = 0;
+    std::vector<uchar> residual;
+
+    for (int index = 0; index < tiles_x * tiles_y; index++)
+    {
+        cv::Rect tile = tileRect(index, tiles_x, tile_size, frame.rows, frame.cols);
+        if (!tileChanged(frame, tile))
+        {
+            continue;
+        }
+
+        // XOR с опорным построчно, затем RLE по нулям
+        residual.clear();
+        size_t row_bytes = tile.width * elem;
+        for (int y = tile.y; y < tile.y + tile.height; y++)
+        {
+            const uchar *a = frame.ptr(y) + tile.x * elem;
+            const uchar *b = reference.ptr(y) + tile.x * elem;
+            for (size_t i = 0; i < row_bytes; i++)
+            {
+                residual.push_back(a[i] ^ b[i]);
+            }
+        }
+
+        size_t size_pos = delta.size() + 4;
+        putUint(delta, index, 4);
+        putUint(delta, 0, 4);
+        size_t start = delta.size();
+
+        size_t i = 0;
+        while (i < residual.size())
+        {
+            size_t zeros = 0;
+            while (i + zeros < residual.size() && residual[i + zeros] == 0)
+            {
+                zeros++;
+            }
+            size_t literals = 0;
+            while (i + zeros + literals < residual.size() && residual[i + zeros + literals] != 0)
+            {
+                literals++;
+            }
+            putVarint(delta, zeros);
+            putVarint(delta, literals);
+            delta.insert(delta.end(), residual.begin() + i + zeros, residual.begin() + i + zeros + literals);
+            i += zeros + literals;
+        }
+
+        uint32_t encoded_size = (uint32_t)(delta.size() - start);
+        for (int b = 0; b < 4; b++)
+        {
+            delta[size_pos + b] = static_cast<uchar>(encoded_size >> (8 * b));
+        }
+
+        frame(tile).copyTo(pending(tile));
+        changed++;
+    }
+
+    for (int b = 0; b < 4; b++)
+    {
+        delta[12 + b] = static_cast<uchar>(changed >> (8 * b));
+    }
+    return true;
+}
+
+void DeltaEncoder::commit()
+{
+    if (!has_pending)
+    {
+        return;
+    }
+
+    reference = pending;
+    reference_id = pending_id;
+    frames_since_keyframe = pending_keyframe ? 0 : frames_since_keyframe + 1;
+    force_keyframe = false;
+
+    pending = cv::Mat();
+    has_pending = false;
+}
+
+void DeltaEncoder::rollback()
+{
+    pending = cv::Mat();
+    has_pending = false;
+}
+
+void DeltaEncoder::forceKeyframe()
+{
+    force_keyframe = true;
+}
+
+// ============================================================================
+// ДЕКОДЕР
+// ============================================================================
+
+DeltaDecoder::DeltaDecoder() : reference_id(0), has_reference(false), skipped_deltas(0) {}
+
+void DeltaDecoder::setKeyframe(const cv::Mat &frame, uint64_t frame_id)
+{
+    reference = frame;
+    reference_id = frame_id;
+    has_reference = true;
+}
+
+cv::Mat DeltaDecoder::applyDelta(const uchar *data, size_t size, int rows, int cols, int type, uint64_t frame_id)
+{
+    ByteReader reader = {data, size, 0};
+    uint64_t base_id, tile_size, reserved, changed;
+
+    bool header_ok = size >= DELTA_HEADER_SIZE &&
+                     reader.getUint(base_id, 8) && reader.getUint(tile_size, 2) &&
+                     reader.getUint(reserved, 2) && reader.getUint(changed, 4);
+
+    if (!header_ok || !has_reference || base_id != reference_id || tile_size == 0 ||
+        reference.rows != rows || reference.cols != cols || reference.type() != type)
+    {
+        // Опорный кадр потерян - до ключевого кадра разности применять нельзя
+        has_reference = false;
+        skipped_deltas++;
+        return cv::Mat();
+    }
+
+    int ts = (int)tile_size;
+    int tiles_x = (cols + ts - 1) / ts;
+    int tiles_y = (rows + ts - 1) / ts;
+    size_t elem = reference.elemSize();
+
+    cv::Mat frame = FramePool::instance().clone(reference);
+
+    for (uint64_t t = 0; t < changed; t++)
+    {
+        uint64_t index, encoded_size;
+        if (!reader.getUint(index, 4) || !reader.getUint(encoded_size, 4) ||
+            index >= (uint64_t)tiles_x * tiles_y || encoded_size > size - reader.pos)
+        {
+            has_reference = false;
+            skipped_deltas++;
+            return cv::Mat();
+        }
+
+        cv::Rect tile = tileRect((int)index, tiles_x, ts, rows, cols);
+        size_t row_bytes = tile.width * elem;
+        size_t tile_bytes = row_bytes * tile.height;
+
+        // Разворачиваем RLE прямо в плитку кадра (XOR с опорным)
+        ByteReader rle = {data + reader.pos, (size_t)encoded_size, 0};
+        size_t offset = 0;
+        while (offset < tile_bytes)
+        {
+            uint64_t zeros, literals;
+            if (!rle.getVarint(zeros) || !rle.getVarint(literals) ||
+                zeros > tile_bytes - offset || literals > tile_bytes - offset - zeros ||
+                literals > rle.size - rle.pos)
+            {
+                has_reference = false;
+                skipped_deltas++;
+                return cv::Mat();
+            }
+
+            offset += zeros;
+            for (uint64_t i = 0; i < literals; i++, offset++)
+            {
+                int y = tile.y + (int)(offset / row_bytes);
+                size_t x = tile.x * elem + offset % row_bytes;
+                frame.ptr(y)[x] ^= rle.data[rle.pos++];
+            }
+        }
+        reader.pos += encoded_size;
+    }
+
+    reference = frame;
+    reference_id = frame_id;
+    return frame;
+}
+
+uint64_t DeltaDecoder::getSkippedDeltas() const
+{
+    return skipped_deltas;
+}
@@ -0,0 +1,82 @@
+#ifndef _DELTA_CODEC_H_
+#define _DELTA_CODEC_H_
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#include <opencv2/core.hpp>
+
+// Межкадровое кодирование для канала захват -> обработчик.
+// Кадр делится на плитки tile_size x tile_size; передаются только изменившиеся плитки
+// как XOR с опорным кадром, сжатый RLE по нулям. Каждые keyframe_interval кадров
+// (и при смене размера/типа) отправляется полный ключевой кадр.
+//
+// Формат разности (little-endian):
+//   uint64 base_id, uint16 tile_size, uint16 reserved, uint32 changed_tiles,
+//   затем для каждой плитки: uint32 tile_index, uint32 encoded_size, encoded_size байт RLE.
+// RLE: пары varint(нулей подряд), varint(литералов) + литералы, до заполнения плитки.
+
+class DeltaEncoder
+{
+public:
+    // threshold - максимальная разница байта, при которой плитка считается неизменной.
+    // 0 - кодирование без потерь.
+    DeltaEncoder(int keyframe_interval = 30, int tile_size = 32, int threshold = 0);
+
+    // Возвращает false, если нужен ключевой кадр: тогда кадр отправляется целиком.
+    // Иначе в delta записывается разность с опорным кадром.
+    // В обоих случаях кадр станет опорным только после commit().
+    bool encode(const cv::Mat &frame, uint64_t frame_id, std::vector<uchar> &delta);
+
+    // Кадр ушел в сокет - получатель будет опираться на него
+    void commit();
+
+    // Кадр не ушел (буфер полон) - опорным остается прежний кадр
+    void rollback();
+
+    // Следующий кадр будет ключевым (например, после переподключения получателя)
+    void forceKeyframe();
+
+private:
+    int keyframe_interval;
+    int tile_size;
+    int threshold;
+
+    cv::Mat reference; // то, что сейчас есть у получателя
+    uint64_t reference_id;
+    int frames_since_keyframe;
+    bool force_keyframe;
+
+    cv::Mat pending;
+    uint64_t pending_id;
+    bool pending_keyframe;
+    bool has_pending;
+
+    bool tileChanged(const cv::Mat &frame, const cv::Rect &tile) const;
+};
+
+class DeltaDecoder
+{
+public:
+    DeltaDecoder();
+
+    // Ключевой кадр становится опорным
+    void setKeyframe(const cv::Mat &frame, uint64_t frame_id);
+
+    // Применяет разность к опорному кадру. Пустая матрица - разность построена не от
+    // нашего опорного кадра (кадр потерян) или испорчена; ждем следующий ключевой кадр.
+    // Возвращаемый кадр разделяет память с опорным: перед записью в него нужен clone().
+    cv::Mat applyDelta(const uchar *data, size_t size, int rows, int cols, int type, uint64_t frame_id);
+
+    // Сколько разностей отброшено в ожидании ключевого кадра
+    uint64_t getSkippedDeltas() const;
+
+private:
+    cv::Mat reference;
+    uint64_t reference_id;
+    bool has_reference;
+    uint64_t skipped_deltas;
+};
+
+#endif // _DELTA_CODEC_H_
@@ -0,0 +1,240 @@
+#include "framePool.h"
+
+// Аллокатор OpenCV поверх пула. Логика шагов та же, что у стандартного аллокатора,
+// отличается только источник памяти.
+class PoolAllocator : public cv::MatAllocator
+{
+public:
+    cv::UMatData *allocate(int dims, const int *sizes, int type, void *data0, size_t *step,
+                           cv::AccessFlag /*flags*/, cv::UMatUsageFlags /*usageFlags*/) const override
+    {
+        size_t total = CV_ELEM_SIZE(type);
+        for (int i = dims - 1; i >= 0; i--)
+        {
+            if (step)
+            {
+                if (data0 && step[i] != CV_AUTOSTEP)
+                {
+                    CV_Assert(total <= step[i]);
+                    total = step[i];
+                }
+                else
+                {
+                    step[i] = total;
+                }
+            }
+            total *= sizes[i];
+        }
+
+        cv::UMatData *u = new cv::UMatData(this);
+        u->data = u->origdata = data0 ? static_cast<uchar *>(data0)
+                                      : static_cast<uchar *>(FramePool::instance().acquire(total));
+        u->size = total;
+        if (data0)
+        {
+            u->flags |= cv::UMatData::USER_ALLOCATED;
+        }
+        return u;
+    }
+
+    bool allocate(cv::UMatData *u, cv::AccessFlag /*accessFlags*/, cv::UMatUsageFlags /*usageFlags*/) const override
+    {
+        return u != nullptr;
+    }
+
+    void deallocate(cv::UMatData *u) const override
+    {
+        if (!u)
+        {
+            return;
+        }
+        CV_Assert(u->urefcount == 0 && u->refcount == 0);
+        if (!(u->flags & cv::UMatData::USER_ALLOCATED))
+        {
+            FramePool::instance().release(u->origdata, u->size);
+            u->origdata = nullptr;
+        }
+        delete u;
+    }
+};
+
+static PoolAllocator &poolAllocator()
+{
+    static PoolAllocator *instance = new PoolAllocator(); // Живет дольше любых матриц
+    return *instance;
+}
+
+// Вызывается ZeroMQ, когда сообщение больше не нужно; hint - емкость буфера
+static void releaseToPool(void *data, void *hint)
+{
+    FramePool::instance().release(data, reinterpret_cast<size_t>(hint));
+}
+
+FramePool &FramePool::instance()
+{
+    static FramePool *pool = new FramePool();
+    return *pool;
+}
+
+FramePool::FramePool()
+    : cached_bytes(0),
+      capacity(DEFAULT_CAPACITY),
+      opencv_default(false),
+      opencv_default_applied(false),
+      hits(MetricsRegistry::instance().counter("frame_pool_hits_total")),
+      misses(MetricsRegistry::instance().counter("frame_pool_misses_total")),
+      cached(MetricsRegistry::instance().gauge("frame_pool_cached_bytes"))
+{
+}
+
+// Округление вверх до ступени: 8 ступеней между соседними степенями двойки
+size_t FramePool::classSize(size_t size)
+{
+    if (size < MIN_POOLED_BYTES)
+    {
+        return size;
+    }
+
+    size_t base = 1;
+    while (base * 2 < size)
+    {
+        base *= 2;
+    }
+    size_t step = base / 8;
+    return base + (size - base + step - 1) / step * step;
+}
+
+void *FramePool::acquire(size_t capacity_bytes)
+{
+    size_t size = classSize(capacity_bytes);
+    if (size >= MIN_POOLED_BYTES)
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        auto found = free_buffers.find(size);
+        if (found != free_buffers.end() && !found->second.empty())
+        {
+            void *data = found->second.back();
+            found->second.pop_back();
+            cached_bytes -= size;
+            cached.set((int64_t)cached_bytes);
+            hits.add();
+            return data;
+        }
+        misses.add();
+    }
+    return cv::fastMalloc(size);
+}
+
+void FramePool::release(void *data, size_t capacity_bytes)
+{
+    if (!data)
+    {
+        return;
+    }
+
+    size_t size = classSize(capacity_bytes);
+    if (size >= MIN_POOLED_BYTES)
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        if (cached_bytes + size <= capacity)
+        {
+            free_buffers[size].push_back(data);
+            cached_bytes += size;
+            cached.set((int64_t)cached_bytes);
+            return;
+        }
+    }
+    cv::fastFree(data);
+}
+
+cv::Mat FramePool::create(int rows, int cols, int type)
+{
+    cv::Mat image;
+    image.allocator = &poolAllocator();
+    image.create(rows, cols, type);
+    return image;
+}
+
+cv::Mat FramePool::clone(const cv::Mat &image)
+{
+    cv::Mat copy;
+    if (image.empty())
+    {
+        return copy;
+    }
+    copy.allocator = &poolAllocator();
+    image.copyTo(copy);
+    return copy;
+}
+
+zmq::message_t FramePool::createMessage(size_t size)
+{
+    return wrapInMessage(acquire(size), size, size);
+}
+
+zmq::message_t FramePool::wrapInMessage(void *data, size_t size, size_t capacity_bytes)
+{
+    try
+    {
+        return zmq::message_t(data, size, releaseToPool, reinterpret_cast<void *>(capacity_bytes));
+    }
+    catch (...)
+    {
+        release(data, capacity_bytes);
+        throw;
+    }
+}
+
+cv::MatAllocator *FramePool::allocator()
+{
+    return &poolAllocator();
+}
+
+bool FramePool::setDefaultForOpenCV(bool enabled)
+{
+    // Аллокатор по умолчанию - глобальная переменная OpenCV без синхронизации: менять ее,
+    // пока другие потоки создают матрицы, нельзя. Поэтому действует только первый вызов
+    // (первая загрузка конфигурации, до запуска потоков), повторные лишь сообщают о расхождении
+    std::lock_guard<std::mutex> lock(mutex);
+    if (opencv_default_applied)
+    {
+        return enabled == opencv_default;
+    }
+    opencv_default_applied = true;
+    opencv_default = enabled;
+    if (enabled)
+    {
+        cv::Mat::setDefaultAllocator(&poolAllocator());
+    }
+    return true;
+}
+
+void FramePool::setCapacity(size_t bytes)
+{
+    std::vector<void *> evicted;
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        capacity = bytes;
+        // Свободные буферы сверх нового предела освобождаются сразу
+        for (auto it = free_buffers.begin(); cached_bytes > capacity && it != free_buffers.end(); ++it)
+        {
+            while (cached_bytes > capacity && !it->second.empty())
+            {
+                evicted.push_back(it->second.back());
+                it->second.pop_back();
+                cached_bytes -= it->first;
+            }
+        }
+        cached.set((int64_t)cached_bytes);
+    }
+    for (void *data : evicted)
+    {
+        cv::fastFree(data);
+    }
+}
+
+size_t FramePool::getCachedBytes()
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    return cached_bytes;
+}
@@ -0,0 +1,82 @@
+#ifndef _FRAME_POOL_H_
+#define _FRAME_POOL_H_
+
+#include <cstddef>
+#include <cstdint>
+#include <mutex>
+#include <unordered_map>
+#include <vector>
+
+#include <opencv2/core.hpp>
+#include <zmq.hpp>
+
+#include "metrics.h"
+
+// Пул буферов кадров по классам размеров.
+// Кадр 1920x1080x3 занимает 6 МБ: malloc отдает такие блоки через mmap, и каждый кадр
+// стоит page fault'ов на первую запись и munmap/madvise при освобождении. Пул хранит
+// освобожденные буферы и выдает их снова, поэтому в установившемся режиме кадры
+// не выделяют память в куче.
+//
+// Классы - 8 ступеней на каждую степень двойки (перерасход не больше 12.5%).
+// Блоки меньше MIN_POOLED_BYTES идут напрямую в cv::fastMalloc: для них malloc и так быстр.
+// Свободных буферов хранится не больше setCapacity байт, лишние освобождаются сразу.
+//
+// Буферы возвращаются в пул из любого потока: из деструктора cv::Mat или из потока
+// ввода-вывода ZeroMQ, когда сообщение отправлено.
+class FramePool
+{
+public:
+    static const size_t MIN_POOLED_BYTES = 64 * 1024;
+    static const size_t DEFAULT_CAPACITY = 256u << 20;
+
+    // Пул не уничтожается: матрицы могут освобождаться и при завершении процесса
+    static FramePool &instance();
+
+    // Матрица на буфере из пула; буфер вернется, когда отпущена последняя ссылка.
+    // create() на такой матрице тоже берет буфер из пула
+    cv::Mat create(int rows, int cols, int type);
+
+    // Непрерывная копия изображения в буфере из пула
+    cv::Mat clone(const cv::Mat &image);
+
+    // Сообщение ZeroMQ на буфере из пула; буфер вернется, когда ZeroMQ отпустит сообщение
+    zmq::message_t createMessage(size_t size);
+
+    // Для буферов, заполняемых не целиком (сжатие): capacity байт берется у acquire,
+    // сообщение получает первые size байт, а в пул возвращаются все capacity
+    void *acquire(size_t capacity);
+    void release(void *data, size_t capacity);
+    zmq::message_t wrapInMessage(void *data, size_t size, size_t capacity);
+
+    cv::MatAllocator *allocator();
+
+    // Пул как аллокатор OpenCV по умолчанию: через него идут и временные матрицы
+    // внутри cvtColor, Canny и т.п. Применяется один раз за процесс, до запуска потоков;
+    // false при повторном вызове - значение отличается от примененного и не изменено
+    bool setDefaultForOpenCV(bool enabled);
+
+    void setCapacity(size_t bytes);
+
+    // Выдачи из пула и новые выделения (метрики frame_pool_hits_total, frame_pool_misses_total)
+    uint64_t getHits() const { return hits.get(); }
+    uint64_t getMisses() const { return misses.get(); }
+    size_t getCachedBytes();
+
+private:
+    FramePool();
+
+    static size_t classSize(size_t size);
+
+    std::mutex mutex;
+    std::unordered_map<size_t, std::vector<void *>> free_buffers; // размер класса -> свободные буферы
+    size_t cached_bytes;
+    size_t capacity;
+    bool opencv_default; // пул сейчас аллокатор OpenCV по умолчанию
+    bool opencv_default_applied; // настройка уже применена, дальше не меняется
+    Counter &hits;
+    Counter &misses;
+    Gauge &cached;
+};
+
+#endif // _FRAME_POOL_H_
@@ -0,0 +1,132 @@
+#ifndef _FRAME_QUEUE_H_
+#define _FRAME_QUEUE_H_
+
+#include <chrono>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <mutex>
+#include <utility>
+
+#include <opencv2/core.hpp>
+
+#include "frameTrace.h"
+
+// Кадр внутри одного процесса: матрица передается по счетчику ссылок, без копирования
+struct PipelineFrame
+{
+    cv::Mat image;
+    uint64_t id;
+    FrameTrace trace;
+};
+
+// Ограниченная очередь между потоками стадий.
+// close() будит всех ожидающих: pop возвращает false, когда очередь закрыта и пуста.
+template <typename T>
+class FrameQueue
+{
+public:
+    explicit FrameQueue(size_t capacity) : capacity(capacity > 0 ? capacity : 1), closed(false) {}
+
+    // Блокирующая вставка; false - очередь закрыта
+    bool push(T item)
+    {
+        std::unique_lock<std::mutex> lock(mutex);
+        not_full.wait(lock, [this]() { return closed || items.size() < capacity; });
+        if (closed)
+        {
+            return false;
+        }
+        items.push_back(std::move(item));
+        not_empty.notify_one();
+        return true;
+    }
+
+    // Вставка без ожидания; false - очередь полна или закрыта
+    bool tryPush(T item)
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        if (closed || items.size() >= capacity)
+        {
+            return false;
+        }
+        items.push_back(std::move(item));
+        not_empty.notify_one();
+        return true;
+    }
+
+    // Вставка без ожидания с вытеснением самого старого элемента при переполнении.
+    // replaced - был ли вытеснен элемент; false - очередь закрыта
+    bool pushDropOldest(T item, bool &replaced)
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        replaced = false;
+        if (closed)
+        {
+            return false;
+        }
+        if (items.size() >= capacity)
+        {
+            items.pop_front();
+            replaced = true;
+        }
+        items.push_back(std::move(item));
+        not_empty.notify_one();
+        return true;
+    }
+
+    // Блокирующее извлечение; false - очередь закрыта и пуста
+    bool pop(T &item)
+    {
+        std::unique_lock<std::mutex> lock(mutex);
+        not_empty.wait(lock, [this]() { return closed || !items.empty(); });
+        if (items.empty())
+        {
+            return false;
+        }
+        item = std::move(items.front());
+        items.pop_front();
+        not_full.notify_one();
+        return true;
+    }
+
+    // Извлечение с таймаутом; false - за отведенное время ничего не пришло
+    bool popFor(T &item, std::chrono::milliseconds timeout)
+    {
+        std::unique_lock<std::mutex> lock(mutex);
+        not_empty.wait_for(lock, timeout, [this]() { return closed || !items.empty(); });
+        if (items.empty())
+        {
+            return false;
+        }
+        item = std::move(items.front());
+        items.pop_front();
+        not_full.notify_one();
+        return true;
+    }
+
+    void close()
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        closed = true;
+        not_empty.notify_all();
+        not_full.notify_all();
+    }
+
+    size_t size()
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        return items.size();
+    }
+
+private:
+    size_t capacity;
+    bool closed;
+    std::deque<T> items;
+    std::mutex mutex;
+    std::condition_variable not_empty;
+    std::condition_variable not_full;
+};
+
+#endif // _FRAME_QUEUE_H_
@@ -0,0 +1,98 @@
+#ifndef _FRAME_TRACE_H_
+#define _FRAME_TRACE_H_
+
+#include <chrono>
+#include <cstdint>
+#include <cstring>
+
+// Трассировка кадра через все стадии.
+// Кадр несет время захвата и интервалы стадий; каждая стадия дописывает свои.
+// Время - микросекунды системных часов (UNIX epoch): стадии на разных машинах
+// сопоставимы настолько, насколько синхронизированы их часы (NTP).
+// Промежутки между интервалами - очереди и сеть, их показывает экспорт трассы.
+
+enum class TraceStage : uint8_t
+{
+    Capture = 1,     // чтение кадра с камеры
+    ServerQueue = 2, // ожидание свободного worker'а в dispatcher
+    Worker = 3,      // от приема кадра worker'ом до отправки результата
+    Effect = 4,      // applyEffect
+    Reorder = 5,     // ожидание пропущенных предшественников в postprocessor
+    Buffer = 6,      // ожидание заполнения части буфера видео
+    Encode = 7       // saveFramesToVideo
+};
+
+inline const char *traceStageName(TraceStage stage)
+{
+    switch (stage)
+    {
+    case TraceStage::Capture:
+        return "capture";
+    case TraceStage::ServerQueue:
+        return "server_queue";
+    case TraceStage::Worker:
+        return "worker";
+    case TraceStage::Effect:
+        return "applyEffect";
+    case TraceStage::Reorder:
+        return "reorder";
+    case TraceStage::Buffer:
+        return "buffer";
+    case TraceStage::Encode:
+        return "saveFramesToVideo";
+    }
+    return "unknown";
+}
+
+inline uint64_t traceNowUs()
+{
+    return std::chrono::duration_cast<std::chrono::microseconds>(
+               std::chrono::system_clock::now().time_since_epoch())
+        .count();
+}
+
+const uint8_t TRACE_MAX_SPANS = 8;
+
+// Блок трассы на проводе (после FrameHeader версии 3): 16 байт + span_count интервалов
+#pragma pack(push, 1)
+struct TraceSpan
+{
+    uint8_t stage; // TraceStage
+    uint8_t reserved[7];
+    uint64_t begin_us;
+    uint64_t end_us;
+};
+
+struct FrameTrace
+{
+    uint64_t capture_us; // 0 - кадр без трассы
+    uint8_t span_count;
+    uint8_t reserved[7];
+    TraceSpan spans[TRACE_MAX_SPANS];
+
+    FrameTrace() { std::memset(this, 0, sizeof(*this)); }
+
+    bool empty() const { return capture_us == 0; }
+
+    // Размер на проводе: только заполненные интервалы
+    size_t wireSize() const { return 16 + span_count * sizeof(TraceSpan); }
+
+    // Лишние интервалы сверх TRACE_MAX_SPANS отбрасываются
+    void addSpan(TraceStage stage, uint64_t begin_us, uint64_t end_us)
+    {
+        if (empty() || span_count >= TRACE_MAX_SPANS)
+        {
+            return;
+        }
+        TraceSpan &span = spans[span_count++];
+        span.stage = static_cast<uint8_t>(stage);
+        span.begin_us = begin_us;
+        span.end_us = end_us;
+    }
+
+    // Конец последнего интервала - начало ожидания следующей стадии
+    uint64_t lastEndUs() const { return span_count > 0 ? spans[span_count - 1].end_us : capture_us; }
+};
+#pragma pack(pop)
+
+#endif // _FRAME_TRACE_H_
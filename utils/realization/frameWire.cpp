@@ -0,0 +1,215 @@
+#include <algorithm>
+#include <cstring>
+
+#include "frameWire.h"
+#include "logger.h"
+#include "metrics.h"
+
+// Разбор блока трассы за заголовком версии 3: те же байты, что у FrameTrace, до последнего интервала
+static bool parseFrameTrace(const uint8_t *data, size_t size, FrameTrace &trace)
+{
+    FrameTrace parsed;
+    size_t fixed_size = parsed.wireSize();
+    if (size < fixed_size)
+    {
+        return false;
+    }
+    memcpy(&parsed, data, fixed_size);
+    if (parsed.span_count > TRACE_MAX_SPANS || size != parsed.wireSize())
+    {
+        return false;
+    }
+    memcpy(&parsed, data, size);
+    trace = parsed;
+    return true;
+}
+
+// Разбор заголовка. Размер полезной нагрузки проверяет кодек.
+static bool parseFrameHeader(const zmq::message_t &message, FrameHeader &header, FrameTrace &trace)
+{
+    if (message.size() < FRAME_HEADER_SIZE_V1)
+    {
+        return false;
+    }
+
+    memset(&header, 0, sizeof(header));
+    memcpy(&header, message.data(), std::min(message.size(), sizeof(header)));
+    trace = FrameTrace();
+
+    if (header.magic != FRAME_MAGIC)
+    {
+        return false;
+    }
+    if (header.version == FRAME_VERSION_1)
+    {
+        if (message.size() != FRAME_HEADER_SIZE_V1 || header.header_size != FRAME_HEADER_SIZE_V1)
+        {
+            return false;
+        }
+        header.codec = static_cast<uint8_t>(CodecId::Raw);
+    }
+    else if (header.version == FRAME_VERSION)
+    {
+        if (message.size() != sizeof(FrameHeader) || header.header_size != sizeof(FrameHeader))
+        {
+            return false;
+        }
+    }
+    else if (header.version == FRAME_VERSION_TRACE)
+    {
+        const uint8_t *data = static_cast<const uint8_t *>(message.data());
+        if (message.size() <= sizeof(FrameHeader) || header.header_size != sizeof(FrameHeader) ||
+            !parseFrameTrace(data + sizeof(FrameHeader), message.size() - sizeof(FrameHeader), trace))
+        {
+            return false;
+        }
+    }
+    else
+    {
+        return false;
+    }
+
+    if (header.rows <= 0 || header.cols <= 0 || CV_MAT_TYPE(header.type) != header.type)
+    {
+        return false;
+    }
+
+    uint64_t row_bytes = (uint64_t)header.cols * CV_ELEM_SIZE(header.type);
+    return header.step >= row_bytes && header.step <= (uint64_t)SIZE_MAX / header.rows;
+}
+
+void encodeFrame(const cv::Mat &image, uint64_t frame_id, const ImageCodec *&codec,
+                 zmq::message_t &header_msg, zmq::message_t &payload, const FrameTrace *trace)
+{
+    static LatencyHistogram &serialize_time = MetricsRegistry::instance().histogram("utils_serialize_us");
+    ScopedTimer timer(serialize_time);
+
+    // Тип, который кодек не передает как есть, и ошибка кодирования - отправка в Raw
+    payload = codec->supports(image.type()) ? codec->encode(image) : zmq::message_t();
+    if (payload.size() == 0 && codec->id() != CodecId::Raw)
+    {
+        codec = CodecRegistry::instance().find(CodecId::Raw);
+        payload = codec->encode(image);
+    }
+
+    FrameHeader header;
+    memset(&header, 0, sizeof(header));
+    header.magic = FRAME_MAGIC;
+    header.version = FRAME_VERSION;
+    header.header_size = sizeof(FrameHeader);
+    header.rows = image.rows;
+    header.cols = image.cols;
+    header.type = image.type();
+    header.step = image.cols * image.elemSize(); // кодеки укладывают строки подряд
+    header.frame_id = frame_id;
+    header.codec = static_cast<uint8_t>(codec->id());
+
+    if (!trace || trace->empty())
+    {
+        header_msg.rebuild(&header, sizeof(header));
+        return;
+    }
+
+    header.version = FRAME_VERSION_TRACE;
+    header_msg.rebuild(sizeof(header) + trace->wireSize());
+    uint8_t *out = static_cast<uint8_t *>(header_msg.data());
+    memcpy(out, &header, sizeof(header));
+    memcpy(out + sizeof(header), trace, trace->wireSize());
+}
+
+cv::Mat decodeFrame(const zmq::message_t &header_msg, zmq::message_t &&payload,
+                    uint64_t &frame_id, const ImageCodec *&codec, FrameTrace *trace)
+{
+    static LatencyHistogram &deserialize_time = MetricsRegistry::instance().histogram("utils_deserialize_us");
+    ScopedTimer timer(deserialize_time);
+
+    FrameHeader header;
+    FrameTrace parsed_trace;
+    if (!parseFrameHeader(header_msg, header, parsed_trace))
+    {
+        LOG_ERROR("Failed to deserialize received image");
+        return cv::Mat();
+    }
+
+    // Декодер выбирается по идентификатору из заголовка, а не по своим настройкам
+    codec = CodecRegistry::instance().find(static_cast<CodecId>(header.codec));
+    if (!codec)
+    {
+        LOG_ERROR("Unsupported codec id: {}", (int)header.codec);
+        return cv::Mat();
+    }
+
+    FrameGeometry geometry = {header.rows, header.cols, header.type, (size_t)header.step};
+    cv::Mat image = codec->decode(std::move(payload), geometry);
+    if (image.empty())
+    {
+        LOG_ERROR("Failed to deserialize received image");
+        return cv::Mat();
+    }
+
+    frame_id = header.frame_id;
+    if (trace)
+    {
+        *trace = parsed_trace;
+    }
+    return image;
+}
+
+zmq::message_t encodeBatchIndex(const std::vector<zmq::message_t> &frame_headers)
+{
+    BatchHeader header;
+    memset(&header, 0, sizeof(header));
+    header.magic = BATCH_MAGIC;
+    header.version = BATCH_VERSION;
+    header.header_size = sizeof(BatchHeader);
+    header.count = static_cast<uint32_t>(frame_headers.size());
+
+    zmq::message_t index(sizeof(BatchHeader) + frame_headers.size() * sizeof(FrameHeader));
+    uchar *out = static_cast<uchar *>(index.data());
+    memcpy(out, &header, sizeof(header));
+    out += sizeof(header);
+
+    for (const auto &frame_header : frame_headers)
+    {
+        // Все заголовки таблицы одного размера - текущей версии
+        memcpy(out, frame_header.data(), sizeof(FrameHeader));
+        out += sizeof(FrameHeader);
+    }
+    return index;
+}
+
+bool isBatchIndex(const zmq::message_t &message)
+{
+    uint32_t magic = 0;
+    if (message.size() < sizeof(BatchHeader))
+    {
+        return false;
+    }
+    memcpy(&magic, message.data(), sizeof(magic));
+    return magic == BATCH_MAGIC;
+}
+
+bool decodeBatchIndex(const zmq::message_t &message, std::vector<zmq::message_t> &frame_headers)
+{
+    if (!isBatchIndex(message))
+    {
+        return false;
+    }
+
+    BatchHeader header;
+    memcpy(&header, message.data(), sizeof(header));
+    if (header.version != BATCH_VERSION || header.header_size != sizeof(BatchHeader) ||
+        message.size() != sizeof(BatchHeader) + (size_t)header.count * sizeof(FrameHeader))
+    {
+        return false;
+    }
+
+    const uchar *entry = static_cast<const uchar *>(message.data()) + sizeof(BatchHeader);
+    frame_headers.clear();
+    for (uint32_t i = 0; i < header.count; i++)
+    {
+        frame_headers.emplace_back(entry, sizeof(FrameHeader));
+        entry += sizeof(FrameHeader);
+    }
+    return true;
+}
@@ -0,0 +1,80 @@
+#ifndef _FRAME_WIRE_H_
+#define _FRAME_WIRE_H_
+
+#include <cstdint>
+#include <vector>
+
+#include <opencv2/core.hpp>
+#include <zmq.hpp>
+
+#include "codecs.h"
+#include "frameTrace.h"
+
+// Заголовок кадра (первая часть multipart-сообщения).
+// Вторая часть - полезная нагрузка кодека; для raw это rows строк по step байт.
+// В версии 3 сразу за заголовком (header_size байт) идет блок трассы FrameTrace.
+#pragma pack(push, 1)
+struct FrameHeader
+{
+    uint32_t magic;
+    uint16_t version;
+    uint16_t header_size;
+    int32_t rows;
+    int32_t cols;
+    int32_t type; // тип OpenCV (CV_8UC3, CV_8UC1, ...)
+    uint64_t step; // байт на строку
+    uint64_t frame_id;
+    // Поля версии 2
+    uint8_t codec; // CodecId полезной нагрузки
+    uint8_t reserved[3];
+};
+#pragma pack(pop)
+
+const uint32_t FRAME_MAGIC = 0x4D415246; // "FRAM"
+const uint16_t FRAME_VERSION = 2;
+
+// Версия 3 - заголовок версии 2 и трасса кадра; без трассы кадр уходит версией 2
+const uint16_t FRAME_VERSION_TRACE = 3;
+
+// Версия 1 не передавала кодек: всегда raw
+const uint16_t FRAME_VERSION_1 = 1;
+const uint16_t FRAME_HEADER_SIZE_V1 = 36;
+
+// Пакет кадров: первая часть - BatchHeader и таблица из count заголовков FrameHeader,
+// далее count частей с полезной нагрузкой в том же порядке.
+#pragma pack(push, 1)
+struct BatchHeader
+{
+    uint32_t magic;
+    uint16_t version;
+    uint16_t header_size; // размер BatchHeader без таблицы
+    uint32_t count;       // кадров в пакете
+    uint32_t reserved;
+};
+#pragma pack(pop)
+
+const uint32_t BATCH_MAGIC = 0x48435442; // "BTCH"
+const uint16_t BATCH_VERSION = 1;
+
+// Кадр -> заголовок + полезная нагрузка.
+// Кодек может не поддерживать тип кадра (например, JPEG и 16 бит) - тогда codec заменяется на raw.
+// Непустая трасса дописывается в заголовок (версия 3). Таблица пакета хранит заголовки
+// фиксированного размера, поэтому для кадров пакета трасса не передается.
+void encodeFrame(const cv::Mat &image, uint64_t frame_id, const ImageCodec *&codec,
+                 zmq::message_t &header_msg, zmq::message_t &payload, const FrameTrace *trace = nullptr);
+
+// Заголовок + полезная нагрузка -> кадр. Пустая матрица при ошибке (причина выводится в лог).
+// trace получает трассу кадра; у кадров без трассы она пустая.
+cv::Mat decodeFrame(const zmq::message_t &header_msg, zmq::message_t &&payload,
+                    uint64_t &frame_id, const ImageCodec *&codec, FrameTrace *trace = nullptr);
+
+// Заголовки кадров пакета -> первая часть пакетного сообщения
+zmq::message_t encodeBatchIndex(const std::vector<zmq::message_t> &frame_headers);
+
+// Является ли часть сообщения таблицей пакета
+bool isBatchIndex(const zmq::message_t &message);
+
+// Первая часть пакетного сообщения -> заголовки кадров (копируется только таблица)
+bool decodeBatchIndex(const zmq::message_t &message, std::vector<zmq::message_t> &frame_headers);
+
+#endif // _FRAME_WIRE_H_
@@ -0,0 +1,203 @@
+#include <ctime>
+#include <iomanip>
+#include <iostream>
+#include <sstream>
+
+#include "logger.h"
+
+// Пауза фонового потока, когда кольцо пусто
+static const int LOG_IDLE_MS = 5;
+
+static const char *LEVEL_NAMES[] = {"TRACE", "DEBUG", "INFO", "WARN", "ERROR", "OFF"};
+
+Logger &Logger::instance()
+{
+    static Logger logger;
+    return logger;
+}
+
+Logger::Logger()
+    : cells(new Cell[LOG_CAPACITY]), enqueue_position(0), dequeue_position(0),
+      min_level(static_cast<int>(LogLevel::Info)), dropped(0), running(true)
+{
+    static_assert((LOG_CAPACITY & (LOG_CAPACITY - 1)) == 0, "LOG_CAPACITY must be a power of two");
+    for (size_t i = 0; i < LOG_CAPACITY; i++)
+    {
+        cells[i].sequence.store(i, std::memory_order_relaxed);
+    }
+    thread = std::thread(&Logger::run, this);
+}
+
+Logger::~Logger()
+{
+    running = false;
+    if (thread.joinable())
+    {
+        thread.join();
+    }
+}
+
+void Logger::setLevel(LogLevel level)
+{
+    min_level.store(static_cast<int>(level), std::memory_order_relaxed);
+}
+
+LogLevel Logger::getLevel() const
+{
+    return static_cast<LogLevel>(min_level.load(std::memory_order_relaxed));
+}
+
+bool Logger::parseLevel(const std::string &name, LogLevel &level)
+{
+    static const char *names[] = {"trace", "debug", "info", "warn", "error", "off"};
+    for (int i = 0; i <= static_cast<int>(LogLevel::Off); i++)
+    {
+        if (name == names[i])
+        {
+            level = static_cast<LogLevel>(i);
+            return true;
+        }
+    }
+    return false;
+}
+
+Logger::Cell *Logger::claim(size_t &position)
+{
+    position = enqueue_position.load(std::memory_order_relaxed);
+    while (true)
+    {
+        Cell *cell = &cells[position & (LOG_CAPACITY - 1)];
+        size_t sequence = cell->sequence.load(std::memory_order_acquire);
+        intptr_t difference = static_cast<intptr_t>(sequence) - static_cast<intptr_t>(position);
+
+        if (difference == 0)
+        {
+            // Ячейка свободна - занимаем ее, если другой поток не успел раньше
+            if (enqueue_position.compare_exchange_weak(position, position + 1, std::memory_order_relaxed))
+            {
+                return cell;
+            }
+        }
+        else if (difference < 0)
+        {
+            return nullptr; // кольцо заполнено
+        }
+        else
+        {
+            position = enqueue_position.load(std::memory_order_relaxed);
+        }
+    }
+}
+
+// Подстановка аргументов записи в формат
+static void formatRecord(const LogRecord &record, std::string &output)
+{
+    std::time_t seconds = std::chrono::system_clock::to_time_t(record.time);
+    auto milliseconds = std::chrono::duration_cast<std::chrono::milliseconds>(
+                            record.time.time_since_epoch()) % 1000;
+    std::tm local;
+#ifdef _WIN32
+    localtime_s(&local, &seconds);
+#else
+    localtime_r(&seconds, &local);
+#endif
+
+    std::ostringstream line;
+    line << std::put_time(&local, "%H:%M:%S") << "." << std::setw(3) << std::setfill('0')
+         << milliseconds.count() << std::setfill(' ') << " [" << LEVEL_NAMES[static_cast<int>(record.level)] << "] ";
+
+    size_t next_arg = 0;
+    for (const char *ptr = record.format; *ptr; ptr++)
+    {
+        if (ptr[0] == '{' && ptr[1] == '}' && next_arg < record.arg_count)
+        {
+            const LogArg &arg = record.args[next_arg++];
+            switch (arg.type)
+            {
+            case LogArg::Int:
+                line << arg.i;
+                break;
+            case LogArg::UInt:
+                line << arg.u;
+                break;
+            case LogArg::Double:
+                line << arg.d;
+                break;
+            case LogArg::Bool:
+                line << (arg.u ? "true" : "false");
+                break;
+            case LogArg::Text:
+                line.write(record.text + arg.text_offset, arg.text_length);
+                break;
+            }
+            ptr++;
+            continue;
+        }
+        line << *ptr;
+    }
+    line << '\n';
+    output += line.str();
+}
+
+bool Logger::drain(std::string &output)
+{
+    bool drained = false;
+    size_t position = dequeue_position.load(std::memory_order_relaxed);
+    while (true)
+    {
+        Cell &cell = cells[position & (LOG_CAPACITY - 1)];
+        if (cell.sequence.load(std::memory_order_acquire) != position + 1)
+        {
+            break; // запись еще не готова
+        }
+
+        formatRecord(cell.record, output);
+        cell.sequence.store(position + LOG_CAPACITY, std::memory_order_release);
+        position++;
+        drained = true;
+    }
+    dequeue_position.store(position, std::memory_order_release);
+    return drained;
+}
+
+void Logger::run()
+{
+    std::string output;
+    uint64_t reported_dropped = 0;
+
+    while (true)
+    {
+        bool stopping = !running;
+        output.clear();
+        bool drained = drain(output);
+
+        uint64_t dropped_now = getDropped();
+        if (dropped_now != reported_dropped)
+        {
+            output += "Log buffer full, dropped " + std::to_string(dropped_now - reported_dropped) + " records\n";
+            reported_dropped = dropped_now;
+        }
+
+        if (!output.empty())
+        {
+            std::cout << output << std::flush; // один сброс на пачку записей
+        }
+        if (stopping)
+        {
+            break;
+        }
+        if (!drained)
+        {
+            std::this_thread::sleep_for(std::chrono::milliseconds(LOG_IDLE_MS));
+        }
+    }
+}
+
+void Logger::flush()
+{
+    size_t target = enqueue_position.load(std::memory_order_acquire);
+    while (running && dequeue_position.load(std::memory_order_acquire) < target)
+    {
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+}
@@ -0,0 +1,220 @@
+#ifndef _LOGGER_H_
+#define _LOGGER_H_
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <cstring>
+#include <memory>
+#include <string>
+#include <thread>
+#include <type_traits>
+
+// Асинхронный журнал для горячего пути.
+// Вызов LOG_* только копирует формат (строковый литерал) и аргументы в запись кольцевого
+// буфера без блокировок; подстановка аргументов и вывод в stdout идут в фоновом потоке,
+// который сбрасывает поток вывода один раз на пачку записей, а не на каждую строку.
+//
+// Формат - строковый литерал с подстановками "{}":
+//     LOG_INFO("Image sent ({} bytes, frame {})", payload_size, frame_id);
+// Аргументы: целые, числа с плавающей точкой, bool, строки (копируются, длинные обрезаются).
+//
+// Уровни отсекаются дважды: при компиляции (UTILS_LOG_COMPILE_LEVEL, вызовы ниже него
+// не попадают в код) и при работе (Logger::setLevel, по умолчанию info).
+// Если буфер заполнен, запись отбрасывается - горячий путь никогда не ждет вывода.
+
+enum class LogLevel : int
+{
+    Trace = 0,
+    Debug = 1,
+    Info = 2,
+    Warn = 3,
+    Error = 4,
+    Off = 5
+};
+
+#ifndef UTILS_LOG_COMPILE_LEVEL
+#define UTILS_LOG_COMPILE_LEVEL 0
+#endif
+
+static const size_t LOG_MAX_ARGS = 8;
+static const size_t LOG_TEXT_BYTES = 192; // место под строковые аргументы одной записи
+static const size_t LOG_CAPACITY = 4096; // записей в кольце, степень двойки
+
+struct LogArg
+{
+    enum Type : uint8_t
+    {
+        Int,
+        UInt,
+        Double,
+        Bool,
+        Text
+    };
+
+    Type type;
+    uint16_t text_offset;
+    uint16_t text_length;
+    union
+    {
+        int64_t i;
+        uint64_t u;
+        double d;
+    };
+};
+
+struct LogRecord
+{
+    std::chrono::system_clock::time_point time;
+    const char *format;
+    LogLevel level;
+    uint8_t arg_count;
+    uint16_t text_used;
+    LogArg args[LOG_MAX_ARGS];
+    char text[LOG_TEXT_BYTES];
+
+    template <typename T>
+    void add(const T &value)
+    {
+        if (arg_count == LOG_MAX_ARGS)
+        {
+            return;
+        }
+
+        LogArg &arg = args[arg_count++];
+        if constexpr (std::is_same_v<T, bool>)
+        {
+            arg.type = LogArg::Bool;
+            arg.u = value;
+        }
+        else if constexpr (std::is_integral_v<T> && std::is_signed_v<T>)
+        {
+            arg.type = LogArg::Int;
+            arg.i = value;
+        }
+        else if constexpr (std::is_integral_v<T>)
+        {
+            arg.type = LogArg::UInt;
+            arg.u = value;
+        }
+        else if constexpr (std::is_floating_point_v<T>)
+        {
+            arg.type = LogArg::Double;
+            arg.d = value;
+        }
+        else if constexpr (std::is_enum_v<T>)
+        {
+            arg.type = LogArg::Int;
+            arg.i = static_cast<int64_t>(value);
+        }
+        else if constexpr (std::is_convertible_v<const T &, const char *>)
+        {
+            addText(arg, value, std::strlen(value));
+        }
+        else
+        {
+            static_assert(std::is_same_v<T, std::string>, "unsupported log argument type");
+            addText(arg, value.data(), value.size());
+        }
+    }
+
+private:
+    void addText(LogArg &arg, const char *data, size_t length)
+    {
+        arg.type = LogArg::Text;
+        arg.text_offset = text_used;
+        arg.text_length = static_cast<uint16_t>(std::min(length, LOG_TEXT_BYTES - text_used));
+        std::memcpy(text + text_used, data, arg.text_length);
+        text_used += arg.text_length;
+    }
+};
+
+class Logger
+{
+public:
+    static Logger &instance();
+
+    void setLevel(LogLevel level);
+    LogLevel getLevel() const;
+    bool isEnabled(LogLevel level) const
+    {
+        return static_cast<int>(level) >= min_level.load(std::memory_order_relaxed);
+    }
+
+    // Уровень по имени: trace, debug, info, warn, error, off
+    static bool parseLevel(const std::string &name, LogLevel &level);
+
+    template <typename... Args>
+    void write(LogLevel level, const char *format, const Args &...args)
+    {
+        size_t position;
+        Cell *cell = claim(position);
+        if (!cell)
+        {
+            dropped.fetch_add(1, std::memory_order_relaxed);
+            return;
+        }
+
+        LogRecord &record = cell->record;
+        record.time = std::chrono::system_clock::now();
+        record.format = format;
+        record.level = level;
+        record.arg_count = 0;
+        record.text_used = 0;
+        (record.add(args), ...);
+
+        cell->sequence.store(position + 1, std::memory_order_release);
+    }
+
+    // Дождаться вывода всех записей, сделанных до вызова
+    void flush();
+
+    uint64_t getDropped() const { return dropped.load(std::memory_order_relaxed); }
+
+private:
+    // Ячейка кольца (очередь Вьюкова): номер последовательности говорит,
+    // свободна ли ячейка для записи или готова к чтению
+    struct Cell
+    {
+        std::atomic<size_t> sequence;
+        LogRecord record;
+    };
+
+    Logger();
+    ~Logger();
+    Logger(const Logger &) = delete;
+    Logger &operator=(const Logger &) = delete;
+
+    Cell *claim(size_t &position);
+    bool drain(std::string &output);
+    void run();
+
+    std::unique_ptr<Cell[]> cells;
+    alignas(64) std::atomic<size_t> enqueue_position;
+    alignas(64) std::atomic<size_t> dequeue_position; // меняет только фоновый поток
+    std::atomic<int> min_level;
+    std::atomic<uint64_t> dropped;
+    std::atomic<bool> running;
+    std::thread thread;
+};
+
+#define UTILS_LOG(level, ...)                                                   \
+    do                                                                          \
+    {                                                                           \
+        if constexpr (static_cast<int>(level) >= UTILS_LOG_COMPILE_LEVEL)       \
+        {                                                                       \
+            if (Logger::instance().isEnabled(level))                            \
+            {                                                                   \
+                Logger::instance().write(level, __VA_ARGS__);                   \
+            }                                                                   \
+        }                                                                       \
+    } while (0)
+
+#define LOG_TRACE(...) UTILS_LOG(LogLevel::Trace, __VA_ARGS__)
+#define LOG_DEBUG(...) UTILS_LOG(LogLevel::Debug, __VA_ARGS__)
+#define LOG_INFO(...) UTILS_LOG(LogLevel::Info, __VA_ARGS__)
+#define LOG_WARN(...) UTILS_LOG(LogLevel::Warn, __VA_ARGS__)
+#define LOG_ERROR(...) UTILS_LOG(LogLevel::Error, __VA_ARGS__)
+
+#endif // _LOGGER_H_
@@ -0,0 +1,246 @@
+#include <filesystem>
+#include <fstream>
+#include <sstream>
+#include <zmq.hpp>
+
+#include "metrics.h"
+#include "logger.h"
+
+// ============================================================================
+// ГИСТОГРАММА
+// ============================================================================
+
+// Номер старшего единичного бита
+static int highestBit(uint64_t value)
+{
+#if defined(__GNUC__) || defined(__clang__)
+    return 63 - __builtin_clzll(value);
+#else
+    int bit = 0;
+    while (value >>= 1)
+    {
+        bit++;
+    }
+    return bit;
+#endif
+}
+
+int LatencyHistogram::bucketIndex(uint64_t value)
+{
+    if (value < SUB_BUCKETS)
+    {
+        return static_cast<int>(value);
+    }
+
+    // Старший бит задает интервал, следующие 4 бита - часть внутри него
+    int exponent = highestBit(value);
+    int sub_bucket = static_cast<int>(value >> (exponent - 4)) - SUB_BUCKETS;
+    return SUB_BUCKETS + (exponent - 4) * SUB_BUCKETS + sub_bucket;
+}
+
+uint64_t LatencyHistogram::bucketValue(int index)
+{
+    if (index < SUB_BUCKETS)
+    {
+        return index;
+    }
+
+    int exponent = (index - SUB_BUCKETS) / SUB_BUCKETS + 4;
+    uint64_t sub_bucket = (index - SUB_BUCKETS) % SUB_BUCKETS;
+    uint64_t lower = (SUB_BUCKETS + sub_bucket) << (exponent - 4);
+    uint64_t width = uint64_t(1) << (exponent - 4);
+    return lower + width / 2; // середина интервала
+}
+
+void LatencyHistogram::record(uint64_t value)
+{
+    buckets[bucketIndex(value)].fetch_add(1, std::memory_order_relaxed);
+    count.fetch_add(1, std::memory_order_relaxed);
+    sum.fetch_add(value, std::memory_order_relaxed);
+
+    uint64_t previous = max.load(std::memory_order_relaxed);
+    while (value > previous && !max.compare_exchange_weak(previous, value, std::memory_order_relaxed))
+    {
+    }
+}
+
+uint64_t LatencyHistogram::percentile(double quantile) const
+{
+    uint64_t total = getCount();
+    if (total == 0)
+    {
+        return 0;
+    }
+
+    uint64_t rank = static_cast<uint64_t>(quantile * total);
+    uint64_t seen = 0;
+    for (int i = 0; i < BUCKET_COUNT; i++)
+    {
+        seen += buckets[i].load(std::memory_order_relaxed);
+        if (seen > rank)
+        {
+            return std::min(bucketValue(i), getMax());
+        }
+    }
+    return getMax();
+}
+
+// ============================================================================
+// РЕЕСТР
+// ============================================================================
+
+MetricsRegistry &MetricsRegistry::instance()
+{
+    static MetricsRegistry registry;
+    return registry;
+}
+
+template <typename Metric>
+static Metric &findOrCreate(std::map<std::string, std::unique_ptr<Metric>> &metrics, const std::string &name)
+{
+    std::unique_ptr<Metric> &metric = metrics[name];
+    if (!metric)
+    {
+        metric = std::make_unique<Metric>();
+    }
+    return *metric;
+}
+
+Counter &MetricsRegistry::counter(const std::string &name)
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    return findOrCreate(counters, name);
+}
+
+Gauge &MetricsRegistry::gauge(const std::string &name)
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    return findOrCreate(gauges, name);
+}
+
+LatencyHistogram &MetricsRegistry::histogram(const std::string &name)
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    return findOrCreate(histograms, name);
+}
+
+std::string MetricsRegistry::exportText(const std::string &stage)
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    std::ostringstream text;
+    std::string label = "{stage=\"" + stage + "\"}";
+
+    for (const auto &entry : counters)
+    {
+        text << "# TYPE " << entry.first << " counter\n";
+        text << entry.first << label << " " << entry.second->get() << "\n";
+    }
+    for (const auto &entry : gauges)
+    {
+        text << "# TYPE " << entry.first << " gauge\n";
+        text << entry.first << label << " " << entry.second->get() << "\n";
+    }
+    for (const auto &entry : histograms)
+    {
+        const LatencyHistogram &histogram = *entry.second;
+        text << "# TYPE " << entry.first << " summary\n";
+        for (const char *quantile : {"0.5", "0.9", "0.99", "0.999"})
+        {
+            text << entry.first << "{stage=\"" << stage << "\",quantile=\"" << quantile << "\"} "
+                 << histogram.percentile(std::stod(quantile)) << "\n";
+        }
+        text << entry.first << "_sum" << label << " " << histogram.getSum() << "\n";
+        text << entry.first << "_count" << label << " " << histogram.getCount() << "\n";
+        text << "# TYPE " << entry.first << "_max gauge\n";
+        text << entry.first << "_max" << label << " " << histogram.getMax() << "\n";
+    }
+    return text.str();
+}
+
+// ============================================================================
+// ПУБЛИКАЦИЯ
+// ============================================================================
+
+MetricsPublisher::MetricsPublisher(const std::string &stage, const std::string &address, const std::string &file,
+                                   int interval_ms)
+    : stage(stage), address(address), file(file), interval_ms(interval_ms), running(true)
+{
+    thread = std::thread(&MetricsPublisher::run, this);
+}
+
+MetricsPublisher::~MetricsPublisher()
+{
+    running = false;
+    if (thread.joinable())
+    {
+        thread.join();
+    }
+}
+
+void MetricsPublisher::run()
+{
+    // Свой контекст, как у канала управления: публикация не трогает сокеты кадров
+    zmq::context_t context(1);
+    std::unique_ptr<zmq::socket_t> socket;
+    if (!address.empty())
+    {
+        try
+        {
+            socket = std::make_unique<zmq::socket_t>(context, zmq::socket_type::pub);
+            socket->set(zmq::sockopt::linger, 0);
+            socket->set(zmq::sockopt::sndhwm, 4); // подписчик, который не успевает, теряет старые снимки
+            socket->bind(address);
+            LOG_INFO("Metrics published on: {}", address);
+        }
+        catch (const zmq::error_t &e)
+        {
+            LOG_ERROR("Metrics socket error: {}", e.what());
+            socket.reset();
+        }
+    }
+
+    std::string topic = "metrics." + stage;
+    auto next_publish = std::chrono::steady_clock::now();
+    while (running)
+    {
+        // Короткий сон, чтобы остановка не ждала целый интервал
+        std::this_thread::sleep_for(std::chrono::milliseconds(std::min(interval_ms, 100)));
+        if (std::chrono::steady_clock::now() < next_publish)
+        {
+            continue;
+        }
+        next_publish += std::chrono::milliseconds(interval_ms);
+
+        std::string text = MetricsRegistry::instance().exportText(stage);
+        if (socket)
+        {
+            socket->send(zmq::buffer(topic), zmq::send_flags::sndmore | zmq::send_flags::dontwait);
+            socket->send(zmq::buffer(text), zmq::send_flags::dontwait);
+        }
+        if (!file.empty())
+        {
+            writeFile(text);
+        }
+    }
+}
+
+void MetricsPublisher::writeFile(const std::string &text)
+{
+    std::string temporary = file + ".tmp";
+    {
+        std::ofstream output(temporary, std::ios::trunc);
+        if (!output)
+        {
+            LOG_ERROR("Cannot write metrics file: {}", temporary);
+            return;
+        }
+        output << text;
+    }
+
+    std::error_code error;
+    std::filesystem::rename(temporary, file, error);
+    if (error)
+    {
+        LOG_ERROR("Cannot replace metrics file {}: {}", file, error.message());
+    }
+}
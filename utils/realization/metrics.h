@@ -0,0 +1,129 @@
+#ifndef _METRICS_H_
+#define _METRICS_H_
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+
+// Метрики стадии: счетчики, значения и гистограммы задержек.
+// Обновление - одна атомарная операция без блокировок, поэтому метрики можно
+// трогать на каждом кадре. Ссылку на метрику стоит получить один раз:
+//     static Counter &sent = MetricsRegistry::instance().counter("utils_frames_sent_total");
+//     sent.add();
+// Снимок всех метрик периодически публикует MetricsPublisher (см. Utils::startMetrics).
+
+class Counter
+{
+public:
+    void add(uint64_t value = 1) { total.fetch_add(value, std::memory_order_relaxed); }
+    uint64_t get() const { return total.load(std::memory_order_relaxed); }
+
+private:
+    std::atomic<uint64_t> total{0};
+};
+
+class Gauge
+{
+public:
+    void set(int64_t value) { current.store(value, std::memory_order_relaxed); }
+    void add(int64_t value) { current.fetch_add(value, std::memory_order_relaxed); }
+    int64_t get() const { return current.load(std::memory_order_relaxed); }
+
+private:
+    std::atomic<int64_t> current{0};
+};
+
+// Гистограмма в духе HDR: логарифмические интервалы, каждый поделен на 16 частей,
+// поэтому погрешность процентилей не больше 1/16 значения при любом масштабе.
+// Значения - микросекунды.
+class LatencyHistogram
+{
+public:
+    static const int SUB_BUCKETS = 16;
+    static const int BUCKET_COUNT = SUB_BUCKETS + (64 - 4) * SUB_BUCKETS;
+
+    void record(uint64_t value);
+
+    uint64_t getCount() const { return count.load(std::memory_order_relaxed); }
+    uint64_t getSum() const { return sum.load(std::memory_order_relaxed); }
+    uint64_t getMax() const { return max.load(std::memory_order_relaxed); }
+
+    // Значение, не больше которого quantile (0..1) всех записанных
+    uint64_t percentile(double quantile) const;
+
+private:
+    static int bucketIndex(uint64_t value);
+    static uint64_t bucketValue(int index);
+
+    std::atomic<uint64_t> buckets[BUCKET_COUNT] = {};
+    std::atomic<uint64_t> count{0};
+    std::atomic<uint64_t> sum{0};
+    std::atomic<uint64_t> max{0};
+};
+
+// Замер времени блока в гистограмму
+class ScopedTimer
+{
+public:
+    explicit ScopedTimer(LatencyHistogram &histogram)
+        : histogram(histogram), started(std::chrono::steady_clock::now()) {}
+    ~ScopedTimer()
+    {
+        histogram.record(std::chrono::duration_cast<std::chrono::microseconds>(
+                             std::chrono::steady_clock::now() - started).count());
+    }
+
+private:
+    LatencyHistogram &histogram;
+    std::chrono::steady_clock::time_point started;
+};
+
+// Все метрики процесса по именам. Метрики не удаляются, ссылки действительны до выхода.
+class MetricsRegistry
+{
+public:
+    static MetricsRegistry &instance();
+
+    Counter &counter(const std::string &name);
+    Gauge &gauge(const std::string &name);
+    LatencyHistogram &histogram(const std::string &name);
+
+    // Снимок в текстовом формате Prometheus; гистограммы - как summary с процентилями
+    std::string exportText(const std::string &stage);
+
+private:
+    MetricsRegistry() = default;
+
+    std::mutex mutex;
+    std::map<std::string, std::unique_ptr<Counter>> counters;
+    std::map<std::string, std::unique_ptr<Gauge>> gauges;
+    std::map<std::string, std::unique_ptr<LatencyHistogram>> histograms;
+};
+
+// Периодическая публикация снимка метрик: сокет PUB (тема "metrics.<стадия>", затем текст)
+// и/или файл для textfile collector Prometheus. Файл подменяется целиком через переименование.
+class MetricsPublisher
+{
+public:
+    MetricsPublisher(const std::string &stage, const std::string &address, const std::string &file,
+                     int interval_ms);
+    ~MetricsPublisher();
+
+private:
+    void run();
+    void writeFile(const std::string &text);
+
+    std::string stage;
+    std::string address; // пусто - без сокета
+    std::string file;    // пусто - без файла
+    int interval_ms;
+    std::atomic<bool> running;
+    std::thread thread;
+};
+
+#endif // _METRICS_H_
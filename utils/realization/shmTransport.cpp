@@ -0,0 +1,605 @@
+#include <atomic>
+#include <chrono>
+#include <cstring>
+
+#include "shmTransport.h"
+#include "logger.h"
+
+#ifdef __linux__
+#include <cerrno>
+#include <climits>
+#include <fcntl.h>
+#include <linux/futex.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/syscall.h>
+#include <time.h>
+#include <unistd.h>
+#endif
+
+// ============================================================================
+// РАЗМЕТКА СЕГМЕНТА
+// ============================================================================
+
+static const uint32_t SHM_MAGIC = 0x524D4853; // "SHMR"
+static const uint32_t SHM_VERSION = 1;
+static const size_t SHM_LINE = 64; // строка кэша: счетчики писателя и читателя не делят строку
+
+enum SlotKind : uint32_t
+{
+    SLOT_MESSAGE = 1,
+    SLOT_IMAGE = 2
+};
+
+// Заголовок слота, за ним - данные
+struct SlotHeader
+{
+    uint32_t kind;
+    uint32_t reserved;
+    uint64_t size;
+    int32_t rows;
+    int32_t cols;
+    int32_t type;
+    uint32_t reserved2;
+    uint64_t step;
+    uint64_t frame_id;
+    uint8_t padding[16];
+};
+
+// Кольцо одного направления. head - сколько слотов опубликовано писателем,
+// tail - сколько слотов возвращено читателем; оба растут монотонно по модулю 2^32.
+struct ShmTransport::Ring
+{
+    alignas(SHM_LINE) std::atomic<uint32_t> head;
+    alignas(SHM_LINE) std::atomic<uint32_t> tail;
+    alignas(SHM_LINE) std::atomic<uint32_t> head_waiters; // ждут новых слотов
+    std::atomic<uint32_t> tail_waiters;                   // ждут свободных слотов
+};
+
+struct ShmTransport::Segment
+{
+    uint32_t magic;
+    uint32_t version;
+    uint32_t slot_count;
+    uint32_t reserved;
+    uint64_t slot_size;   // байт данных в слоте
+    uint64_t slot_stride; // заголовок + данные, кратно SHM_LINE
+    Ring to_client;
+    Ring to_server;
+    // далее slot_count слотов to_client, затем slot_count слотов to_server
+};
+
+static_assert(sizeof(SlotHeader) % SHM_LINE == 0, "slot header must keep data cache-aligned");
+static_assert(std::atomic<uint32_t>::is_always_lock_free, "shared counters must be lock-free");
+
+// ============================================================================
+// ОЖИДАНИЕ (futex в разделяемой памяти)
+// ============================================================================
+
+#ifdef __linux__
+
+static uint32_t *futexWord(std::atomic<uint32_t> &value)
+{
+    return reinterpret_cast<uint32_t *>(&value);
+}
+
+// Ждем, пока value != expected, не дольше timeout_ms (отрицательное - без ограничения)
+static void futexWait(std::atomic<uint32_t> &value, uint32_t expected, int timeout_ms)
+{
+    struct timespec timeout;
+    struct timespec *timeout_ptr = nullptr;
+    if (timeout_ms >= 0)
+    {
+        timeout.tv_sec = timeout_ms / 1000;
+        timeout.tv_nsec = (timeout_ms % 1000) * 1000000L;
+        timeout_ptr = &timeout;
+    }
+    // Без FUTEX_PRIVATE_FLAG: слово видят несколько процессов
+    syscall(SYS_futex, futexWord(value), FUTEX_WAIT, expected, timeout_ptr, nullptr, 0);
+}
+
+static void futexWakeAll(std::atomic<uint32_t> &value)
+{
+    syscall(SYS_futex, futexWord(value), FUTEX_WAKE, INT_MAX, nullptr, nullptr, 0);
+}
+
+// Ожидание, пока condition() не станет истинным; watched - счетчик, который меняет другая сторона
+template <typename Condition>
+static bool waitFor(std::atomic<uint32_t> &watched, std::atomic<uint32_t> &waiters,
+                    Condition condition, int timeout_ms)
+{
+    auto deadline = std::chrono::steady_clock::now() + std::chrono::milliseconds(timeout_ms);
+
+    while (true)
+    {
+        uint32_t observed = watched.load(std::memory_order_acquire);
+        if (condition())
+        {
+            return true;
+        }
+
+        int remaining = -1;
+        if (timeout_ms >= 0)
+        {
+            auto left = std::chrono::duration_cast<std::chrono::milliseconds>(deadline - std::chrono::steady_clock::now());
+            if (left.count() <= 0)
+            {
+                return false;
+            }
+            remaining = (int)left.count();
+        }
+
+        waiters.fetch_add(1, std::memory_order_acq_rel);
+        if (!condition())
+        {
+            futexWait(watched, observed, remaining);
+        }
+        waiters.fetch_sub(1, std::memory_order_acq_rel);
+    }
+}
+
+#endif
+
+// ============================================================================
+// АЛЛОКАТОР: матрица держит слот, пока жива
+// ============================================================================
+
+struct SlotReference
+{
+    std::shared_ptr<ShmTransport> transport;
+    uint32_t sequence;
+};
+
+class SlotAllocator : public cv::MatAllocator
+{
+public:
+    cv::UMatData *allocate(int dims, const int *sizes, int type, void *data, size_t *step,
+                           cv::AccessFlag flags, cv::UMatUsageFlags usageFlags) const override
+    {
+        return cv::Mat::getStdAllocator()->allocate(dims, sizes, type, data, step, flags, usageFlags);
+    }
+
+    bool allocate(cv::UMatData *data, cv::AccessFlag accessFlags, cv::UMatUsageFlags usageFlags) const override
+    {
+        return cv::Mat::getStdAllocator()->allocate(data, accessFlags, usageFlags);
+    }
+
+    void deallocate(cv::UMatData *u) const override
+    {
+        if (!u)
+        {
+            return;
+        }
+        SlotReference *reference = static_cast<SlotReference *>(u->userdata);
+        reference->transport->releaseSlot(reference->sequence);
+        delete reference;
+        delete u;
+    }
+};
+
+static SlotAllocator &slotAllocator()
+{
+    static SlotAllocator instance;
+    return instance;
+}
+
+// ============================================================================
+// ОТКРЫТИЕ СЕГМЕНТА
+// ============================================================================
+
+ShmTransport::ShmTransport()
+    : is_server(false), mapping(nullptr), mapping_size(0), device(0), inode(0), segment(nullptr),
+      tx(nullptr), rx(nullptr), read_position(0)
+{
+}
+
+// Разбор "name?slots=4&slot_mb=8"
+static void parseEndpoint(const std::string &endpoint, std::string &name, uint32_t &slots, uint64_t &slot_size)
+{
+    size_t query = endpoint.find('?');
+    name = "/" + endpoint.substr(0, query);
+
+    while (query != std::string::npos)
+    {
+        size_t start = query + 1;
+        query = endpoint.find('&', start);
+        std::string option = endpoint.substr(start, query == std::string::npos ? std::string::npos : query - start);
+
+        size_t eq = option.find('=');
+        if (eq == std::string::npos)
+        {
+            continue;
+        }
+        std::string key = option.substr(0, eq);
+        unsigned long value = std::strtoul(option.c_str() + eq + 1, nullptr, 10);
+
+        if (key == "slots" && value >= 2)
+        {
+            slots = (uint32_t)value;
+        }
+        else if (key == "slot_mb" && value >= 1)
+        {
+            slot_size = (uint64_t)value << 20;
+        }
+    }
+}
+
+std::shared_ptr<ShmTransport> ShmTransport::open(const std::string &endpoint, bool is_server)
+{
+#ifdef __linux__
+    std::string name;
+    uint32_t slots = 4;
+    uint64_t slot_size = 8ull << 20;
+    parseEndpoint(endpoint, name, slots, slot_size);
+
+    std::shared_ptr<ShmTransport> transport(new ShmTransport());
+    transport->name = name;
+    transport->is_server = is_server;
+
+    int fd = -1;
+    if (is_server)
+    {
+        // Сегмент от прошлого запуска мог остаться после аварийного завершения
+        shm_unlink(name.c_str());
+        fd = shm_open(name.c_str(), O_CREAT | O_EXCL | O_RDWR, 0600);
+    }
+    else
+    {
+        fd = shm_open(name.c_str(), O_RDWR, 0600);
+    }
+    if (fd < 0)
+    {
+        LOG_ERROR("Shared memory open error ({}): {}", name, strerror(errno));
+        return nullptr;
+    }
+
+    uint64_t slot_stride = 0;
+    if (is_server)
+    {
+        slot_stride = (sizeof(SlotHeader) + slot_size + SHM_LINE - 1) / SHM_LINE * SHM_LINE;
+        transport->mapping_size = sizeof(Segment) + 2 * slots * slot_stride;
+        if (ftruncate(fd, transport->mapping_size) != 0)
+        {
+            LOG_ERROR("Shared memory resize error: {}", strerror(errno));
+            close(fd);
+            shm_unlink(name.c_str());
+            return nullptr;
+        }
+    }
+    else
+    {
+        struct stat info;
+        if (fstat(fd, &info) != 0 || (size_t)info.st_size < sizeof(Segment))
+        {
+            LOG_WARN("Shared memory segment not ready: {}", name);
+            close(fd);
+            return nullptr;
+        }
+        transport->mapping_size = info.st_size;
+    }
+
+    struct stat identity;
+    if (fstat(fd, &identity) == 0)
+    {
+        transport->device = (uint64_t)identity.st_dev;
+        transport->inode = (uint64_t)identity.st_ino;
+    }
+
+    transport->mapping = mmap(nullptr, transport->mapping_size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    close(fd);
+    if (transport->mapping == MAP_FAILED)
+    {
+        LOG_ERROR("Shared memory map error: {}", strerror(errno));
+        transport->mapping = nullptr;
+        if (is_server)
+        {
+            shm_unlink(name.c_str());
+        }
+        return nullptr;
+    }
+
+    Segment *segment = static_cast<Segment *>(transport->mapping);
+    transport->segment = segment;
+
+    if (is_server)
+    {
+        // Новый сегмент заполнен нулями; magic пишем последним - признак готовности
+        segment->version = SHM_VERSION;
+        segment->slot_count = slots;
+        segment->slot_size = slot_size;
+        segment->slot_stride = slot_stride;
+        std::atomic_thread_fence(std::memory_order_release);
+        segment->magic = SHM_MAGIC;
+    }
+    else
+    {
+        std::atomic_thread_fence(std::memory_order_acquire);
+        if (segment->magic != SHM_MAGIC || segment->version != SHM_VERSION ||
+            transport->mapping_size < sizeof(Segment) + 2 * segment->slot_count * segment->slot_stride)
+        {
+            LOG_ERROR("Shared memory segment has unexpected layout: {}", name);
+            return nullptr;
+        }
+    }
+
+    transport->tx = is_server ? &segment->to_client : &segment->to_server;
+    transport->rx = is_server ? &segment->to_server : &segment->to_client;
+    transport->read_position = transport->rx->tail.load(std::memory_order_acquire);
+    transport->released.assign(segment->slot_count, false);
+    return transport;
+#else
+    LOG_ERROR("Shared memory transport is supported only on Linux: {}", endpoint);
+    (void)is_server;
+    return nullptr;
+#endif
+}
+
+ShmTransport::~ShmTransport()
+{
+#ifdef __linux__
+    if (mapping)
+    {
+        munmap(mapping, mapping_size);
+    }
+    // Кадры могут держать транспорт дольше, чем живет соединение: если под этим именем
+    // уже создан новый сегмент, удалять его нельзя
+    if (is_server && !isStale())
+    {
+        shm_unlink(name.c_str());
+    }
+#endif
+}
+
+size_t ShmTransport::getSlotSize() const
+{
+    return segment->slot_size;
+}
+
+bool ShmTransport::isStale() const
+{
+#ifdef __linux__
+    int fd = shm_open(name.c_str(), O_RDONLY, 0);
+    if (fd < 0)
+    {
+        return true;
+    }
+    struct stat info;
+    bool same = fstat(fd, &info) == 0 && (uint64_t)info.st_dev == device && (uint64_t)info.st_ino == inode;
+    close(fd);
+    return !same;
+#else
+    return false;
+#endif
+}
+
+uint8_t *ShmTransport::slotData(Ring *ring, uint32_t sequence)
+{
+    uint8_t *slots = static_cast<uint8_t *>(mapping) + sizeof(Segment);
+    if (ring == &segment->to_server)
+    {
+        slots += segment->slot_count * segment->slot_stride;
+    }
+    return slots + (sequence % segment->slot_count) * segment->slot_stride;
+}
+
+// ============================================================================
+// КОЛЬЦО
+// ============================================================================
+
+bool ShmTransport::acquireWriteSlot(uint32_t &sequence, int timeout_ms)
+{
+#ifdef __linux__
+    sequence = tx->head.load(std::memory_order_relaxed); // пишет только этот процесс
+    uint32_t slot_count = segment->slot_count;
+    return waitFor(tx->tail, tx->tail_waiters,
+                   [&]() { return sequence - tx->tail.load(std::memory_order_acquire) < slot_count; },
+                   timeout_ms);
+#else
+    (void)sequence;
+    (void)timeout_ms;
+    return false;
+#endif
+}
+
+void ShmTransport::publish(uint32_t sequence)
+{
+#ifdef __linux__
+    tx->head.store(sequence + 1, std::memory_order_release);
+    if (tx->head_waiters.load(std::memory_order_acquire) > 0)
+    {
+        futexWakeAll(tx->head);
+    }
+#else
+    (void)sequence;
+#endif
+}
+
+bool ShmTransport::acquireReadSlot(uint32_t &sequence, int timeout_ms)
+{
+#ifdef __linux__
+    sequence = read_position;
+    return waitFor(rx->head, rx->head_waiters,
+                   [&]() { return rx->head.load(std::memory_order_acquire) != sequence; },
+                   timeout_ms);
+#else
+    (void)sequence;
+    (void)timeout_ms;
+    return false;
+#endif
+}
+
+void ShmTransport::advanceReadPosition(uint32_t sequence)
+{
+    // releaseSlot вызывается и из других потоков (кадр отпускается при уничтожении Mat)
+    // и сравнивает tail с позицией чтения под тем же мьютексом
+    std::lock_guard<std::mutex> lock(release_mutex);
+    read_position = sequence + 1;
+}
+
+void ShmTransport::releaseSlot(uint32_t sequence)
+{
+#ifdef __linux__
+    std::lock_guard<std::mutex> lock(release_mutex);
+
+    // Слоты могут отпускаться не по порядку: tail двигаем по непрерывной серии
+    released[sequence % segment->slot_count] = true;
+
+    uint32_t tail = rx->tail.load(std::memory_order_relaxed);
+    bool moved = false;
+    while (tail != read_position && released[tail % segment->slot_count])
+    {
+        released[tail % segment->slot_count] = false;
+        tail++;
+        moved = true;
+    }
+
+    if (moved)
+    {
+        rx->tail.store(tail, std::memory_order_release);
+        if (rx->tail_waiters.load(std::memory_order_acquire) > 0)
+        {
+            futexWakeAll(rx->tail);
+        }
+    }
+#else
+    (void)sequence;
+#endif
+}
+
+// ============================================================================
+// СООБЩЕНИЯ И ИЗОБРАЖЕНИЯ
+// ============================================================================
+
+bool ShmTransport::sendMessage(const std::string &message, int timeout_ms)
+{
+    if (message.size() > segment->slot_size)
+    {
+        return false;
+    }
+
+    uint32_t sequence;
+    if (!acquireWriteSlot(sequence, timeout_ms))
+    {
+        return false;
+    }
+
+    uint8_t *slot = slotData(tx, sequence);
+    SlotHeader header;
+    memset(&header, 0, sizeof(header));
+    header.kind = SLOT_MESSAGE;
+    header.size = message.size();
+    memcpy(slot, &header, sizeof(header));
+    memcpy(slot + sizeof(SlotHeader), message.data(), message.size());
+
+    publish(sequence);
+    return true;
+}
+
+bool ShmTransport::receiveMessage(std::string &message, int timeout_ms)
+{
+    uint32_t sequence;
+    if (!acquireReadSlot(sequence, timeout_ms))
+    {
+        return false;
+    }
+    advanceReadPosition(sequence);
+
+    const uint8_t *slot = slotData(rx, sequence);
+    SlotHeader header;
+    memcpy(&header, slot, sizeof(header));
+
+    bool ok = header.kind == SLOT_MESSAGE && header.size <= segment->slot_size;
+    if (ok)
+    {
+        message.assign(reinterpret_cast<const char *>(slot + sizeof(SlotHeader)), header.size);
+    }
+
+    releaseSlot(sequence);
+    return ok;
+}
+
+bool ShmTransport::sendImage(const cv::Mat &image, uint64_t frame_id, int timeout_ms)
+{
+    size_t row_bytes = image.cols * image.elemSize();
+    size_t size = row_bytes * image.rows;
+    if (image.empty() || size > segment->slot_size)
+    {
+        LOG_ERROR("Image does not fit shared memory slot ({} > {} bytes)", size, segment->slot_size);
+        return false;
+    }
+
+    uint32_t sequence;
+    if (!acquireWriteSlot(sequence, timeout_ms))
+    {
+        return false;
+    }
+
+    uint8_t *slot = slotData(tx, sequence);
+    SlotHeader header;
+    memset(&header, 0, sizeof(header));
+    header.kind = SLOT_IMAGE;
+    header.size = size;
+    header.rows = image.rows;
+    header.cols = image.cols;
+    header.type = image.type();
+    header.step = row_bytes;
+    header.frame_id = frame_id;
+    memcpy(slot, &header, sizeof(header));
+
+    // Единственное копирование: пиксели сразу в слот, минуя буферы сокетов
+    uint8_t *data = slot + sizeof(SlotHeader);
+    if (image.isContinuous())
+    {
+        memcpy(data, image.data, size);
+    }
+    else
+    {
+        for (int i = 0; i < image.rows; i++)
+        {
+            memcpy(data + i * row_bytes, image.ptr(i), row_bytes);
+        }
+    }
+
+    publish(sequence);
+    return true;
+}
+
+cv::Mat ShmTransport::receiveImage(uint64_t &frame_id, int timeout_ms)
+{
+    uint32_t sequence;
+    if (!acquireReadSlot(sequence, timeout_ms))
+    {
+        return cv::Mat();
+    }
+    advanceReadPosition(sequence);
+
+    uint8_t *slot = slotData(rx, sequence);
+    SlotHeader header;
+    memcpy(&header, slot, sizeof(header));
+
+    bool ok = header.kind == SLOT_IMAGE && header.rows > 0 && header.cols > 0 &&
+              CV_MAT_TYPE(header.type) == header.type &&
+              header.step >= (uint64_t)header.cols * CV_ELEM_SIZE(header.type) &&
+              header.size <= segment->slot_size && header.step * header.rows <= header.size;
+    if (!ok)
+    {
+        releaseSlot(sequence);
+        return cv::Mat();
+    }
+
+    // Матрица - вид на слот; слот вернется писателю в SlotAllocator::deallocate
+    uint8_t *data = slot + sizeof(SlotHeader);
+    cv::Mat view(header.rows, header.cols, header.type, data, header.step);
+
+    cv::UMatData *u = new cv::UMatData(&slotAllocator());
+    u->data = u->origdata = data;
+    u->size = header.size;
+    u->userdata = new SlotReference{shared_from_this(), sequence};
+    u->refcount = 1;
+
+    view.u = u;
+    view.allocator = &slotAllocator();
+
+    frame_id = header.frame_id;
+    return view;
+}
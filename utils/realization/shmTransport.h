@@ -0,0 +1,77 @@
+#ifndef _SHM_TRANSPORT_H_
+#define _SHM_TRANSPORT_H_
+
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+#include <opencv2/core.hpp>
+
+// Транспорт через разделяемую память для стадий на одной машине (только Linux).
+// Адрес: shm://<имя>[?slots=<N>&slot_mb=<M>], по умолчанию 4 слота по 8 МБ.
+//
+// Сервер создает сегмент POSIX shm с двумя кольцами слотов фиксированного размера:
+// сервер -> клиент и клиент -> сервер. В каждом кольце один писатель и один читатель,
+// индексы - атомарные счетчики без блокировок, ожидание - futex в том же сегменте.
+// Между процессами передаются только индексы слотов: принятое изображение - это вид
+// на слот, и слот возвращается писателю, когда отпущена последняя ссылка на матрицу.
+class ShmTransport : public std::enable_shared_from_this<ShmTransport>
+{
+public:
+    // endpoint без префикса shm://. nullptr - сегмент не создан или не найден.
+    static std::shared_ptr<ShmTransport> open(const std::string &endpoint, bool is_server);
+
+    ~ShmTransport();
+
+    bool sendMessage(const std::string &message, int timeout_ms);
+    bool receiveMessage(std::string &message, int timeout_ms);
+
+    bool sendImage(const cv::Mat &image, uint64_t frame_id, int timeout_ms);
+    cv::Mat receiveImage(uint64_t &frame_id, int timeout_ms);
+
+    // Максимальный размер данных одного слота
+    size_t getSlotSize() const;
+
+    // Имя сегмента указывает уже на другой объект (сервер перезапущен и создал сегмент заново)
+    // или сегмент удален - отображение устарело, нужно открыть заново
+    bool isStale() const;
+
+    // Вызывается аллокатором матрицы: слот прочитан и может быть перезаписан
+    void releaseSlot(uint32_t sequence);
+
+    struct Ring;
+    struct Segment;
+
+private:
+    ShmTransport();
+
+    std::string name;
+    bool is_server;
+
+    void *mapping;
+    size_t mapping_size;
+    uint64_t device; // объект POSIX shm, который отображен (st_dev, st_ino)
+    uint64_t inode;
+    Segment *segment;
+
+    Ring *tx; // кольцо, в которое пишем
+    Ring *rx; // кольцо, из которого читаем
+
+    // Позиция чтения и слоты, отпущенные не по порядку (только сторона читателя).
+    // Меняются под release_mutex: слоты отпускаются из любого потока
+    uint32_t read_position;
+    std::vector<bool> released;
+    std::mutex release_mutex;
+
+    uint8_t *slotData(Ring *ring, uint32_t sequence);
+
+    // Ожидание свободного слота / нового слота
+    bool acquireWriteSlot(uint32_t &sequence, int timeout_ms);
+    bool acquireReadSlot(uint32_t &sequence, int timeout_ms);
+    void advanceReadPosition(uint32_t sequence); // слот sequence выдан читателю
+    void publish(uint32_t sequence);
+};
+
+#endif // _SHM_TRANSPORT_H_
@@ -1,7 +1,15 @@
 #include <iostream>
 #include <fstream>
 #include <vector>
-#include <yaml-cpp/yaml.h>
+#include <cstdint>
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <deque>
+#include <map>
+#include <mutex>
+#include <sstream>
+#include <unordered_map>
 
 // ZeroMQ
 #include <zmq.hpp>
@@ -13,6 +21,66 @@
 #include <opencv2/imgcodecs.hpp>
 
 #include "utils.h"
+#include "codecs.h"
+#include "controlChannel.h"
+#include "framePool.h"
+#include "frameWire.h"
+#include "logger.h"
+#include "metrics.h"
+#include "shmTransport.h"
+#include "zeroCopy.h"
+
+// Таймаут приема/отправки для всех транспортов
+static const int IO_TIMEOUT_MS = 10000;
+
+static const std::string SHM_PREFIX = "shm://";
+
+// Кадров в пути по умолчанию для асинхронного клиента
+static const size_t DEFAULT_ASYNC_WINDOW = 4;
+
+// Пауза перед переподключением: от первой попытки до предельной при долгом отсутствии собеседника
+static const int RECONNECT_MIN_MS = 100;
+static const int RECONNECT_MAX_MS = 5000;
+
+// ZMQ_HEARTBEAT_TTL передается в PING с точностью 100 мс и не больше этого значения
+static const int HEARTBEAT_TTL_MAX_MS = 6553500;
+
+// События сокета -> число собеседников. Очередь событий разбирается в потоке,
+// который владеет сокетом, при запросе состояния соединения.
+class LinkMonitor : public zmq::monitor_t
+{
+public:
+    int peers = 0;
+    uint64_t disconnects = 0;
+
+    void on_event_connected(const zmq_event_t &, const char *address) override
+    {
+        peers++;
+        LOG_INFO("Peer connected: {}", address);
+    }
+
+    void on_event_accepted(const zmq_event_t &, const char *address) override
+    {
+        peers++;
+        LOG_DEBUG("Peer accepted on: {}", address);
+    }
+
+    void on_event_disconnected(const zmq_event_t &, const char *address) override
+    {
+        static Counter &lost = MetricsRegistry::instance().counter("utils_disconnects_total");
+        peers = std::max(peers - 1, 0);
+        disconnects++;
+        lost.add();
+        LOG_WARN("Peer lost: {}", address);
+    }
+
+    void drain()
+    {
+        while (check_event(0))
+        {
+        }
+    }
+};
 
 // PImpl структура
 struct Utils::Impl
@@ -20,311 +88,1319 @@ struct Utils::Impl
     // ZeroMQ
     std::unique_ptr<zmq::context_t> context;
     std::unique_ptr<zmq::socket_t> socket;
+    std::unique_ptr<LinkMonitor> monitor; // объявлен после socket - отключается раньше, чем сокет закрыт
+    std::string endpoint; // адрес socket; повторная инициализация с тем же адресом сокет не пересоздает
+    std::shared_ptr<ShmTransport> shm; // вместо socket для адресов shm://
     bool connected;
     bool is_server;
     std::string client_id; // для ROUTER сервера
 
-    // Конфигурация
-    YAML::Node config;
+    // Номера кадров
+    uint64_t next_frame_id;
+    uint64_t last_frame_id;
+    bool last_frame_numbered; // false - последний кадр пришел в старом формате без номера
+    FrameTrace last_trace;
+
+    // Кодек исходящих кадров
+    const ImageCodec *codec;
+
+    // Асинхронный режим (DEALER/ROUTER): кадры идут без READY/DONE, ответ находится по номеру кадра
+    bool async_mode;
+    size_t window; // клиент: максимум кадров без ответа
+    struct ReplyRoute
+    {
+        std::string client; // routing id клиента
+        std::chrono::steady_clock::time_point received;
+    };
+    std::unordered_map<uint64_t, std::chrono::steady_clock::time_point> in_flight; // клиент: отправленные кадры без ответа
+    std::unordered_map<uint64_t, ReplyRoute> reply_routes; // сервер: номер кадра -> клиент, ждущий ответ
+
+    // Пакетная передача: до batch_frames кадров или batch_ms миллисекунд в одном сообщении
+    size_t batch_frames; // 1 - пакеты выключены
+    int batch_ms;
+    std::vector<zmq::message_t> batch_headers; // накопленные заголовки кадров
+    std::vector<zmq::message_t> batch_payloads;
+    uint64_t batch_last_id;
+    std::chrono::steady_clock::time_point batch_started;
+    std::deque<std::pair<cv::Mat, uint64_t>> received_batch; // принятые, но еще не выданные кадры пакета
+
+    // Конфигурация: неизменяемый снимок, подменяется целиком при перезагрузке.
+    // Читатели сверяют snapshot_version со снимком в кэше своего потока (cachedSnapshot)
+    // и берут snapshot_mutex, только когда снимок сменился
+    const uint64_t instance_id; // отличает кэши разных объектов Utils в одном потоке
+    std::shared_ptr<const ConfigSnapshot> snapshot;
+    std::mutex snapshot_mutex;
+    std::atomic<uint64_t> snapshot_version;
+    std::string config_path;
+    std::unique_ptr<ConfigWatcher> watcher;
+    std::mutex update_mutex; // перезагрузка файла и команды управления строят снимки по очереди
+    std::map<std::string, std::string> overrides; // значения из канала управления, переживают перезагрузку
+    std::unique_ptr<ControlChannel> control;
+    std::unique_ptr<MetricsPublisher> metrics;
 
     // Изображение
     cv::Mat current_image;
 
-    Impl() : connected(false), is_server(false)
+    Impl() : connected(false), is_server(false), next_frame_id(0), last_frame_id(0), last_frame_numbered(false),
+             codec(CodecRegistry::instance().find(CodecId::Raw)), async_mode(false), window(DEFAULT_ASYNC_WINDOW),
+             batch_frames(1), batch_ms(0), batch_last_id(0),
+             instance_id(nextInstanceId()), snapshot(std::make_shared<ConfigSnapshot>()), snapshot_version(0)
+    {
+        try
+        {
+            context = std::make_unique<zmq::context_t>(1);
+        }
+        catch (const zmq::error_t &e)
+        {
+            LOG_ERROR("ZeroMQ initialization error: {}", e.what());
+        }
+    }
+
+    static uint64_t nextInstanceId()
+    {
+        static std::atomic<uint64_t> next_id(1);
+        return next_id.fetch_add(1, std::memory_order_relaxed);
+    }
+
+    // Последний опубликованный снимок (медленный путь)
+    std::shared_ptr<const ConfigSnapshot> currentSnapshot()
+    {
+        std::lock_guard<std::mutex> lock(snapshot_mutex);
+        return snapshot;
+    }
+
+    // Снимок из кэша потока; пока версия не сменилась, мьютекс не берется
+    std::shared_ptr<const ConfigSnapshot> cachedSnapshot()
+    {
+        struct Cache
+        {
+            uint64_t instance_id = 0;
+            uint64_t version = 0;
+            std::shared_ptr<const ConfigSnapshot> snapshot;
+        };
+        thread_local Cache cache;
+
+        if (cache.instance_id != instance_id || cache.version != snapshot_version.load(std::memory_order_acquire))
+        {
+            cache.snapshot = currentSnapshot();
+            cache.instance_id = instance_id;
+            cache.version = cache.snapshot->version;
+        }
+        return cache.snapshot;
+    }
+
+    // Записи старше IO_TIMEOUT_MS: ответ потерян (обрыв, перезапуск собеседника) и уже не придет.
+    // Без этого каждый потерянный ответ навсегда занимал бы место в окне клиента
+    void expireAsync()
+    {
+        static Counter &lost_replies = MetricsRegistry::instance().counter("utils_async_lost_total");
+        static Counter &expired_routes = MetricsRegistry::instance().counter("utils_async_expired_routes_total");
+
+        auto deadline = std::chrono::steady_clock::now() - std::chrono::milliseconds(IO_TIMEOUT_MS);
+        size_t lost = 0;
+        for (auto it = in_flight.begin(); it != in_flight.end();)
+        {
+            if (it->second < deadline)
+            {
+                it = in_flight.erase(it);
+                lost++;
+            }
+            else
+            {
+                ++it;
+            }
+        }
+        size_t expired = 0;
+        for (auto it = reply_routes.begin(); it != reply_routes.end();)
+        {
+            if (it->second.received < deadline)
+            {
+                it = reply_routes.erase(it);
+                expired++;
+            }
+            else
+            {
+                ++it;
+            }
+        }
+
+        if (lost > 0)
+        {
+            lost_replies.add(lost);
+            LOG_WARN("{} async frames without reply for {} ms, counted as lost", lost, IO_TIMEOUT_MS);
+        }
+        if (expired > 0)
+        {
+            expired_routes.add(expired);
+            LOG_WARN("{} received async frames not answered in {} ms, routes dropped", expired, IO_TIMEOUT_MS);
+        }
+    }
+
+    // Монитор отключается до закрытия сокета
+    void closeSocket()
+    {
+        monitor.reset();
+        socket.reset();
+        endpoint.clear();
+        connected = false;
+    }
+
+    // Чтение файла в новый снимок; при ошибке остается прежний
+    bool loadSnapshot(const std::string &path)
+    {
+        std::shared_ptr<ConfigSnapshot> loaded = parseConfigSnapshot(path);
+        if (!loaded)
+        {
+            return false;
+        }
+
+        std::lock_guard<std::mutex> lock(update_mutex);
+        for (const auto &override_value : overrides)
+        {
+            std::string error;
+            applyLiveSetting(*loaded, override_value.first, override_value.second, error);
+        }
+        LogLevel level;
+        if (Logger::parseLevel(loaded->logging.level, level))
+        {
+            Logger::instance().setLevel(level);
+        }
+        FramePool::instance().setCapacity((size_t)loaded->frame_pool.max_cached_mb << 20);
+        if (!FramePool::instance().setDefaultForOpenCV(loaded->frame_pool.opencv_default))
+        {
+            LOG_WARN("frame_pool.opencv_default is applied at startup only, restart to change it");
+        }
+        publish(std::move(loaded));
+        LOG_INFO("Configuration loaded from: {}", path);
+        return true;
+    }
+
+    // Новый снимок с одним измененным параметром; прежний остается у тех, кто его уже взял
+    bool setLive(const std::string &key, const std::string &value, std::string &error)
+    {
+        std::lock_guard<std::mutex> lock(update_mutex);
+        auto updated = std::make_shared<ConfigSnapshot>(*currentSnapshot());
+        if (!applyLiveSetting(*updated, key, value, error))
+        {
+            return false;
+        }
+        overrides[key] = updated->values[key];
+        publish(std::move(updated));
+        return true;
+    }
+
+    // Мьютекс update_mutex уже захвачен
+    void publish(std::shared_ptr<ConfigSnapshot> updated)
+    {
+        std::lock_guard<std::mutex> lock(snapshot_mutex);
+        updated->version = snapshot->version + 1;
+        snapshot_version.store(updated->version, std::memory_order_release);
+        snapshot = std::move(updated);
+    }
+
+    std::string handleControl(const std::string &command)
+    {
+        std::istringstream input(command);
+        std::string verb, key, value;
+        input >> verb >> key >> value;
+
+        if (verb == "SET" && !key.empty() && !value.empty())
+        {
+            std::string error;
+            if (!setLive(key, value, error))
+            {
+                return "ERROR " + error;
+            }
+            return "OK " + key + "=" + value;
+        }
+        if (verb == "GET" && !key.empty())
+        {
+            std::shared_ptr<const ConfigSnapshot> current = currentSnapshot();
+            auto found = current->values.find(key);
+            return found == current->values.end() ? "ERROR unknown key " + key : "OK " + found->second;
+        }
+        if (verb == "LIST")
+        {
+            std::shared_ptr<const ConfigSnapshot> current = currentSnapshot();
+            std::string reply = "OK";
+            for (const std::string &live_key : liveSettingKeys())
+            {
+                auto found = current->values.find(live_key);
+                reply += "\n" + live_key + "=" + (found == current->values.end() ? "" : found->second);
+            }
+            return reply;
+        }
+        if (verb == "RESET")
+        {
+            {
+                std::lock_guard<std::mutex> lock(update_mutex);
+                overrides.clear();
+            }
+            if (config_path.empty() || !loadSnapshot(config_path))
+            {
+                return "ERROR config file is not loaded";
+            }
+            return "OK";
+        }
+        return "ERROR unknown command, expected SET <key> <value>, GET <key>, LIST or RESET";
+    }
+};
+
+Utils::Utils() : pImpl(std::make_unique<Impl>()) {}
+
+Utils::~Utils()
+{
+    pImpl->control.reset(); // потоки управления и слежения обращаются к pImpl
+    pImpl->watcher.reset();
+    pImpl->metrics.reset();
+    // Монитор держит свой PAIR-сокет в том же контексте: без его закрытия zmq_ctx_term ждет вечно.
+    // closeSocket отключает монитор раньше, чем закрывается наблюдаемый сокет
+    pImpl->closeSocket();
+    if (pImpl->context)
+    {
+        pImpl->context->close();
+    }
+}
+
+// ============================================================================
+// КОНФИГУРАЦИЯ
+// ============================================================================
+
+void Utils::loadConfig(const std::string &config_path)
+{
+    if (pImpl->loadSnapshot(config_path))
+    {
+        pImpl->config_path = config_path;
+    }
+}
+
+bool Utils::reloadConfig()
+{
+    if (pImpl->config_path.empty())
+    {
+        LOG_WARN("Config was not loaded yet");
+        return false;
+    }
+    return pImpl->loadSnapshot(pImpl->config_path);
+}
+
+bool Utils::watchConfig()
+{
+    if (pImpl->config_path.empty())
+    {
+        LOG_WARN("Config was not loaded yet");
+        return false;
+    }
+
+    Impl *impl = pImpl.get();
+    std::string path = impl->config_path;
+    pImpl->watcher = std::make_unique<ConfigWatcher>(path, [impl, path]() { impl->loadSnapshot(path); });
+    return pImpl->watcher->isWatching();
+}
+
+bool Utils::startControl(int port, const std::string &ip)
+{
+    if (port <= 0)
+    {
+        return false;
+    }
+
+    Impl *impl = pImpl.get();
+    pImpl->control = std::make_unique<ControlChannel>(ip, port, [impl](const std::string &command)
+                                                      { return impl->handleControl(command); });
+    return true;
+}
+
+bool Utils::startMetrics(const std::string &stage, int port, const std::string &file, const std::string &ip)
+{
+    if (port <= 0 && file.empty())
+    {
+        return false;
+    }
+
+    std::string address = port > 0 ? "tcp://" + ip + ":" + std::to_string(port) : "";
+    int interval_ms = getConfigSnapshot()->metrics.interval_ms;
+    pImpl->metrics = std::make_unique<MetricsPublisher>(stage, address, file, interval_ms);
+    return true;
+}
+
+bool Utils::setLiveSetting(const std::string &key, const std::string &value)
+{
+    std::string error;
+    if (!pImpl->setLive(key, value, error))
+    {
+        LOG_WARN("Error setting {}: {}", key, error);
+        return false;
+    }
+    return true;
+}
+
+std::shared_ptr<const ConfigSnapshot> Utils::getConfigSnapshot()
+{
+    return pImpl->cachedSnapshot();
+}
+
+std::string Utils::getConfig(const std::string &node_path)
+{
+    std::shared_ptr<const ConfigSnapshot> snapshot = getConfigSnapshot();
+    auto value = snapshot->values.find(node_path);
+    if (value == snapshot->values.end())
+    {
+        LOG_WARN("Error getting config '{}': not found", node_path);
+        return "";
+    }
+    return value->second;
+}
+
+// ============================================================================
+// РАБОТА С ИЗОБРАЖЕНИЯМИ
+// ============================================================================
+
+bool Utils::loadImage(const std::string &path)
+{
+    pImpl->current_image = cv::imread(path);
+    if (pImpl->current_image.empty())
+    {
+        LOG_ERROR("Cannot load image: {}", path);
+        return false;
+    }
+    LOG_INFO("Image loaded: {} ({}x{})", path, pImpl->current_image.cols, pImpl->current_image.rows);
+    return true;
+}
+
+bool Utils::saveImage(const std::string &path)
+{
+    return saveImage(pImpl->current_image, path);
+}
+
+bool Utils::saveImage(const cv::Mat &image, const std::string &path)
+{
+    if (image.empty())
+    {
+        LOG_WARN("No image to save");
+        return false;
+    }
+
+    bool success = cv::imwrite(path, image);
+    if (success)
+    {
+        LOG_INFO("Image saved: {}", path);
+    }
+    else
+    {
+        LOG_ERROR("Failed to save image: {}", path);
+    }
+    return success;
+}
+
+// Копия для изменения; только для чтения - getCurrentImageView
+cv::Mat Utils::getCurrentImage()
+{
+    return FramePool::instance().clone(pImpl->current_image);
+}
+
+const cv::Mat &Utils::getCurrentImageView() const
+{
+    return pImpl->current_image;
+}
+
+void Utils::setCurrentImage(const cv::Mat &image)
+{
+    pImpl->current_image = FramePool::instance().clone(image); // Прежний буфер уходит в пул
+}
+
+// Буфер переходит без копирования: счетчик ссылок OpenCV держит его, пока он текущий
+void Utils::setCurrentImage(cv::Mat &&image)
+{
+    pImpl->current_image = std::move(image);
+}
+
+// ============================================================================
+// СЕТЕВОЕ ВЗАИМОДЕЙСТВИЕ
+// ============================================================================
+
+bool Utils::initializeShm(const std::string &endpoint, bool is_server)
+{
+    // Как и для TCP, повторный вызов с тем же адресом оставляет открытый сегмент:
+    // сервер не пересоздает его под уже подключенным клиентом, а клиент переоткрывает
+    // сегмент, только если сервер создал его заново
+    if (pImpl->shm && pImpl->endpoint == endpoint && pImpl->is_server == is_server)
+    {
+        if (!pImpl->shm->isStale())
+        {
+            return true;
+        }
+        LOG_INFO("Shared memory segment was recreated, reopening: {}", endpoint);
+    }
+
+    pImpl->closeSocket();
+    pImpl->shm.reset(); // сервер удаляет старый сегмент до создания нового
+    resetLinkState(false);
+    pImpl->shm = ShmTransport::open(endpoint.substr(SHM_PREFIX.size()), is_server);
+    pImpl->connected = pImpl->shm != nullptr;
+    pImpl->is_server = is_server;
+
+    if (pImpl->connected)
+    {
+        pImpl->endpoint = endpoint;
+        LOG_INFO("{} {} (slot {} bytes)", is_server ? "Server started on:" : "Client connected to:", endpoint,
+                 pImpl->shm->getSlotSize());
+    }
+    return pImpl->connected;
+}
+
+bool Utils::initializeServer(const std::string &ip, int port)
+{
+    // Стадии на одной машине: кольцо в разделяемой памяти вместо TCP
+    if (ip.compare(0, SHM_PREFIX.size(), SHM_PREFIX) == 0)
+    {
+        return initializeShm(ip, true);
+    }
+
+    std::string address = "tcp://" + ip + ":" + std::to_string(port);
+    if (pImpl->socket && pImpl->endpoint == address && pImpl->is_server && !pImpl->async_mode)
+    {
+        return true; // Сокет уже слушает этот адрес
+    }
+
+    try
+    {
+        pImpl->shm.reset();
+        resetLinkState(false);
+        openSocket(ZMQ_REP, address, port, true);
+        pImpl->connected = true;
+        pImpl->is_server = true;
+        applyLinkSettings(port);
+
+        pImpl->socket->set(zmq::sockopt::rcvtimeo, IO_TIMEOUT_MS);
+        pImpl->socket->set(zmq::sockopt::sndtimeo, IO_TIMEOUT_MS);
+
+        LOG_INFO("Server started on: {}", address);
+        return true;
+    }
+    catch (const zmq::error_t &e)
+    {
+        LOG_ERROR("Server initialization error: {}", e.what());
+        return false;
+    }
+}
+
+bool Utils::initializeClient(const std::string &ip, int port)
+{
+    if (ip.compare(0, SHM_PREFIX.size(), SHM_PREFIX) == 0)
+    {
+        return initializeShm(ip, false);
+    }
+
+    std::string address = "tcp://" + ip + ":" + std::to_string(port);
+    if (pImpl->socket && pImpl->endpoint == address && !pImpl->is_server && !pImpl->async_mode)
+    {
+        // Соединение живое или ZeroMQ его восстанавливает - новый сокет не нужен
+        LOG_TRACE("Client reuses connection to: {}", address);
+        return true;
+    }
+
+    try
+    {
+        pImpl->shm.reset();
+        resetLinkState(false);
+        openSocket(ZMQ_REQ, address, port, false);
+        pImpl->connected = true;
+        pImpl->is_server = false;
+        applyLinkSettings(port);
+
+        pImpl->socket->set(zmq::sockopt::rcvtimeo, IO_TIMEOUT_MS);
+        pImpl->socket->set(zmq::sockopt::sndtimeo, IO_TIMEOUT_MS);
+
+        LOG_INFO("Client connected to: {}", address);
+        return true;
+    }
+    catch (const zmq::error_t &e)
+    {
+        LOG_ERROR("Client initialization error: {}", e.what());
+        return false;
+    }
+}
+
+void Utils::resetLinkState(bool async_mode)
+{
+    if (!pImpl->batch_headers.empty() || !pImpl->received_batch.empty())
+    {
+        LOG_INFO("Link reinitialized: {} unsent and {} unread batched frames discarded",
+                 pImpl->batch_headers.size(), pImpl->received_batch.size());
+    }
+
+    pImpl->async_mode = async_mode;
+    pImpl->in_flight.clear();
+    pImpl->reply_routes.clear();
+    pImpl->client_id.clear();
+    pImpl->batch_headers.clear();
+    pImpl->batch_payloads.clear();
+    pImpl->received_batch.clear();
+}
+
+// Новый сокет с heartbeat и переподключением из настроек канала с этим портом.
+// Параметры соединения действуют только если заданы до bind/connect.
+void Utils::openSocket(int type, const std::string &address, int port, bool bind)
+{
+    pImpl->closeSocket();
+    auto socket = std::make_unique<zmq::socket_t>(*pImpl->context, type);
+
+    std::shared_ptr<const ConfigSnapshot> snapshot = getConfigSnapshot();
+    const LinkConfig defaults;
+    const LinkConfig *link = snapshot->findLink(port);
+    if (!link)
+    {
+        link = &defaults;
+    }
+
+    // Собеседник, не ответивший на PING, считается потерянным: соединение закрывается и
+    // восстанавливается, а не висит до таймаута приема
+    if (link->heartbeat_ms > 0)
+    {
+        socket->set(zmq::sockopt::heartbeat_ivl, link->heartbeat_ms);
+        socket->set(zmq::sockopt::heartbeat_timeout, link->heartbeat_timeout_ms);
+        socket->set(zmq::sockopt::heartbeat_ttl, std::min(link->heartbeat_timeout_ms, HEARTBEAT_TTL_MAX_MS));
+    }
+    socket->set(zmq::sockopt::reconnect_ivl, RECONNECT_MIN_MS);
+    socket->set(zmq::sockopt::reconnect_ivl_max, RECONNECT_MAX_MS);
+
+    if (type == ZMQ_REQ)
+    {
+        // Без ответа на запрос REQ не дает отправить следующий - после таймаута сокет
+        // пришлось бы пересоздавать. Опоздавший ответ на старый запрос отбрасывается
+        socket->set(zmq::sockopt::req_relaxed, 1);
+        socket->set(zmq::sockopt::req_correlate, 1);
+    }
+
+    // Монитор подключается до connect, чтобы не пропустить первое соединение
+    static std::atomic<uint64_t> monitor_counter(0);
+    auto monitor = std::make_unique<LinkMonitor>();
+    monitor->init(*socket, "inproc://utils-link-" + std::to_string(monitor_counter++),
+                  ZMQ_EVENT_CONNECTED | ZMQ_EVENT_ACCEPTED | ZMQ_EVENT_DISCONNECTED);
+
+    if (bind)
+    {
+        socket->bind(address);
+    }
+    else
+    {
+        socket->connect(address);
+    }
+
+    pImpl->socket = std::move(socket);
+    pImpl->monitor = std::move(monitor);
+    pImpl->endpoint = address;
+}
+
+bool Utils::initializeAsync(const std::string &ip, int port, bool is_server)
+{
+    if (ip.compare(0, SHM_PREFIX.size(), SHM_PREFIX) == 0)
+    {
+        LOG_WARN("Async mode is not supported for shared memory links");
+        return false;
+    }
+
+    try
+    {
+        pImpl->shm.reset();
+        resetLinkState(true);
+        std::string address = "tcp://" + ip + ":" + std::to_string(port);
+        openSocket(is_server ? ZMQ_ROUTER : ZMQ_DEALER, address, port, is_server);
+
+        pImpl->socket->set(zmq::sockopt::sndtimeo, IO_TIMEOUT_MS);
+        pImpl->socket->set(zmq::sockopt::linger, 0);
+        if (is_server)
+        {
+            // Ответ ушедшему клиенту - ошибка, а не тихий сброс
+            pImpl->socket->set(zmq::sockopt::router_mandatory, 1);
+        }
+
+        pImpl->connected = true;
+        pImpl->is_server = is_server;
+        applyLinkSettings(port);
+
+        if (is_server)
+        {
+            LOG_INFO("Async server started on: {}", address);
+        }
+        else
+        {
+            LOG_INFO("Async client connected to: {} (window {})", address, pImpl->window);
+        }
+        return true;
+    }
+    catch (const zmq::error_t &e)
+    {
+        LOG_ERROR("Async initialization error: {}", e.what());
+        return false;
+    }
+}
+
+bool Utils::initializeAsyncServer(const std::string &ip, int port)
+{
+    return initializeAsync(ip, port, true);
+}
+
+bool Utils::initializeAsyncClient(const std::string &ip, int port, int window)
+{
+    if (window <= 0)
+    {
+        // Окно канала из конфигурации: <секция>.window
+        const LinkConfig *link = getConfigSnapshot()->findLink(port);
+        window = link ? link->window : (int)DEFAULT_ASYNC_WINDOW;
+    }
+
+    pImpl->window = (size_t)window;
+    return initializeAsync(ip, port, false);
+}
+
+// ============================================================================
+// СЕРИАЛИЗАЦИЯ И ДЕСЕРИАЛИЗАЦИЯ ИЗОБРАЖЕНИЙ
+// ============================================================================
+
+// Старый формат: одно сообщение с BMP. Оставлен для приема от прежних отправителей.
+cv::Mat Utils::deserializeImage(const std::string &data)
+{
+    if (data.empty())
+    {
+        return cv::Mat();
+    }
+
+    std::vector<uchar> buffer(data.begin(), data.end());
+    return cv::imdecode(buffer, cv::IMREAD_COLOR);
+}
+
+// ============================================================================
+// КОДЕКИ
+// ============================================================================
+
+bool Utils::setCodec(const std::string &name)
+{
+    const ImageCodec *codec = CodecRegistry::instance().find(name);
+    if (!codec)
+    {
+        LOG_WARN("Unknown codec '{}', keeping {}", name, pImpl->codec->name());
+        return false;
+    }
+
+    pImpl->codec = codec;
+    LOG_INFO("Codec selected: {}", codec->name());
+    return true;
+}
+
+std::string Utils::getCodec()
+{
+    return pImpl->codec->name();
+}
+
+// Настройки канала берутся из секции конфигурации с тем же портом:
+// codec, batch_frames, batch_ms (например server.codec)
+void Utils::applyLinkSettings(int port)
+{
+    pImpl->batch_frames = 1;
+    pImpl->batch_ms = 0;
+
+    std::shared_ptr<const ConfigSnapshot> snapshot = getConfigSnapshot();
+    const LinkConfig *link = snapshot->findLink(port);
+    if (!link)
+    {
+        return;
+    }
+
+    if (!link->codec.empty())
+    {
+        setCodec(link->codec);
+    }
+    pImpl->batch_frames = (size_t)link->batch_frames;
+    pImpl->batch_ms = link->batch_ms;
+
+    if (pImpl->batch_frames > 1)
+    {
+        LOG_INFO("Batching: up to {} frames or {} ms per message", pImpl->batch_frames, pImpl->batch_ms);
+    }
+}
+
+// ============================================================================
+// ПЕРЕДАЧА ИЗОБРАЖЕНИЙ
+// ============================================================================
+
+// Счетчики кадров и байтов; общие для всех экземпляров Utils процесса
+static void countSent(size_t frames, size_t bytes)
+{
+    static Counter &sent_frames = MetricsRegistry::instance().counter("utils_frames_sent_total");
+    static Counter &sent_bytes = MetricsRegistry::instance().counter("utils_bytes_sent_total");
+    sent_frames.add(frames);
+    sent_bytes.add(bytes);
+}
+
+static void countReceived(size_t frames, size_t bytes)
+{
+    static Counter &received_frames = MetricsRegistry::instance().counter("utils_frames_received_total");
+    static Counter &received_bytes = MetricsRegistry::instance().counter("utils_bytes_received_total");
+    received_frames.add(frames);
+    received_bytes.add(bytes);
+}
+
+// Разбор пакета: полезные нагрузки не копируются, кадры ссылаются на части сообщения.
+// Все части пакета дочитываются из сокета, даже если таблица повреждена.
+static bool unpackBatch(zmq::socket_t &socket, const zmq::message_t &index,
+                        std::deque<std::pair<cv::Mat, uint64_t>> &frames)
+{
+    std::vector<zmq::message_t> headers;
+    bool index_ok = decodeBatchIndex(index, headers);
+
+    std::vector<zmq::message_t> payloads;
+    bool more = index.more();
+    while (more)
+    {
+        payloads.emplace_back();
+        socket.recv(payloads.back(), zmq::recv_flags::none);
+        more = payloads.back().more();
+    }
+
+    if (!index_ok || headers.size() != payloads.size())
+    {
+        LOG_ERROR("Failed to deserialize received batch");
+        return false;
+    }
+
+    size_t total_size = index.size();
+    size_t decoded = 0;
+    for (size_t i = 0; i < headers.size(); i++)
+    {
+        total_size += payloads[i].size();
+        uint64_t frame_id = 0;
+        const ImageCodec *codec = nullptr;
+        cv::Mat image = decodeFrame(headers[i], std::move(payloads[i]), frame_id, codec);
+        if (!image.empty())
+        {
+            frames.emplace_back(image, frame_id);
+            decoded++;
+        }
+    }
+
+    LOG_DEBUG("Batch received ({} of {} frames, {} bytes)", decoded, headers.size(), total_size);
+    countReceived(decoded, total_size);
+    return decoded > 0;
+}
+
+
+bool Utils::sendImage(const cv::Mat &image)
+{
+    return sendImage(image, pImpl->next_frame_id);
+}
+
+bool Utils::sendImage(const cv::Mat &image, uint64_t frame_id)
+{
+    return sendImage(image, frame_id, FrameTrace());
+}
+
+bool Utils::sendImage(const cv::Mat &image, uint64_t frame_id, const FrameTrace &trace)
+{
+    if (!pImpl->connected || (!pImpl->socket && !pImpl->shm))
+    {
+        LOG_WARN("Not connected");
+        return false;
+    }
+
+    if (image.empty())
+    {
+        LOG_ERROR("Failed to serialize image");
+        return false;
+    }
+
+    if (pImpl->shm)
+    {
+        if (!pImpl->shm->sendImage(image, frame_id, IO_TIMEOUT_MS))
+        {
+            LOG_ERROR("Failed to send image");
+            return false;
+        }
+        pImpl->next_frame_id = frame_id + 1;
+        LOG_DEBUG("Image sent (shared memory, frame {})", frame_id);
+        countSent(1, image.total() * image.elemSize());
+        return true;
+    }
+
+    try
     {
-        try
+        const ImageCodec *codec = pImpl->codec;
+        zmq::message_t header_msg;
+        zmq::message_t payload;
+        encodeFrame(image, frame_id, codec, header_msg, payload, &trace);
+
+        // После send сообщение ZeroMQ пустое - размеры запоминаются заранее
+        size_t header_size = header_msg.size();
+        size_t payload_size = payload.size();
+        auto result = pImpl->socket->send(header_msg, zmq::send_flags::sndmore);
+        if (result.has_value())
         {
-            context = std::make_unique<zmq::context_t>(1);
+            result = pImpl->socket->send(payload, zmq::send_flags::none);
         }
-        catch (const zmq::error_t &e)
+
+        if (result.has_value())
+        {
+            pImpl->next_frame_id = frame_id + 1;
+            LOG_DEBUG("Image sent ({} bytes, {}, frame {})", payload_size, codec->name(), frame_id);
+            countSent(1, header_size + payload_size);
+            return true;
+        }
+        else
         {
-            std::cout << "ZeroMQ initialization error: " << e.what() << std::endl;
+            LOG_ERROR("Failed to send image");
+            return false;
         }
     }
-};
-
-Utils::Utils() : pImpl(std::make_unique<Impl>()) {}
-
-Utils::~Utils()
-{
-    if (pImpl->connected && pImpl->socket)
+    catch (const zmq::error_t &e)
     {
-        pImpl->socket->close();
+        LOG_ERROR("Send image error: {}", e.what());
+        return false;
     }
-    if (pImpl->context)
+}
+
+cv::Mat Utils::receiveImage()
+{
+    if (!pImpl->connected || (!pImpl->socket && !pImpl->shm))
     {
-        pImpl->context->close();
+        LOG_WARN("Not connected");
+        return cv::Mat();
     }
-}
 
-// ============================================================================
-// КОНФИГУРАЦИЯ
-// ============================================================================
+    pImpl->last_trace = FrameTrace();
 
-void Utils::loadConfig(const std::string &config_path)
-{
-    try
+    // Отправитель, который сам ждет данных, не должен держать просроченный пакет
+    flushExpiredBatch();
+
+    // Кадры ранее принятого пакета выдаются без обращения к сети
+    if (!pImpl->received_batch.empty())
     {
-        pImpl->config = YAML::LoadFile(config_path);
-        std::cout << "Configuration loaded from: " << config_path << std::endl;
+        cv::Mat image = pImpl->received_batch.front().first;
+        pImpl->last_frame_id = pImpl->received_batch.front().second;
+        pImpl->last_frame_numbered = true;
+        pImpl->received_batch.pop_front();
+        return image;
     }
-    catch (const YAML::Exception &e)
+
+    if (pImpl->shm)
     {
-        std::cout << "Error loading config file: " << e.what() << std::endl;
+        uint64_t frame_id = 0;
+        cv::Mat image = pImpl->shm->receiveImage(frame_id, IO_TIMEOUT_MS);
+        if (image.empty())
+        {
+            LOG_WARN("No image received");
+            return cv::Mat();
+        }
+        pImpl->last_frame_id = frame_id;
+        pImpl->last_frame_numbered = true;
+        LOG_DEBUG("Image received (shared memory, {}x{}, frame {})", image.cols, image.rows, frame_id);
+        countReceived(1, image.total() * image.elemSize());
+        return image;
     }
-}
 
-std::string Utils::getConfig(const std::string &node_path)
-{
     try
     {
-        YAML::Node node = YAML::Clone(pImpl->config);
-        std::vector<std::string> tokens;
+        zmq::message_t message;
+        auto result = pImpl->socket->recv(message, zmq::recv_flags::none);
+
+        if (!result.has_value() || message.size() == 0)
+        {
+            LOG_WARN("No image received");
+            return cv::Mat();
+        }
+
+        // Одночастное сообщение - старый формат BMP
+        if (!message.more())
+        {
+            std::string image_data(static_cast<char *>(message.data()), message.size());
+            cv::Mat image = deserializeImage(image_data);
+
+            if (!image.empty())
+            {
+                pImpl->last_frame_numbered = false;
+                LOG_DEBUG("Image received ({} bytes, {}x{})", message.size(), image.cols, image.rows);
+                countReceived(1, message.size());
+            }
+            else
+            {
+                LOG_ERROR("Failed to deserialize received image");
+            }
+
+            return image;
+        }
+
+        if (isBatchIndex(message))
+        {
+            if (!unpackBatch(*pImpl->socket, message, pImpl->received_batch))
+            {
+                return cv::Mat();
+            }
+            return receiveImage();
+        }
+
+        zmq::message_t payload;
+        result = pImpl->socket->recv(payload, zmq::recv_flags::none);
+
+        // Дочитываем лишние части, чтобы не сломать очередность REQ/REP
+        bool extra_parts = payload.more();
+        while (payload.more())
+        {
+            zmq::message_t extra;
+            pImpl->socket->recv(extra, zmq::recv_flags::none);
+            if (!extra.more())
+            {
+                break;
+            }
+        }
 
-        // Парсим путь вида "server.ip"
-        size_t start = 0, end = 0;
-        while ((end = node_path.find('.', start)) != std::string::npos)
+        if (!result.has_value() || extra_parts)
         {
-            tokens.push_back(node_path.substr(start, end - start));
-            start = end + 1;
+            LOG_ERROR("Failed to deserialize received image");
+            return cv::Mat();
         }
-        tokens.push_back(node_path.substr(start));
 
-        // Проходим по узлам
-        for (const auto &token : tokens)
+        size_t payload_size = payload.size();
+        uint64_t frame_id = 0;
+        const ImageCodec *codec = nullptr;
+        cv::Mat image = decodeFrame(message, std::move(payload), frame_id, codec, &pImpl->last_trace);
+        if (image.empty())
         {
-            node = node[token];
+            return cv::Mat();
         }
 
-        return node.as<std::string>();
+        pImpl->last_frame_id = frame_id;
+        pImpl->last_frame_numbered = true;
+
+        LOG_DEBUG("Image received ({} bytes, {}, {}x{}, frame {})",
+                  payload_size, codec->name(), image.cols, image.rows, frame_id);
+        countReceived(1, message.size() + payload_size);
+        return image;
     }
-    catch (const YAML::Exception &e)
+    catch (const zmq::error_t &e)
     {
-        std::cout << "Error getting config '" << node_path << "': " << e.what() << std::endl;
-        return "";
+        LOG_ERROR("Receive image error: {}", e.what());
+        return cv::Mat();
     }
 }
 
+uint64_t Utils::getLastFrameId()
+{
+    return pImpl->last_frame_id;
+}
+
+bool Utils::hasLastFrameId()
+{
+    return pImpl->last_frame_numbered;
+}
+
+FrameTrace Utils::getLastTrace()
+{
+    return pImpl->last_trace;
+}
+
 // ============================================================================
-// РАБОТА С ИЗОБРАЖЕНИЯМИ
+// ПАКЕТНАЯ ПЕРЕДАЧА ИЗОБРАЖЕНИЙ
 // ============================================================================
 
-bool Utils::loadImage(const std::string &path)
+bool Utils::sendImageBatched(const cv::Mat &image, uint64_t frame_id)
 {
-    pImpl->current_image = cv::imread(path);
-    if (pImpl->current_image.empty())
+    // Пакеты выключены или транспорт без сообщений ZeroMQ - обычная отправка
+    if (pImpl->batch_frames <= 1 || pImpl->shm || pImpl->async_mode)
     {
-        std::cout << "Cannot load image: " << path << std::endl;
-        return false;
+        return sendImage(image, frame_id);
     }
-    std::cout << "Image loaded: " << path << " ("
-              << pImpl->current_image.cols << "x" << pImpl->current_image.rows << ")" << std::endl;
-    return true;
-}
 
-bool Utils::saveImage(const std::string &path)
-{
-    if (pImpl->current_image.empty())
+    if (!pImpl->connected || !pImpl->socket)
     {
-        std::cout << "No image to save" << std::endl;
+        LOG_WARN("Not connected");
         return false;
     }
 
-    bool success = cv::imwrite(path, pImpl->current_image);
-    if (success)
+    if (image.empty())
     {
-        std::cout << "Image saved: " << path << std::endl;
+        LOG_ERROR("Failed to serialize image");
+        return false;
     }
-    else
+
+    const ImageCodec *codec = pImpl->codec;
+    zmq::message_t header_msg;
+    zmq::message_t payload;
+    encodeFrame(image, frame_id, codec, header_msg, payload);
+
+    if (pImpl->batch_headers.empty())
     {
-        std::cout << "Failed to save image: " << path << std::endl;
+        pImpl->batch_started = std::chrono::steady_clock::now();
     }
-    return success;
-}
-
-cv::Mat Utils::getCurrentImage()
-{
-    return pImpl->current_image.clone();
-}
+    pImpl->batch_headers.push_back(std::move(header_msg));
+    pImpl->batch_payloads.push_back(std::move(payload));
+    pImpl->batch_last_id = frame_id;
 
-void Utils::setCurrentImage(const cv::Mat &image)
-{
-    pImpl->current_image = image.clone();
+    if (pImpl->batch_headers.size() >= pImpl->batch_frames)
+    {
+        return flushBatch();
+    }
+    return flushExpiredBatch();
 }
 
-// ============================================================================
-// СЕТЕВОЕ ВЗАИМОДЕЙСТВИЕ
-// ============================================================================
-
-bool Utils::initializeServer(const std::string &ip, int port)
+bool Utils::flushExpiredBatch()
 {
-    try
+    // batch_ms = 0 - срока нет, пакет уходит только по числу кадров или flushBatch
+    if (pImpl->batch_headers.empty() || pImpl->batch_ms <= 0)
     {
-        std::string address = "tcp://" + ip + ":" + std::to_string(port);
-        pImpl->socket = std::make_unique<zmq::socket_t>(*pImpl->context, ZMQ_REP);
-        pImpl->socket->bind(address);
-        pImpl->connected = true;
-        pImpl->is_server = true;
-
-        pImpl->socket->set(zmq::sockopt::rcvtimeo, 10000);
-        pImpl->socket->set(zmq::sockopt::sndtimeo, 10000);
-
-        std::cout << "Server started on: " << address << std::endl;
         return true;
     }
-    catch (const zmq::error_t &e)
+
+    auto elapsed = std::chrono::steady_clock::now() - pImpl->batch_started;
+    if (elapsed < std::chrono::milliseconds(pImpl->batch_ms))
     {
-        std::cout << "Server initialization error: " << e.what() << std::endl;
-        return false;
+        return true;
     }
+    return flushBatch();
 }
 
-bool Utils::initializeClient(const std::string &ip, int port)
+bool Utils::flushBatch()
 {
-    try
+    if (pImpl->batch_headers.empty())
     {
-        std::string address = "tcp://" + ip + ":" + std::to_string(port);
-        pImpl->socket = std::make_unique<zmq::socket_t>(*pImpl->context, ZMQ_REQ);
+        return true;
+    }
 
-        pImpl->socket->connect(address);
-        pImpl->connected = true;
-        pImpl->is_server = false;
+    size_t count = pImpl->batch_headers.size();
+    zmq::message_t index = encodeBatchIndex(pImpl->batch_headers);
+    pImpl->batch_headers.clear();
+
+    try
+    {
+        size_t total_size = index.size();
+        auto result = pImpl->socket->send(index, zmq::send_flags::sndmore);
+        for (size_t i = 0; i < pImpl->batch_payloads.size() && result.has_value(); i++)
+        {
+            bool last = i + 1 == pImpl->batch_payloads.size();
+            total_size += pImpl->batch_payloads[i].size();
+            result = pImpl->socket->send(pImpl->batch_payloads[i], last ? zmq::send_flags::none : zmq::send_flags::sndmore);
+        }
+        pImpl->batch_payloads.clear();
 
-        pImpl->socket->set(zmq::sockopt::rcvtimeo, 10000);
-        pImpl->socket->set(zmq::sockopt::sndtimeo, 10000);
+        if (!result.has_value())
+        {
+            LOG_ERROR("Failed to send batch of {} frames", count);
+            return false;
+        }
 
-        std::cout << "Client connected to: " << address << std::endl;
+        pImpl->next_frame_id = pImpl->batch_last_id + 1;
+        LOG_DEBUG("Batch sent ({} frames, {} bytes, last frame {})", count, total_size, pImpl->batch_last_id);
+        countSent(count, total_size);
         return true;
     }
     catch (const zmq::error_t &e)
     {
-        std::cout << "Client initialization error: " << e.what() << std::endl;
+        pImpl->batch_payloads.clear();
+        LOG_ERROR("Send batch error: {}", e.what());
         return false;
     }
 }
+
 // ============================================================================
-// СЕРИАЛИЗАЦИЯ И ДЕСЕРИАЛИЗАЦИЯ ИЗОБРАЖЕНИЙ
+// АСИНХРОННАЯ ПЕРЕДАЧА ИЗОБРАЖЕНИЙ
 // ============================================================================
 
-std::string Utils::serializeImage(const cv::Mat &image)
+bool Utils::sendImageAsync(const cv::Mat &image, uint64_t correlation_id)
 {
-    if (image.empty())
+    if (!pImpl->connected || !pImpl->socket || !pImpl->async_mode)
     {
-        return "";
+        LOG_WARN("Async link is not initialized");
+        return false;
     }
 
-    std::vector<uchar> buffer;
-    cv::imencode(".bmp", image, buffer);
-
-    return std::string(buffer.begin(), buffer.end());
-}
-
-cv::Mat Utils::deserializeImage(const std::string &data)
-{
-    if (data.empty())
+    if (image.empty())
     {
-        return cv::Mat();
+        LOG_ERROR("Failed to serialize image");
+        return false;
     }
 
-    std::vector<uchar> buffer(data.begin(), data.end());
-    return cv::imdecode(buffer, cv::IMREAD_COLOR);
-}
+    pImpl->expireAsync();
 
-// ============================================================================
-// ПЕРЕДАЧА ИЗОБРАЖЕНИЙ
-// ============================================================================
+    // Клиент: окно заполнено - сначала нужно забрать ответы через tryReceiveImage
+    if (!pImpl->is_server && pImpl->in_flight.size() >= pImpl->window)
+    {
+        return false;
+    }
 
-bool Utils::sendImage(const cv::Mat &image)
-{
-    if (!pImpl->connected || !pImpl->socket)
+    // Сервер: ответ уходит тому клиенту, от которого пришел кадр с этим номером
+    auto route = pImpl->reply_routes.find(correlation_id);
+    if (pImpl->is_server && route == pImpl->reply_routes.end())
     {
-        std::cout << "Not connected" << std::endl;
+        LOG_WARN("No client waiting for frame {}", correlation_id);
         return false;
     }
 
     try
     {
-        std::string image_data = serializeImage(image);
-        if (image_data.empty())
+        const ImageCodec *codec = pImpl->codec;
+        zmq::message_t header_msg;
+        zmq::message_t payload;
+        encodeFrame(image, correlation_id, codec, header_msg, payload);
+
+        size_t header_size = header_msg.size();
+        size_t payload_size = payload.size();
+        zmq::send_result_t result;
+        if (pImpl->is_server)
         {
-            std::cout << "Failed to serialize image" << std::endl;
-            return false;
+            zmq::message_t identity(route->second.client.data(), route->second.client.size());
+            result = pImpl->socket->send(identity, zmq::send_flags::sndmore);
+            if (!result.has_value())
+            {
+                LOG_ERROR("Failed to send image");
+                return false;
+            }
         }
 
-        zmq::message_t message(image_data.size());
-        memcpy(message.data(), image_data.data(), image_data.size());
-
-        auto result = pImpl->socket->send(message, zmq::send_flags::none);
+        result = pImpl->socket->send(header_msg, zmq::send_flags::sndmore);
         if (result.has_value())
         {
-            std::cout << "Image sent (" << image_data.size() << " bytes)" << std::endl;
-            return true;
+            result = pImpl->socket->send(payload, zmq::send_flags::none);
         }
-        else
+
+        if (!result.has_value())
         {
-            std::cout << "Failed to send image" << std::endl;
+            LOG_ERROR("Failed to send image");
             return false;
         }
+
+        if (pImpl->is_server)
+        {
+            pImpl->reply_routes.erase(route);
+        }
+        else
+        {
+            pImpl->in_flight[correlation_id] = std::chrono::steady_clock::now();
+        }
+
+        LOG_DEBUG("Image sent async ({} bytes, {}, frame {}, in flight {})",
+                  payload_size, codec->name(), correlation_id, pImpl->in_flight.size());
+        countSent(1, header_size + payload_size);
+        return true;
     }
     catch (const zmq::error_t &e)
     {
-        std::cout << "Send image error: " << e.what() << std::endl;
+        LOG_ERROR("Send image error: {}", e.what());
         return false;
     }
 }
 
-cv::Mat Utils::receiveImage()
+bool Utils::tryReceiveImage(cv::Mat &image, uint64_t &correlation_id, int timeout_ms)
 {
-    if (!pImpl->connected || !pImpl->socket)
+    if (!pImpl->connected || !pImpl->socket || !pImpl->async_mode)
     {
-        std::cout << "Not connected" << std::endl;
-        return cv::Mat();
+        LOG_WARN("Async link is not initialized");
+        return false;
     }
 
+    pImpl->expireAsync();
+
     try
     {
-        zmq::message_t message;
-        auto result = pImpl->socket->recv(message, zmq::recv_flags::none);
+        zmq::pollitem_t items[] = {{static_cast<void *>(*pImpl->socket), 0, ZMQ_POLLIN, 0}};
+        zmq::poll(items, 1, std::chrono::milliseconds(timeout_ms));
+        if (!(items[0].revents & ZMQ_POLLIN))
+        {
+            return false;
+        }
 
-        if (result.has_value() && message.size() > 0)
+        // Сообщение приходит целиком: [routing id] + заголовок + полезная нагрузка
+        std::vector<zmq::message_t> parts;
+        do
         {
-            std::string image_data(static_cast<char *>(message.data()), message.size());
-            cv::Mat image = deserializeImage(image_data);
+            parts.emplace_back();
+            pImpl->socket->recv(parts.back(), zmq::recv_flags::none);
+        } while (parts.back().more());
 
-            if (!image.empty())
+        size_t first = pImpl->is_server ? 1 : 0;
+        if (parts.size() != first + 2)
+        {
+            LOG_ERROR("Failed to deserialize received image");
+            return false;
+        }
+
+        size_t payload_size = parts[first + 1].size();
+        uint64_t frame_id = 0;
+        const ImageCodec *codec = nullptr;
+        pImpl->last_trace = FrameTrace();
+        cv::Mat received = decodeFrame(parts[first], std::move(parts[first + 1]), frame_id, codec, &pImpl->last_trace);
+
+        if (pImpl->is_server)
+        {
+            // Запоминаем отправителя, даже если кадр не разобрался - клиент ждет ответ
+            pImpl->client_id = parts[0].to_string();
+            pImpl->reply_routes[frame_id] = Impl::ReplyRoute{pImpl->client_id, std::chrono::steady_clock::now()};
+        }
+        else
+        {
+            auto sent = pImpl->in_flight.find(frame_id);
+            if (sent == pImpl->in_flight.end())
             {
-                std::cout << "Image received (" << message.size() << " bytes, "
-                          << image.cols << "x" << image.rows << ")" << std::endl;
+                LOG_WARN("Reply for unknown frame {}", frame_id);
             }
             else
             {
-                std::cout << "Failed to deserialize received image" << std::endl;
+                static LatencyHistogram &round_trip_time = MetricsRegistry::instance().histogram("utils_round_trip_us");
+                auto round_trip = std::chrono::duration_cast<std::chrono::microseconds>(
+                    std::chrono::steady_clock::now() - sent->second);
+                round_trip_time.record(round_trip.count());
+                LOG_DEBUG("Round trip for frame {}: {} us", frame_id, round_trip.count());
+                pImpl->in_flight.erase(sent);
             }
-
-            return image;
         }
-        else
+
+        if (received.empty())
         {
-            std::cout << "No image received" << std::endl;
-            return cv::Mat();
+            return false;
         }
+
+        pImpl->last_frame_id = frame_id;
+        pImpl->last_frame_numbered = true;
+        image = received;
+        correlation_id = frame_id;
+
+        LOG_DEBUG("Image received async ({} bytes, {}, {}x{}, frame {})",
+                  payload_size, codec->name(), image.cols, image.rows, frame_id);
+        countReceived(1, parts[first].size() + payload_size);
+        return true;
     }
     catch (const zmq::error_t &e)
     {
-        std::cout << "Receive image error: " << e.what() << std::endl;
-        return cv::Mat();
+        LOG_ERROR("Receive image error: {}", e.what());
+        return false;
     }
 }
 
+size_t Utils::getInFlight()
+{
+    return pImpl->in_flight.size();
+}
+
 // ============================================================================
 // ПРОСТЫЕ СООБЩЕНИЯ
 // ============================================================================
 
 void Utils::sendMessage(const std::string &message)
 {
-    if (!pImpl->connected || !pImpl->socket)
+    if (!pImpl->connected || (!pImpl->socket && !pImpl->shm))
+    {
+        LOG_WARN("Not connected");
+        return;
+    }
+
+    if (pImpl->shm)
     {
-        std::cout << "Not connected" << std::endl;
+        if (pImpl->shm->sendMessage(message, IO_TIMEOUT_MS))
+        {
+            LOG_DEBUG("Message sent: {}", message);
+        }
+        else
+        {
+            LOG_ERROR("Failed to send message: {}", message);
+        }
         return;
     }
 
@@ -336,27 +1412,41 @@ void Utils::sendMessage(const std::string &message)
         auto result = pImpl->socket->send(msg, zmq::send_flags::none);
         if (result.has_value())
         {
-            std::cout << "Message sent: " << message << std::endl;
+            LOG_DEBUG("Message sent: {}", message);
         }
         else
         {
-            std::cout << "Failed to send message: " << message << std::endl;
+            LOG_ERROR("Failed to send message: {}", message);
         }
     }
     catch (const zmq::error_t &e)
     {
-        std::cout << "Send message error: " << e.what() << std::endl;
+        LOG_ERROR("Send message error: {}", e.what());
     }
 }
 
 std::string Utils::receiveMessage()
 {
-    if (!pImpl->connected || !pImpl->socket)
+    if (!pImpl->connected || (!pImpl->socket && !pImpl->shm))
+    {
+        LOG_WARN("Not connected");
+        return "";
+    }
+
+    if (pImpl->shm)
     {
-        std::cout << "Not connected" << std::endl;
+        std::string received;
+        if (pImpl->shm->receiveMessage(received, IO_TIMEOUT_MS) && !received.empty())
+        {
+            LOG_DEBUG("Message received: {}", received);
+            return received;
+        }
+        LOG_WARN("No message received");
         return "";
     }
 
+    flushExpiredBatch();
+
     try
     {
         zmq::message_t message;
@@ -365,18 +1455,18 @@ std::string Utils::receiveMessage()
         if (result.has_value() && message.size() > 0)
         {
             std::string received(static_cast<char *>(message.data()), message.size());
-            std::cout << "Message received: " << received << std::endl;
+            LOG_DEBUG("Message received: {}", received);
             return received;
         }
         else
         {
-            std::cout << "No message received" << std::endl;
+            LOG_WARN("No message received");
             return "";
         }
     }
     catch (const zmq::error_t &e)
     {
-        std::cout << "Receive message error: " << e.what() << std::endl;
+        LOG_ERROR("Receive message error: {}", e.what());
         return "";
     }
 }
@@ -390,6 +1480,31 @@ bool Utils::isConnected()
     return pImpl->connected;
 }
 
+ConnectionState Utils::getConnectionState()
+{
+    if (!pImpl->connected)
+    {
+        return ConnectionState::Disconnected;
+    }
+    if (pImpl->shm || !pImpl->monitor)
+    {
+        return ConnectionState::Connected; // Кольцо в памяти не теряет собеседника
+    }
+
+    pImpl->monitor->drain();
+    return pImpl->monitor->peers > 0 ? ConnectionState::Connected : ConnectionState::Connecting;
+}
+
+uint64_t Utils::getDisconnects()
+{
+    if (!pImpl->monitor)
+    {
+        return 0;
+    }
+    pImpl->monitor->drain();
+    return pImpl->monitor->disconnects;
+}
+
 std::string Utils::getVersion()
 {
     return "1.0.0-image-processing-system";
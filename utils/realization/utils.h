@@ -3,6 +3,7 @@
 
 #include <string>
 #include <memory>
+#include <cstdint>
 
 // OpenCV основные заголовки
 #include <opencv2/core.hpp>
@@ -10,6 +11,17 @@
 #include <opencv2/imgcodecs.hpp> // Добавляем для imread/imwrite
 #include <opencv2/highgui.hpp>   // Добавляем для окон
 
+#include "configSnapshot.h"
+#include "frameTrace.h"
+
+// Состояние соединения по событиям сокета
+enum class ConnectionState
+{
+    Disconnected, // сокета нет
+    Connecting,   // сокет есть, собеседника нет: ZeroMQ переподключается сам
+    Connected     // есть хотя бы один собеседник
+};
+
 class Utils
 {
 private:
@@ -21,34 +33,110 @@ public:
     ~Utils();
 
     // Конфигурация
+    // Файл разбирается один раз в типизированный снимок. getConfigSnapshot и getConfig
+    // не копируют дерево YAML - их можно вызывать на каждом кадре. Снимок кэшируется
+    // в каждом потоке: пока версия не сменилась, чтение обходится без мьютекса.
     void loadConfig(const std::string &config_path = "config.yaml");
     std::string getConfig(const std::string &node_path);
+    std::shared_ptr<const ConfigSnapshot> getConfigSnapshot();
+    bool reloadConfig(); // перечитать файл; при ошибке остается прежний снимок
+    bool watchConfig(); // перечитывать файл при его изменении (inotify, Linux)
+
+    // Канал управления (REP на ip:port): параметры, которые стадии читают на каждом кадре,
+    // меняются без перезапуска. Команды: SET <ключ> <значение>, GET <ключ>, LIST, RESET.
+    // Измененные значения сохраняются при перезагрузке файла до команды RESET.
+    bool startControl(int port, const std::string &ip = "localhost"); // port 0 - канал выключен
+    bool setLiveSetting(const std::string &key, const std::string &value);
+
+    // Публикация метрик процесса (см. metrics.h) раз в metrics.interval_ms:
+    // сокет PUB на ip:port (0 - без сокета) и/или файл в формате Prometheus (пусто - без файла)
+    bool startMetrics(const std::string &stage, int port, const std::string &file,
+                      const std::string &ip = "localhost");
 
     // Работа с изображениями
+    // Текущее изображение разделяется, а не копируется: setCurrentImage(cv::Mat&&) забирает
+    // буфер без копирования, getCurrentImageView читает его без копирования. Копию получает
+    // только тот, кто собирается менять пиксели: getCurrentImage и setCurrentImage(const&).
+    // Переданный через && буфер нельзя менять через другие ссылки, пока он текущий.
     bool loadImage(const std::string &path);
     bool saveImage(const std::string &path);
+    bool saveImage(const cv::Mat &image, const std::string &path); // без участия текущего изображения
     cv::Mat getCurrentImage();
+    const cv::Mat &getCurrentImageView() const; // только чтение; действует до следующей замены
     void setCurrentImage(const cv::Mat &image);
+    void setCurrentImage(cv::Mat &&image);
 
     // Сетевое взаимодействие
+    // ip вида shm://<имя>[?slots=N&slot_mb=M] - кольцо в разделяемой памяти (Linux), порт не используется.
+    // Соединение долгоживущее: повторный вызов с тем же адресом возвращает уже открытый сокет,
+    // потерянный собеседник обнаруживается по heartbeat (<секция>.heartbeat_ms), ZeroMQ
+    // переподключается сам. Клиент REQ после таймаута ответа может сразу отправить новый запрос.
     bool initializeServer(const std::string &ip, int port);
     bool initializeClient(const std::string &ip, int port);
 
+    // Кодек исходящих кадров: raw, bmp, jpeg, png, lz4 (если собран).
+    // По умолчанию берется из <секция>.codec в конфигурации канала с тем же портом.
+    bool setCodec(const std::string &name);
+    std::string getCodec();
+
     // Передача изображений
+    // Кадр уходит двумя частями: заголовок (размеры, тип, шаг, номер кадра, кодек) + данные.
+    // В режиме raw принятое изображение ссылается на буфер сообщения без копирования.
     bool sendImage(const cv::Mat &image);
+    bool sendImage(const cv::Mat &image, uint64_t frame_id);
     cv::Mat receiveImage();
+    uint64_t getLastFrameId();
+    bool hasLastFrameId(); // false - отправитель прислал кадр в старом формате без номера
+
+    // Трасса кадра (frameTrace.h): стадия берет трассу принятого кадра, дописывает свои
+    // интервалы и отправляет результат вместе с ней. Через shm:// и пакеты трасса не передается.
+    bool sendImage(const cv::Mat &image, uint64_t frame_id, const FrameTrace &trace);
+    FrameTrace getLastTrace(); // пустая, если последний кадр пришел без трассы
+
+    // Пакетная передача для маленьких кадров с высокой частотой.
+    // Кадры копятся до <секция>.batch_frames штук или <секция>.batch_ms миллисекунд
+    // (0 - без срока) и уходят одним сообщением с таблицей заголовков.
+    // Сокет не потокобезопасен, поэтому срок проверяет сам отправитель: при добавлении
+    // кадра, в receiveImage/receiveMessage и в flushExpiredBatch, который нужно вызывать,
+    // пока новых кадров нет. При остановке потока недоотправленный пакет уходит через flushBatch.
+    // Для сокетов с потоком кадров без READY/DONE на каждый кадр: в обмене запрос-ответ
+    // следующий кадр не уйдет, пока не отправлен предыдущий, и копить нечего.
+    // receiveImage разбирает пакет сам и выдает кадры по одному без копирования.
+    bool sendImageBatched(const cv::Mat &image, uint64_t frame_id);
+    bool flushExpiredBatch(); // отправка пакета, если истек batch_ms
+    bool flushBatch();
+
+    // Асинхронная передача (DEALER/ROUTER) без READY/DONE.
+    // Клиент держит в пути до window кадров; 0 - взять <секция>.window из конфигурации (по умолчанию 4).
+    // Номер кадра служит идентификатором корреляции: сервер отвечает sendImageAsync с номером
+    // принятого кадра, и ответ уходит тому клиенту, который этот кадр прислал.
+    // Кадр без ответа дольше таймаута ввода-вывода (10 с) считается потерянным и освобождает
+    // место в окне; так же сервер забывает клиентов кадров, на которые не ответил.
+    // С обменом READY/DONE режим несовместим, поэтому переводить нужно обе стороны канала сразу.
+    bool initializeAsyncServer(const std::string &ip, int port);
+    bool initializeAsyncClient(const std::string &ip, int port, int window = 0);
+    bool sendImageAsync(const cv::Mat &image, uint64_t correlation_id); // false - окно заполнено или ошибка
+    bool tryReceiveImage(cv::Mat &image, uint64_t &correlation_id, int timeout_ms = 0);
+    size_t getInFlight();
 
     // Простые сообщения
     void sendMessage(const std::string &message);
     std::string receiveMessage();
 
     // Статус
-    bool isConnected();
+    // Состояние читается из событий сокета - вызывать из потока, работающего с соединением
+    bool isConnected(); // сокет создан; есть ли собеседник - getConnectionState
+    ConnectionState getConnectionState();
+    uint64_t getDisconnects(); // сколько раз собеседник пропадал с момента создания сокета
     std::string getVersion();
 
 private:
-    std::string serializeImage(const cv::Mat &image);
     cv::Mat deserializeImage(const std::string &data);
+    void applyLinkSettings(int port);
+    bool initializeShm(const std::string &endpoint, bool is_server);
+    bool initializeAsync(const std::string &ip, int port, bool is_server);
+    void resetLinkState(bool async_mode);
+    void openSocket(int type, const std::string &address, int port, bool bind);
 };
 
 #endif // _UTILS_H_
\ No newline at end of file
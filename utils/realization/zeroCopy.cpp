@@ -0,0 +1,111 @@
+#include <utility>
+
+#include "zeroCopy.h"
+#include "framePool.h"
+
+// ============================================================================
+// ОТПРАВКА: cv::Mat -> zmq::message_t
+// ============================================================================
+
+// Вызывается ZeroMQ, когда сообщение больше не нужно: отпускаем ссылку на буфер
+static void releaseMatReference(void * /*data*/, void *hint)
+{
+    delete static_cast<cv::Mat *>(hint);
+}
+
+zmq::message_t wrapMatInMessage(const cv::Mat &image)
+{
+    // Копия заголовка увеличивает счетчик ссылок буфера, пиксели не копируются
+    cv::Mat *owner = new cv::Mat(image.isContinuous() ? image : FramePool::instance().clone(image));
+
+    try
+    {
+        return zmq::message_t(owner->data, owner->total() * owner->elemSize(),
+                              releaseMatReference, owner);
+    }
+    catch (...)
+    {
+        delete owner;
+        throw;
+    }
+}
+
+static void releaseBuffer(void * /*data*/, void *hint)
+{
+    delete static_cast<std::vector<uchar> *>(hint);
+}
+
+zmq::message_t wrapBufferInMessage(std::vector<uchar> &&buffer)
+{
+    std::vector<uchar> *owner = new std::vector<uchar>(std::move(buffer));
+
+    try
+    {
+        return zmq::message_t(owner->data(), owner->size(), releaseBuffer, owner);
+    }
+    catch (...)
+    {
+        delete owner;
+        throw;
+    }
+}
+
+// ============================================================================
+// ПРИЕМ: zmq::message_t -> cv::Mat
+// ============================================================================
+
+// Аллокатор OpenCV, владеющий сообщением ZeroMQ.
+// Память самих матриц он не выделяет - это делегируется стандартному аллокатору,
+// чтобы create() на такой матрице работал как обычно.
+class MessageAllocator : public cv::MatAllocator
+{
+public:
+    cv::UMatData *allocate(int dims, const int *sizes, int type, void *data, size_t *step,
+                           cv::AccessFlag flags, cv::UMatUsageFlags usageFlags) const override
+    {
+        return cv::Mat::getStdAllocator()->allocate(dims, sizes, type, data, step, flags, usageFlags);
+    }
+
+    bool allocate(cv::UMatData *data, cv::AccessFlag accessFlags, cv::UMatUsageFlags usageFlags) const override
+    {
+        return cv::Mat::getStdAllocator()->allocate(data, accessFlags, usageFlags);
+    }
+
+    // Последняя ссылка на матрицу отпущена - освобождаем сообщение
+    void deallocate(cv::UMatData *u) const override
+    {
+        if (!u)
+        {
+            return;
+        }
+        CV_Assert(u->urefcount == 0 && u->refcount == 0);
+        delete static_cast<zmq::message_t *>(u->userdata);
+        delete u;
+    }
+};
+
+static MessageAllocator &messageAllocator()
+{
+    static MessageAllocator instance;
+    return instance;
+}
+
+cv::Mat wrapMessageInMat(zmq::message_t &&message, int rows, int cols, int type,
+                         size_t step, size_t offset)
+{
+    zmq::message_t *owner = new zmq::message_t(std::move(message));
+    uchar *base = static_cast<uchar *>(owner->data());
+
+    cv::Mat view(rows, cols, type, base + offset, step);
+
+    // Привязываем матрицу к сообщению через счетчик ссылок OpenCV
+    cv::UMatData *u = new cv::UMatData(&messageAllocator());
+    u->data = u->origdata = base;
+    u->size = owner->size();
+    u->userdata = owner;
+    u->refcount = 1;
+
+    view.u = u;
+    view.allocator = &messageAllocator();
+    return view;
+}
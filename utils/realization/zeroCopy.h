@@ -0,0 +1,26 @@
+#ifndef _ZERO_COPY_H_
+#define _ZERO_COPY_H_
+
+#include <cstddef>
+#include <vector>
+
+#include <opencv2/core.hpp>
+#include <zmq.hpp>
+
+// Сообщение ZeroMQ, ссылающееся на пиксели cv::Mat без копирования.
+// Сообщение удерживает ссылку на буфер изображения, пока ZeroMQ его не освободит,
+// поэтому отправитель не должен писать в этот буфер до окончания передачи.
+// Разрывные матрицы (ROI) предварительно копируются в непрерывный блок.
+zmq::message_t wrapMatInMessage(const cv::Mat &image);
+
+// Сообщение ZeroMQ, забирающее буфер вектора без копирования (например, результат imencode).
+zmq::message_t wrapBufferInMessage(std::vector<uchar> &&buffer);
+
+// cv::Mat поверх данных сообщения ZeroMQ без копирования.
+// Сообщение переходит во владение матрицы и живет, пока жива последняя ссылка на нее.
+// offset - смещение первой строки пикселей от начала сообщения.
+// Размер сообщения должен быть проверен вызывающей стороной.
+cv::Mat wrapMessageInMat(zmq::message_t &&message, int rows, int cols, int type,
+                         size_t step, size_t offset = 0);
+
+#endif // _ZERO_COPY_H_
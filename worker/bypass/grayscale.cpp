@@ -0,0 +1,226 @@
+#include <algorithm>
+#include "grayscale.h"
+
+#if defined(__x86_64__) || defined(_M_X64) || defined(__i386__) || defined(_M_IX86)
+#define GRAY_X86 1
+#include <immintrin.h>
+#endif
+
+#if defined(__GNUC__) || defined(__clang__)
+#define GRAY_TARGET(isa) __attribute__((target(isa)))
+#else
+#define GRAY_TARGET(isa)
+#endif
+
+// Веса Q14: round(K * 16384), зеленый доведен до суммы 16384 - белый остается 255
+struct LumaWeights {
+    int r, g, b;
+};
+
+static const int LUMA_SHIFT = 14;
+static const int LUMA_ROUND = 1 << (LUMA_SHIFT - 1);
+
+static LumaWeights lumaWeights(LumaStandard standard) {
+    switch (standard) {
+    case LumaStandard::Bt709:
+        return LumaWeights{3483, 11718, 1183};
+    case LumaStandard::Bt601:
+    default:
+        return LumaWeights{4899, 9617, 1868};
+    }
+}
+
+bool parseLumaStandard(const std::string& name, LumaStandard& standard) {
+    if (name == "bt601") {
+        standard = LumaStandard::Bt601;
+        return true;
+    }
+    if (name == "bt709") {
+        standard = LumaStandard::Bt709;
+        return true;
+    }
+    return false;
+}
+
+// ============================================================================
+// ЯДРА
+// ============================================================================
+
+static void grayScalar(const uint8_t* bgr, uint8_t* gray, size_t pixels, const LumaWeights& w) {
+    for (size_t i = 0; i < pixels; i++, bgr += 3) {
+        gray[i] = (uint8_t)((bgr[0] * w.b + bgr[1] * w.g + bgr[2] * w.r + LUMA_ROUND) >> LUMA_SHIFT);
+    }
+}
+
+#ifdef GRAY_X86
+// 4 пикселя из 12 байт: pshufb раскладывает их в пары (B, G) и (R, 0) по 16 бит,
+// pmaddwd умножает на веса и складывает пары - по 32-битной сумме на пиксель.
+// Загрузка берет 16 байт, поэтому за последней четверкой нужно еще 4 байта строки
+
+GRAY_TARGET("ssse3")
+static inline __m128i grayFourSsse3(const uint8_t* src, __m128i bg_weights, __m128i r_weights) {
+    const __m128i bg_mask = _mm_setr_epi8(0, -1, 1, -1, 3, -1, 4, -1, 6, -1, 7, -1, 9, -1, 10, -1);
+    const __m128i r_mask = _mm_setr_epi8(2, -1, -1, -1, 5, -1, -1, -1, 8, -1, -1, -1, 11, -1, -1, -1);
+    __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i*>(src));
+    __m128i sum = _mm_add_epi32(_mm_madd_epi16(_mm_shuffle_epi8(v, bg_mask), bg_weights),
+                                _mm_madd_epi16(_mm_shuffle_epi8(v, r_mask), r_weights));
+    return _mm_srli_epi32(_mm_add_epi32(sum, _mm_set1_epi32(LUMA_ROUND)), LUMA_SHIFT);
+}
+
+GRAY_TARGET("ssse3")
+static size_t graySsse3(const uint8_t* bgr, uint8_t* gray, size_t pixels, const LumaWeights& w) {
+    const __m128i bg_weights = _mm_set1_epi32((w.g << 16) | w.b);
+    const __m128i r_weights = _mm_set1_epi32(w.r);
+
+    size_t i = 0;
+    for (; (i + 16) * 3 + 4 <= pixels * 3; i += 16) {
+        const uint8_t* src = bgr + i * 3;
+        __m128i lo = _mm_packs_epi32(grayFourSsse3(src, bg_weights, r_weights),
+                                     grayFourSsse3(src + 12, bg_weights, r_weights));
+        __m128i hi = _mm_packs_epi32(grayFourSsse3(src + 24, bg_weights, r_weights),
+                                     grayFourSsse3(src + 36, bg_weights, r_weights));
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(gray + i), _mm_packus_epi16(lo, hi));
+    }
+    return i;
+}
+
+// 8 пикселей: четверка src в младшей половине регистра, следующая четверка - в старшей
+GRAY_TARGET("avx2")
+static inline __m256i grayEightAvx2(const uint8_t* src, __m256i bg_weights, __m256i r_weights) {
+    const __m256i bg_mask = _mm256_setr_epi8(0, -1, 1, -1, 3, -1, 4, -1, 6, -1, 7, -1, 9, -1, 10, -1,
+                                             0, -1, 1, -1, 3, -1, 4, -1, 6, -1, 7, -1, 9, -1, 10, -1);
+    const __m256i r_mask = _mm256_setr_epi8(2, -1, -1, -1, 5, -1, -1, -1, 8, -1, -1, -1, 11, -1, -1, -1,
+                                            2, -1, -1, -1, 5, -1, -1, -1, 8, -1, -1, -1, 11, -1, -1, -1);
+    __m256i v = _mm256_inserti128_si256(
+        _mm256_castsi128_si256(_mm_loadu_si128(reinterpret_cast<const __m128i*>(src))),
+        _mm_loadu_si128(reinterpret_cast<const __m128i*>(src + 12)), 1);
+    __m256i sum = _mm256_add_epi32(_mm256_madd_epi16(_mm256_shuffle_epi8(v, bg_mask), bg_weights),
+                                   _mm256_madd_epi16(_mm256_shuffle_epi8(v, r_mask), r_weights));
+    return _mm256_srli_epi32(_mm256_add_epi32(sum, _mm256_set1_epi32(LUMA_ROUND)), LUMA_SHIFT);
+}
+
+GRAY_TARGET("avx2")
+static size_t grayAvx2(const uint8_t* bgr, uint8_t* gray, size_t pixels, const LumaWeights& w) {
+    const __m256i bg_weights = _mm256_set1_epi32((w.g << 16) | w.b);
+    const __m256i r_weights = _mm256_set1_epi32(w.r);
+    // pack работает внутри 128-битных половин; перестановка возвращает пикселям порядок
+    const __m256i order = _mm256_setr_epi32(0, 4, 1, 5, 2, 6, 3, 7);
+
+    size_t i = 0;
+    for (; (i + 32) * 3 + 4 <= pixels * 3; i += 32) {
+        const uint8_t* src = bgr + i * 3;
+        __m256i lo = _mm256_packs_epi32(grayEightAvx2(src, bg_weights, r_weights),
+                                        grayEightAvx2(src + 24, bg_weights, r_weights));
+        __m256i hi = _mm256_packs_epi32(grayEightAvx2(src + 48, bg_weights, r_weights),
+                                        grayEightAvx2(src + 72, bg_weights, r_weights));
+        __m256i packed = _mm256_packus_epi16(lo, hi);
+        _mm256_storeu_si256(reinterpret_cast<__m256i*>(gray + i), _mm256_permutevar8x32_epi32(packed, order));
+    }
+    return i;
+}
+#endif
+
+// ============================================================================
+// ВЫБОР ЯДРА
+// ============================================================================
+
+enum class GrayKernel {
+    Scalar,
+    Ssse3,
+    Avx2
+};
+
+static GrayKernel detectGrayKernel() {
+#if defined(GRAY_X86) && (defined(__GNUC__) || defined(__clang__))
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx2")) {
+        return GrayKernel::Avx2;
+    }
+    if (__builtin_cpu_supports("ssse3")) {
+        return GrayKernel::Ssse3;
+    }
+#endif
+    return GrayKernel::Scalar;
+}
+
+static GrayKernel grayKernel() {
+    static const GrayKernel kernel = detectGrayKernel();
+    return kernel;
+}
+
+const char* grayKernelName() {
+    switch (grayKernel()) {
+    case GrayKernel::Avx2:
+        return "avx2";
+    case GrayKernel::Ssse3:
+        return "ssse3";
+    case GrayKernel::Scalar:
+        break;
+    }
+    return "scalar";
+}
+
+void bgrToGrayRow(const uint8_t* bgr, uint8_t* gray, size_t pixels, LumaStandard standard) {
+    const LumaWeights w = lumaWeights(standard);
+    size_t done = 0;
+
+#ifdef GRAY_X86
+    switch (grayKernel()) {
+    case GrayKernel::Avx2:
+        done = grayAvx2(bgr, gray, pixels, w);
+        break;
+    case GrayKernel::Ssse3:
+        done = graySsse3(bgr, gray, pixels, w);
+        break;
+    case GrayKernel::Scalar:
+        break;
+    }
+#endif
+
+    grayScalar(bgr + done * 3, gray + done, pixels - done, w); // Хвост строки
+}
+
+// ============================================================================
+// КАДР
+// ============================================================================
+
+cv::Mat convertToGrayscale(const cv::Mat& color_image, LumaStandard standard) {
+    if (color_image.channels() != 3) {
+        return color_image.clone();
+    }
+    if (color_image.depth() != CV_8U) {
+        cv::Mat grayscale;
+        cv::cvtColor(color_image, grayscale, cv::COLOR_BGR2GRAY);
+        return grayscale;
+    }
+
+    cv::Mat grayscale(color_image.rows, color_image.cols, CV_8UC1);
+
+    // Сплошной кадр - одна длинная строка: меньше хвостов, полосы делятся поровну
+    int rows = color_image.rows;
+    size_t row_pixels = (size_t)color_image.cols;
+    if (color_image.isContinuous() && grayscale.isContinuous()) {
+        row_pixels *= (size_t)rows;
+        rows = 1;
+    }
+
+    // Полосы около 64K пикселей: достаточно, чтобы занять все потоки,
+    // и крупно, чтобы накладные расходы на полосу были незаметны
+    const size_t total = row_pixels * (size_t)rows;
+    const int stripes = (int)std::max<size_t>(1, total / (64 * 1024));
+    cv::parallel_for_(cv::Range(0, stripes), [&](const cv::Range& range) {
+        size_t begin = total * (size_t)range.start / (size_t)stripes;
+        size_t end = total * (size_t)range.end / (size_t)stripes;
+        // Полоса может начинаться и кончаться посреди строки
+        while (begin < end) {
+            size_t row = begin / row_pixels;
+            size_t col = begin % row_pixels;
+            size_t count = std::min(end - begin, row_pixels - col);
+            bgrToGrayRow(color_image.ptr<uint8_t>((int)row) + col * 3, grayscale.ptr<uint8_t>((int)row) + col,
+                         count, standard);
+            begin += count;
+        }
+    });
+
+    return grayscale;
+}
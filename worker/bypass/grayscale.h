@@ -0,0 +1,32 @@
+#ifndef _GRAYSCALE_H_
+#define _GRAYSCALE_H_
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <opencv2/opencv.hpp>
+
+// Яркость Y = Kr*R + Kg*G + Kb*B в целых числах: веса в формате Q14 (сумма ровно 16384),
+// результат округляется. От расчета в double с отбрасыванием дробной части
+// (прежний convertToGrayscale) отличается не больше чем на 1.
+// Строка считается ядром AVX2 или SSSE3 по CPUID, иначе скалярно; строки кадра
+// распределяются по потокам OpenCV (cv::parallel_for_).
+
+enum class LumaStandard {
+    Bt601, // 0.299 R + 0.587 G + 0.114 B (SD, как cv::cvtColor)
+    Bt709  // 0.2126 R + 0.7152 G + 0.0722 B (HD)
+};
+
+// "bt601" или "bt709"; false - неизвестное имя, standard не меняется
+bool parseLumaStandard(const std::string& name, LumaStandard& standard);
+
+// Имя ядра, выбранного для этого процессора: "avx2", "ssse3" или "scalar"
+const char* grayKernelName();
+
+// Строка BGR (3 байта на пиксель) в оттенки серого
+void bgrToGrayRow(const uint8_t* bgr, uint8_t* gray, size_t pixels, LumaStandard standard);
+
+// Кадр BGR в оттенки серого; не трехканальный кадр возвращается копией
+cv::Mat convertToGrayscale(const cv::Mat& color_image, LumaStandard standard = LumaStandard::Bt601);
+
+#endif // _GRAYSCALE_H_
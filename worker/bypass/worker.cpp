@@ -2,24 +2,7 @@
 #include <thread>
 #include <chrono>
 #include "utils.h"
-
-cv::Mat convertToGrayscale(const cv::Mat& color_image) {
-    if (color_image.channels() != 3) {
-        return color_image.clone();
-    }
-    
-    cv::Mat grayscale(color_image.rows, color_image.cols, CV_8UC1);
-    
-    for (int i = 0; i < color_image.rows; i++) {
-        for (int j = 0; j < color_image.cols; j++) {
-            cv::Vec3b pixel = color_image.at<cv::Vec3b>(i, j);
-            grayscale.at<uchar>(i, j) = 
-                0.299 * pixel[2] + 0.587 * pixel[1] + 0.114 * pixel[0];
-        }
-    }
-    
-    return grayscale;
-}
+#include "grayscale.h"
 
 int main() {
     Utils worker;
@@ -29,7 +12,16 @@ int main() {
     int server_port = std::stoi(worker.getConfig("server.port"));
     std::string output_dir = worker.getConfig("worker.output_dir");
     
+    // Коэффициенты яркости: bt601 (по умолчанию) или bt709
+    LumaStandard luma = LumaStandard::Bt601;
+    std::string luma_name = worker.getConfig("worker.luma");
+    if (!luma_name.empty() && !parseLumaStandard(luma_name, luma)) {
+        std::cout << "Unknown worker.luma '" << luma_name << "', using bt601" << std::endl;
+    }
+    
     std::cout << "Worker started..." << std::endl;
+    std::cout << "Grayscale: " << (luma == LumaStandard::Bt709 ? "bt709" : "bt601")
+              << ", kernel: " << grayKernelName() << std::endl;
     
     while (true) {
         std::cout << "\n=== Worker cycle ===" << std::endl;
@@ -50,7 +42,7 @@ int main() {
                 worker.saveImage(output_dir + "worker_original.bmp");
                 
                 // 3. Обрабатываем изображение
-                cv::Mat processed_image = convertToGrayscale(original_image);
+                cv::Mat processed_image = convertToGrayscale(original_image, luma);
                 
                 // Сохраняем обработанное
                 worker.setCurrentImage(processed_image);
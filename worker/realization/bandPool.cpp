@@ -0,0 +1,84 @@
+#include "bandPool.h"
+
+BandPool::BandPool(int threads) {
+    if (threads <= 0) {
+        threads = (int)std::thread::hardware_concurrency();
+    }
+    for (int i = 1; i < threads; i++) {
+        workers.emplace_back(&BandPool::loop, this);
+    }
+}
+
+BandPool::~BandPool() {
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        stopping = true;
+    }
+    wake.notify_all();
+    for (std::thread& worker : workers) {
+        worker.join();
+    }
+}
+
+void BandPool::run(int count, const std::function<void(int)>& band_task) {
+    if (count <= 0) {
+        return;
+    }
+
+    std::unique_lock<std::mutex> lock(mutex);
+    task = &band_task;
+    bands = count;
+    next_band = 0;
+    remaining = count;
+    error = nullptr;
+    wake.notify_all();
+
+    while (runNext(lock)) {
+    }
+    finished.wait(lock, [this]() { return remaining == 0; });
+
+    task = nullptr;
+    std::exception_ptr failure = error;
+    error = nullptr;
+    lock.unlock();
+    if (failure) {
+        std::rethrow_exception(failure);
+    }
+}
+
+bool BandPool::runNext(std::unique_lock<std::mutex>& lock) {
+    if (next_band >= bands) {
+        return false;
+    }
+    int band = next_band++;
+    const std::function<void(int)>* current = task;
+
+    lock.unlock();
+    std::exception_ptr failure;
+    try {
+        (*current)(band);
+    } catch (...) {
+        failure = std::current_exception();
+    }
+    lock.lock();
+
+    if (failure && !error) {
+        error = failure;
+    }
+    if (--remaining == 0) {
+        finished.notify_all();
+    }
+    return true;
+}
+
+void BandPool::loop() {
+    std::unique_lock<std::mutex> lock(mutex);
+    while (true) {
+        wake.wait(lock, [this]() { return stopping || next_band < bands; });
+        if (stopping) {
+            return;
+        }
+        while (runNext(lock)) {
+        }
+    }
+}
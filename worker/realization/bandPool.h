@@ -0,0 +1,46 @@
+#ifndef _BAND_POOL_H_
+#define _BAND_POOL_H_
+
+#include <condition_variable>
+#include <exception>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// Постоянный пул потоков для обработки кадра полосами строк.
+// run() раздает полосы потокам пула и сам обрабатывает их вместе с ними,
+// возвращается, когда готовы все полосы. Потоки создаются один раз и ждут работы,
+// поэтому на кадр нет затрат на запуск потоков.
+class BandPool {
+public:
+    // threads - сколько потоков обрабатывают полосы, включая вызывающий; 0 - по числу ядер
+    explicit BandPool(int threads);
+    ~BandPool();
+
+    BandPool(const BandPool&) = delete;
+    BandPool& operator=(const BandPool&) = delete;
+
+    int getThreads() const { return (int)workers.size() + 1; }
+
+    // task(band) для band от 0 до count-1; исключение из задачи передается вызывающему.
+    // Вызывается из одного потока за раз
+    void run(int count, const std::function<void(int)>& task);
+
+private:
+    void loop();
+    bool runNext(std::unique_lock<std::mutex>& lock); // Берет и выполняет одну полосу
+
+    std::mutex mutex;
+    std::condition_variable wake;     // Появились полосы или остановка
+    std::condition_variable finished; // Готова последняя полоса
+    const std::function<void(int)>* task = nullptr;
+    int bands = 0;
+    int next_band = 0;
+    int remaining = 0;
+    std::exception_ptr error;
+    bool stopping = false;
+    std::vector<std::thread> workers;
+};
+
+#endif // _BAND_POOL_H_
@@ -0,0 +1,296 @@
+#include <algorithm>
+#include <functional>
+#include "effects.h"
+#include "bandPool.h"
+#include "framePool.h"
+#include "quantize.h"
+
+
+// Пастеризация в буфер вызывающего; output может совпадать с image
+void applyColorQuantization(const cv::Mat& image, cv::Mat& output, int levels) {
+    if (image.empty()) {
+        output.release();
+        return;
+    }
+
+    // Квантуются только 8-битные серые и цветные кадры, остальные копируются как есть
+    if (image.depth() != CV_8U || (image.channels() != 1 && image.channels() != 3)) {
+        if (output.data != image.data) {
+            image.copyTo(output);
+        }
+        return;
+    }
+
+    output.create(image.rows, image.cols, image.type());
+
+    // Каналы независимы: строка квантуется как сплошной массив байт
+    if (image.isContinuous() && output.isContinuous()) {
+        quantizeBytes(image.ptr<uchar>(0), output.ptr<uchar>(0), image.total() * image.elemSize(), levels);
+        return;
+    }
+    size_t row_bytes = (size_t)image.cols * image.elemSize();
+    for (int i = 0; i < image.rows; i++) {
+        quantizeBytes(image.ptr<uchar>(i), output.ptr<uchar>(i), row_bytes, levels);
+    }
+}
+
+
+// Функция для пастеризации (квантования цвета)
+cv::Mat applyColorQuantization(const cv::Mat& image, int levels) {
+    if (image.empty()) return cv::Mat();
+    
+    cv::Mat result = FramePool::instance().create(image.rows, image.cols, image.type()); // Буфер прошлого кадра из пула
+    applyColorQuantization(image, result, levels);
+    return result;
+}
+
+
+// Функция для выделения контуров
+cv::Mat applyEdgeDetection(const cv::Mat& image, int canny_low, int canny_high) {
+    if (image.empty()) return cv::Mat();
+    
+    cv::Mat grayscale, edges;
+    
+    // Если изображение цветное, конвертируем в оттенки серого
+    if (image.channels() == 3) {
+        cv::cvtColor(image, grayscale, cv::COLOR_BGR2GRAY);
+    } else {
+        grayscale = image.clone();
+    }
+    
+    // Применяем размытие для уменьшения шума
+    cv::GaussianBlur(grayscale, grayscale, cv::Size(3, 3), 0);
+    
+    // Детектор Кэнни для выделения контуров
+    cv::Canny(grayscale, edges, canny_low, canny_high);
+    
+    // Инвертируем: контуры становятся белыми (255) на чёрном фоне (0)
+    cv::bitwise_not(edges, edges);
+    
+    // Конвертируем в 3 канала для совместимости с цветным изображением
+    cv::Mat edges_bgr;
+    cv::cvtColor(edges, edges_bgr, cv::COLOR_GRAY2BGR);
+    
+    return edges_bgr;
+}
+
+
+// Кадр делится на полосы строк по числу потоков пула; без пула - одна полоса
+static void forEachBand(int rows, BandPool* pool, const std::function<void(const cv::Range&)>& body) {
+    int bands = pool ? std::min(pool->getThreads(), rows) : 1;
+    if (bands <= 1) {
+        body(cv::Range(0, rows));
+        return;
+    }
+    pool->run(bands, [&](int band) {
+        body(cv::Range(rows * band / bands, rows * (band + 1) / bands));
+    });
+}
+
+
+// Размытие 3x3 одной полосы. Полоса берется с ореолом в одну строку соседей сверху и снизу
+// и размывается как отдельное изображение (BORDER_ISOLATED); строки ореола отбрасываются.
+// На краях кадра ореола нет и граница отражается так же, как при размытии всего кадра,
+// поэтому результат совпадает с однопоточным побайтно
+static void blurBand(const cv::Mat& src, cv::Mat& dst, const cv::Range& rows) {
+    const int halo = 1;
+    cv::Range padded(std::max(rows.start - halo, 0), std::min(rows.end + halo, src.rows));
+    const int border = cv::BORDER_DEFAULT | cv::BORDER_ISOLATED;
+    if (padded.start == 0 && padded.end == src.rows) {
+        cv::GaussianBlur(src, dst, cv::Size(3, 3), 0, 0, border); // Весь кадр - одна полоса
+        return;
+    }
+    cv::Mat band = FramePool::instance().create(padded.size(), src.cols, src.type());
+    cv::GaussianBlur(src.rowRange(padded), band, cv::Size(3, 3), 0, 0, border);
+    band.rowRange(rows.start - padded.start, rows.end - padded.start).copyTo(dst.rowRange(rows));
+}
+
+
+// Маска контуров в один байт на пиксель: 255 - контур, 0 - нет
+void computeEdgeMask(const cv::Mat& image, cv::Mat& mask, int canny_low, int canny_high, BandPool* pool) {
+    cv::Mat grayscale = image; // Серый кадр размывается без копии
+    if (image.channels() == 3) {
+        grayscale = FramePool::instance().create(image.rows, image.cols, CV_8UC1);
+        forEachBand(image.rows, pool, [&](const cv::Range& rows) {
+            cv::Mat band = grayscale.rowRange(rows);
+            cv::cvtColor(image.rowRange(rows), band, cv::COLOR_BGR2GRAY);
+        });
+    }
+
+    cv::Mat blurred = FramePool::instance().create(image.rows, image.cols, CV_8UC1);
+    forEachBand(image.rows, pool, [&](const cv::Range& rows) {
+        blurBand(grayscale, blurred, rows);
+    });
+
+    // Гистерезис Кэнни прослеживает контуры через весь кадр, поэтому по полосам
+    // он дал бы другой результат; Canny распараллеливается внутри OpenCV
+    mask.create(image.rows, image.cols, CV_8UC1);
+    cv::Canny(blurred, mask, canny_low, canny_high);
+}
+
+
+// Один проход: строка квантуется в output и сразу, пока лежит в кэше, получает контуры
+void applyEffect(const cv::Mat& image, cv::Mat& output, int levels, int canny_low, int canny_high, BandPool* pool) {
+    if (image.empty()) {
+        output.release();
+        return;
+    }
+
+    if (image.depth() != CV_8U || (image.channels() != 1 && image.channels() != 3)) {
+        output = applyEffectReference(image, levels, canny_low, canny_high);
+        return;
+    }
+
+    // Маска строится до записи в output: output может совпадать с image
+    cv::Mat edges = FramePool::instance().create(image.rows, image.cols, CV_8UC1);
+    computeEdgeMask(image, edges, canny_low, canny_high, pool);
+
+    output.create(image.rows, image.cols, image.type());
+    const int channels = image.channels();
+    const size_t row_bytes = (size_t)image.cols * channels;
+    forEachBand(image.rows, pool, [&](const cv::Range& rows) {
+        for (int i = rows.start; i < rows.end; i++) {
+            uchar* out = output.ptr<uchar>(i);
+            const uchar* edge = edges.ptr<uchar>(i);
+            quantizeBytes(image.ptr<uchar>(i), out, row_bytes, levels);
+            for (int j = 0; j < image.cols; j++) {
+                if (edge[j]) {
+                    for (int ch = 0; ch < channels; ch++) {
+                        out[j * channels + ch] = 0; // Чёрный контур
+                    }
+                }
+            }
+        }
+    });
+}
+
+
+cv::Mat applyEffect(const cv::Mat& image, int levels, int canny_low, int canny_high, BandPool* pool) {
+    if (image.empty()) return cv::Mat();
+
+    cv::Mat result = FramePool::instance().create(image.rows, image.cols, image.type());
+    applyEffect(image, result, levels, canny_low, canny_high, pool);
+    return result;
+}
+
+
+// Прежняя реализация: попиксельное квантование, трёхканальная маска и второй проход.
+// Эталон для verifyEffect
+static cv::Mat applyColorQuantizationReference(const cv::Mat& image, int levels) {
+    cv::Mat result = image.clone();
+    if (image.channels() == 1) {
+        for (int i = 0; i < result.rows; i++) {
+            for (int j = 0; j < result.cols; j++) {
+                uchar pixel = result.at<uchar>(i, j);
+                result.at<uchar>(i, j) = (pixel / (256 / levels)) * (256 / levels);
+            }
+        }
+    } else if (image.channels() == 3) {
+        for (int i = 0; i < result.rows; i++) {
+            for (int j = 0; j < result.cols; j++) {
+                cv::Vec3b pixel = result.at<cv::Vec3b>(i, j);
+                for (int ch = 0; ch < 3; ch++) {
+                    pixel[ch] = (pixel[ch] / (256 / levels)) * (256 / levels);
+                }
+                result.at<cv::Vec3b>(i, j) = pixel;
+            }
+        }
+    }
+    return result;
+}
+
+
+cv::Mat applyEffectReference(const cv::Mat& image, int levels, int canny_low, int canny_high) {
+    if (image.empty()) return cv::Mat();
+    
+    cv::Mat result = applyColorQuantizationReference(image, levels);
+    if (result.type() != CV_8UC3 && result.type() != CV_8UC1) {
+        return result; // Контуры накладываются только на 8-битные серые и цветные кадры
+    }
+    cv::Mat edges_mask = applyEdgeDetection(image, canny_low, canny_high);
+    
+    // Проходим по всем пикселям
+    for (int i = 0; i < result.rows; i++) {
+        for (int j = 0; j < result.cols; j++) {
+            // Если в маске контуров пиксель чёрный (0,0,0) - делаем контур чёрным
+            cv::Vec3b edge_pixel = edges_mask.at<cv::Vec3b>(i, j);
+            if (edge_pixel[0] == 0 && edge_pixel[1] == 0 && edge_pixel[2] == 0) {
+                if (result.channels() == 3) {
+                    result.at<cv::Vec3b>(i, j) = cv::Vec3b(0, 0, 0); // Чёрный цвет
+                } else {
+                    result.at<uchar>(i, j) = 0;
+                }
+            }
+        }
+    }
+    
+    return result;
+}
+
+
+int verifyEffect(const cv::Mat& image, const cv::Mat& result, int levels, int canny_low, int canny_high) {
+    cv::Mat expected = applyEffectReference(image, levels, canny_low, canny_high);
+    if (expected.size() != result.size() || expected.type() != result.type()) {
+        return -1;
+    }
+    cv::Mat diff;
+    cv::absdiff(expected, result, diff);
+    return cv::countNonZero(diff.reshape(1));
+}
+
+
+cv::Mat combineImagesSideBySide(const cv::Mat& left_image, const cv::Mat& right_image) {
+    if (left_image.empty()) return right_image.clone();
+    if (right_image.empty()) return left_image.clone();
+    
+    cv::Mat right_resized;
+    if (left_image.rows != right_image.rows) {
+        double scale_factor = (double)left_image.rows / right_image.rows;
+        cv::resize(right_image, right_resized, 
+                   cv::Size((int)(right_image.cols * scale_factor), left_image.rows));
+    } else {
+        right_resized = right_image.clone();
+    }
+
+    int total_width = left_image.cols + right_resized.cols;
+    int height = left_image.rows;
+    
+    cv::Mat combined;
+
+    if (left_image.channels() == 3 && right_resized.channels() == 3) {
+        combined = cv::Mat(height, total_width, CV_8UC3, cv::Scalar(0, 0, 0));
+        left_image.copyTo(combined(cv::Rect(0, 0, left_image.cols, height)));
+        right_resized.copyTo(combined(cv::Rect(left_image.cols, 0, right_resized.cols, height)));
+    }
+    else if (left_image.channels() == 1 && right_resized.channels() == 1) {
+        combined = cv::Mat(height, total_width, CV_8UC1, cv::Scalar(0));
+        left_image.copyTo(combined(cv::Rect(0, 0, left_image.cols, height)));
+        right_resized.copyTo(combined(cv::Rect(left_image.cols, 0, right_resized.cols, height)));
+    }
+    else {
+        cv::Mat left_color, right_color;
+        
+        if (left_image.channels() == 1) {
+            cv::cvtColor(left_image, left_color, cv::COLOR_GRAY2BGR);
+        } else {
+            left_color = left_image.clone();
+        }
+        
+        if (right_resized.channels() == 1) {
+            cv::cvtColor(right_resized, right_color, cv::COLOR_GRAY2BGR);
+        } else {
+            right_color = right_resized.clone();
+        }
+        
+        combined = cv::Mat(height, total_width, CV_8UC3, cv::Scalar(0, 0, 0));
+        left_color.copyTo(combined(cv::Rect(0, 0, left_color.cols, height)));
+        right_color.copyTo(combined(cv::Rect(left_color.cols, 0, right_color.cols, height)));
+
+        cv::line(combined, 
+                 cv::Point(left_color.cols, 0), 
+                 cv::Point(left_color.cols, height), 
+                 cv::Scalar(0, 255, 0), 2);
+    }
+    
+    return combined;
+}
@@ -0,0 +1,44 @@
+#ifndef _EFFECTS_H_
+#define _EFFECTS_H_
+
+#include <opencv2/opencv.hpp>
+
+class BandPool;
+
+// Эффекты обработки кадра; общие для worker и однопроцессного pipeline
+
+// Функция для пастеризации (квантования цвета)
+cv::Mat applyColorQuantization(const cv::Mat& image, int levels = 8);
+
+// То же в буфер вызывающего (пересоздается при другом размере или типе);
+// output может совпадать с image. Ядро SIMD выбирается по процессору, см. quantize.h
+void applyColorQuantization(const cv::Mat& image, cv::Mat& output, int levels);
+
+// Функция для выделения контуров; пороги детектора Кэнни
+cv::Mat applyEdgeDetection(const cv::Mat& image, int canny_low = 50, int canny_high = 150);
+
+// Маска контуров в один байт на пиксель (255 - контур) вместо трёхканального изображения
+void computeEdgeMask(const cv::Mat& image, cv::Mat& mask, int canny_low, int canny_high,
+                     BandPool* pool = nullptr);
+
+// Мультипликационный эффект: пастеризация + чёрные контуры.
+// С пулом кадр обрабатывается полосами строк параллельно, результат тот же, что без пула
+cv::Mat applyEffect(const cv::Mat& image, int levels = 8, int canny_low = 50, int canny_high = 150,
+                    BandPool* pool = nullptr);
+
+// То же в буфер вызывающего за один проход по кадру: квантование и контуры пишутся
+// сразу в output, промежуточные копии кадра не создаются. output может совпадать с image
+void applyEffect(const cv::Mat& image, cv::Mat& output, int levels, int canny_low, int canny_high,
+                 BandPool* pool = nullptr);
+
+// Прежняя реализация эффекта (отдельные проходы и полноразмерные промежуточные кадры)
+cv::Mat applyEffectReference(const cv::Mat& image, int levels, int canny_low, int canny_high);
+
+// Сверка результата applyEffect с эталоном: число отличающихся байтов,
+// 0 - совпадение до пикселя, -1 - другой размер или тип
+int verifyEffect(const cv::Mat& image, const cv::Mat& result, int levels, int canny_low, int canny_high);
+
+// Склейка двух изображений по горизонтали
+cv::Mat combineImagesSideBySide(const cv::Mat& left_image, const cv::Mat& right_image);
+
+#endif // _EFFECTS_H_
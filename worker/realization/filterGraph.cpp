@@ -0,0 +1,421 @@
+#include <algorithm>
+#include <cmath>
+#include <functional>
+#include <sstream>
+#include <stdexcept>
+#include <unordered_map>
+#include "filterGraph.h"
+#include "bandPool.h"
+#include "effects.h"
+
+// ============================================================================
+// ПАРАМЕТРЫ УЗЛОВ
+// ============================================================================
+
+// Прочитанные ключи удаляются; оставшиеся после сборки узла - опечатки в конфигурации
+class NodeParams {
+public:
+    explicit NodeParams(const FilterNodeConfig& node) : name(node.name), params(node.params) {}
+
+    int getInt(const std::string& key, int default_value, int min_value, int max_value) {
+        std::string text;
+        if (!take(key, text)) {
+            return default_value;
+        }
+        size_t used = 0;
+        int value = 0;
+        try {
+            value = std::stoi(text, &used);
+        } catch (const std::exception&) {
+            used = 0;
+        }
+        if (used != text.size() || value < min_value || value > max_value) {
+            fail(key, "'" + text + "' is not an integer in [" + std::to_string(min_value) + ", "
+                          + std::to_string(max_value) + "]");
+        }
+        return value;
+    }
+
+    double getDouble(const std::string& key, double default_value, double min_value) {
+        std::string text;
+        if (!take(key, text)) {
+            return default_value;
+        }
+        size_t used = 0;
+        double value = 0;
+        try {
+            value = std::stod(text, &used);
+        } catch (const std::exception&) {
+            used = 0;
+        }
+        if (used != text.size() || !(value >= min_value)) {
+            fail(key, "'" + text + "' is not a number >= " + std::to_string(min_value));
+        }
+        return value;
+    }
+
+    std::string getString(const std::string& key, const std::string& default_value) {
+        std::string text;
+        return take(key, text) ? text : default_value;
+    }
+
+    void fail(const std::string& key, const std::string& reason) const {
+        throw std::invalid_argument("node '" + name + "' " + key + ": " + reason);
+    }
+
+    void finish() const {
+        if (!params.empty()) {
+            fail(params.begin()->first, "unknown parameter");
+        }
+    }
+
+private:
+    bool take(const std::string& key, std::string& value) {
+        auto found = params.find(key);
+        if (found == params.end()) {
+            return false;
+        }
+        value = found->second;
+        params.erase(found);
+        return true;
+    }
+
+    std::string name;
+    std::map<std::string, std::string> params;
+};
+
+// Форма результата узла относительно входного кадра: узлы с одинаковой формой
+// могут по очереди занимать один буфер, не пересоздавая его на каждом кадре
+struct NodeShape {
+    std::string channels;
+    std::string size;
+
+    bool operator==(const NodeShape& other) const {
+        return channels == other.channels && size == other.size;
+    }
+};
+
+struct BuiltNode {
+    std::function<void(const std::vector<const cv::Mat*>&, cv::Mat&)> apply;
+    size_t input_count;
+};
+
+static int parseInterpolation(NodeParams& params) {
+    std::string name = params.getString("interpolation", "linear");
+    if (name == "linear") return cv::INTER_LINEAR;
+    if (name == "nearest") return cv::INTER_NEAREST;
+    if (name == "area") return cv::INTER_AREA;
+    if (name == "cubic") return cv::INTER_CUBIC;
+    params.fail("interpolation", "unknown method '" + name + "'");
+    return cv::INTER_LINEAR;
+}
+
+// Фильтр узла по типу и параметрам; форма результата дописывается в shape
+static BuiltNode buildNode(const FilterNodeConfig& config, const std::vector<NodeShape>& inputs, NodeShape& shape) {
+    NodeParams params(config);
+    BuiltNode node;
+    node.input_count = 1;
+    const NodeShape input = inputs.empty() ? NodeShape() : inputs[0];
+
+    if (config.type == "grayscale") {
+        node.apply = [](const std::vector<const cv::Mat*>& in, cv::Mat& out) {
+            const cv::Mat& image = *in[0];
+            if (image.channels() == 3) {
+                cv::cvtColor(image, out, cv::COLOR_BGR2GRAY);
+            } else if (image.channels() == 4) {
+                cv::cvtColor(image, out, cv::COLOR_BGRA2GRAY);
+            } else {
+                image.copyTo(out);
+            }
+        };
+        shape = NodeShape{"1", input.size};
+    } else if (config.type == "blur") {
+        int ksize = params.getInt("ksize", 3, 1, 31);
+        double sigma = params.getDouble("sigma", 0, 0);
+        if (ksize % 2 == 0) {
+            params.fail("ksize", "must be odd");
+        }
+        node.apply = [ksize, sigma](const std::vector<const cv::Mat*>& in, cv::Mat& out) {
+            cv::GaussianBlur(*in[0], out, cv::Size(ksize, ksize), sigma);
+        };
+        shape = input;
+    } else if (config.type == "canny") {
+        int low = params.getInt("low", 50, 0, 1000);
+        int high = params.getInt("high", 150, 0, 1000);
+        node.apply = [low, high, gray = cv::Mat()](const std::vector<const cv::Mat*>& in, cv::Mat& out) mutable {
+            const cv::Mat* image = in[0];
+            if (image->channels() == 3) {
+                cv::cvtColor(*image, gray, cv::COLOR_BGR2GRAY);
+                image = &gray;
+            }
+            cv::Canny(*image, out, low, high);
+        };
+        shape = NodeShape{"1", input.size};
+    } else if (config.type == "quantize") {
+        int levels = params.getInt("levels", 8, 1, 256);
+        node.apply = [levels](const std::vector<const cv::Mat*>& in, cv::Mat& out) {
+            applyColorQuantization(*in[0], out, levels);
+        };
+        shape = input;
+    } else if (config.type == "compose") {
+        std::string mode = params.getString("mode", "overlay");
+        node.input_count = 2;
+        if (mode == "overlay") {
+            // Маска любой формы приводится к одному каналу и размеру изображения
+            node.apply = [gray = cv::Mat(), scaled = cv::Mat()](const std::vector<const cv::Mat*>& in,
+                                                                   cv::Mat& out) mutable {
+                const cv::Mat& image = *in[0];
+                const cv::Mat* mask = in[1];
+                if (mask->channels() != 1) {
+                    cv::cvtColor(*mask, gray, mask->channels() == 4 ? cv::COLOR_BGRA2GRAY : cv::COLOR_BGR2GRAY);
+                    mask = &gray;
+                }
+                if (mask->size() != image.size()) {
+                    cv::resize(*mask, scaled, image.size(), 0, 0, cv::INTER_NEAREST);
+                    mask = &scaled;
+                }
+                image.copyTo(out);
+                out.setTo(cv::Scalar::all(0), *mask); // Чёрный контур
+            };
+            shape = input;
+        } else if (mode == "side_by_side") {
+            node.apply = [](const std::vector<const cv::Mat*>& in, cv::Mat& out) {
+                out = combineImagesSideBySide(*in[0], *in[1]);
+            };
+            shape = NodeShape{config.name, config.name}; // Своя форма, буфер не делится
+        } else {
+            params.fail("mode", "unknown mode '" + mode + "'");
+        }
+    } else if (config.type == "resize") {
+        int width = params.getInt("width", 0, 0, 16384);
+        int height = params.getInt("height", 0, 0, 16384);
+        double scale = params.getDouble("scale", 0, 0);
+        int interpolation = parseInterpolation(params);
+        if ((scale > 0) == (width > 0 || height > 0)) {
+            params.fail("scale", "set either scale or width/height");
+        }
+        node.apply = [width, height, scale, interpolation](const std::vector<const cv::Mat*>& in, cv::Mat& out) {
+            const cv::Mat& image = *in[0];
+            cv::Size size(width, height);
+            if (scale > 0) {
+                size = cv::Size((int)std::lround(image.cols * scale), (int)std::lround(image.rows * scale));
+            } else if (width == 0) {
+                size.width = (int)std::lround((double)image.cols * height / image.rows); // Сохраняем пропорции
+            } else if (height == 0) {
+                size.height = (int)std::lround((double)image.rows * width / image.cols);
+            }
+            cv::resize(image, out, cv::Size(std::max(size.width, 1), std::max(size.height, 1)), 0, 0, interpolation);
+        };
+        std::ostringstream key;
+        key << input.size << "/" << width << "x" << height << "*" << scale;
+        shape = NodeShape{input.channels, key.str()};
+    } else {
+        throw std::invalid_argument("node '" + config.name + "': unknown type '" + config.type + "'");
+    }
+
+    params.finish();
+    if (config.inputs.size() != node.input_count) {
+        throw std::invalid_argument("node '" + config.name + "' (" + config.type + ") needs "
+                                    + std::to_string(node.input_count) + " input(s), got "
+                                    + std::to_string(config.inputs.size()));
+    }
+    return node;
+}
+
+// ============================================================================
+// СБОРКА
+// ============================================================================
+
+bool FilterGraph::configure(const FilterGraphConfig& config, std::string& error) {
+    if (config == attempted) {
+        error = attempted_error;
+        return attempted_ok;
+    }
+    attempted = config;
+    attempted_ok = false;
+
+    try {
+        const size_t count = config.nodes.size();
+        std::unordered_map<std::string, int> by_name;
+        for (size_t i = 0; i < count; i++) {
+            const std::string& name = config.nodes[i].name;
+            if (name.empty() || name == "source") {
+                throw std::invalid_argument("node " + std::to_string(i) + ": name is empty or reserved");
+            }
+            if (!by_name.emplace(name, (int)i).second) {
+                throw std::invalid_argument("node '" + name + "' is declared twice");
+            }
+        }
+
+        // Входы по именам; -1 - входной кадр
+        std::vector<std::vector<int>> inputs(count);
+        for (size_t i = 0; i < count; i++) {
+            for (const std::string& input : config.nodes[i].inputs) {
+                if (input == "source") {
+                    inputs[i].push_back(-1);
+                    continue;
+                }
+                auto found = by_name.find(input);
+                if (found == by_name.end()) {
+                    throw std::invalid_argument("node '" + config.nodes[i].name + "': unknown input '" + input + "'");
+                }
+                inputs[i].push_back(found->second);
+            }
+        }
+
+        int result = -1;
+        if (count > 0) {
+            std::string output = config.output.empty() ? config.nodes.back().name : config.output;
+            auto found = by_name.find(output);
+            if (found == by_name.end()) {
+                throw std::invalid_argument("output node '" + output + "' is not declared");
+            }
+            result = found->second;
+        }
+
+        // Топологический порядок узлов, от которых зависит результат; цикл - ошибка
+        std::vector<int> state(count, 0), order;
+        std::function<void(int)> visit = [&](int i) {
+            if (state[i] == 2) return;
+            if (state[i] == 1) {
+                throw std::invalid_argument("cycle through node '" + config.nodes[i].name + "'");
+            }
+            state[i] = 1;
+            for (int input : inputs[i]) {
+                if (input >= 0) visit(input);
+            }
+            state[i] = 2;
+            order.push_back(i);
+        };
+        if (result >= 0) {
+            visit(result);
+        }
+
+        // Узлы в порядке выполнения, формы и уровни
+        std::vector<int> index(count, -1);
+        std::vector<Node> built;
+        std::vector<NodeShape> shapes;
+        std::vector<int> level_of;
+        std::vector<std::vector<int>> built_levels;
+        for (int original : order) {
+            Node node;
+            node.name = config.nodes[original].name;
+            std::vector<NodeShape> input_shapes;
+            int level = 0;
+            for (int input : inputs[original]) {
+                node.inputs.push_back(input < 0 ? -1 : index[input]);
+                input_shapes.push_back(input < 0 ? NodeShape{"src", "src"} : shapes[index[input]]);
+                if (input >= 0) {
+                    level = std::max(level, level_of[index[input]] + 1);
+                }
+            }
+            NodeShape shape;
+            node.apply = buildNode(config.nodes[original], input_shapes, shape).apply;
+
+            index[original] = (int)built.size();
+            built.push_back(node);
+            shapes.push_back(shape);
+            level_of.push_back(level);
+            if ((int)built_levels.size() <= level) {
+                built_levels.resize(level + 1);
+            }
+            built_levels[level].push_back(index[original]);
+        }
+        int built_output = result >= 0 ? index[result] : -1;
+
+        // Буферы по времени жизни: после уровня последнего потребителя буфер свободен.
+        // Буферы уровня выдаются до освобождения: узлы уровня читают входы параллельно
+        std::vector<int> last_use(level_of);
+        for (size_t i = 0; i < built.size(); i++) {
+            for (int input : built[i].inputs) {
+                if (input >= 0) last_use[input] = std::max(last_use[input], level_of[i]);
+            }
+        }
+        std::vector<NodeShape> buffer_shapes;
+        std::vector<int> free_buffers;
+        for (size_t level = 0; level < built_levels.size(); level++) {
+            for (int i : built_levels[level]) {
+                if (i == built_output) continue;
+                auto reuse = std::find_if(free_buffers.begin(), free_buffers.end(),
+                                          [&](int buffer) { return buffer_shapes[buffer] == shapes[i]; });
+                if (reuse != free_buffers.end()) {
+                    built[i].buffer = *reuse;
+                    free_buffers.erase(reuse);
+                } else {
+                    built[i].buffer = (int)buffer_shapes.size();
+                    buffer_shapes.push_back(shapes[i]);
+                }
+            }
+            for (size_t i = 0; i < built.size(); i++) {
+                if (built[i].buffer >= 0 && last_use[i] == (int)level) {
+                    free_buffers.push_back(built[i].buffer);
+                }
+            }
+        }
+
+        nodes.swap(built);
+        levels.swap(built_levels);
+        buffers.assign(buffer_shapes.size(), cv::Mat());
+        output_node = built_output;
+        applied = config;
+        attempted_ok = true;
+        attempted_error.clear();
+        error.clear();
+        return true;
+    } catch (const std::exception& e) {
+        attempted_error = e.what();
+        error = attempted_error;
+        return false;
+    }
+}
+
+// ============================================================================
+// ВЫПОЛНЕНИЕ
+// ============================================================================
+
+void FilterGraph::run(const cv::Mat& source, cv::Mat& output, BandPool* pool) {
+    cv::Mat result; // Новый на каждый кадр: вызывающий может держать прошлые результаты
+    auto resultOf = [&](int index) -> cv::Mat& {
+        return index == output_node ? result : buffers[nodes[index].buffer];
+    };
+
+    for (const std::vector<int>& level : levels) {
+        auto step = [&](int k) {
+            const Node& node = nodes[level[k]];
+            std::vector<const cv::Mat*> inputs;
+            for (int input : node.inputs) {
+                inputs.push_back(input < 0 ? &source : &resultOf(input));
+            }
+            node.apply(inputs, resultOf(level[k]));
+        };
+        if (pool && level.size() > 1) {
+            pool->run((int)level.size(), step);
+        } else {
+            for (size_t k = 0; k < level.size(); k++) {
+                step((int)k);
+            }
+        }
+    }
+
+    output = result;
+}
+
+std::string FilterGraph::describe() const {
+    if (nodes.empty()) {
+        return "built-in effect";
+    }
+
+    std::ostringstream text;
+    text << nodes.size() << " nodes, " << levels.size() << " levels, " << buffers.size() << " buffers:";
+    for (size_t level = 0; level < levels.size(); level++) {
+        text << (level == 0 ? " [" : " -> [");
+        for (size_t k = 0; k < levels[level].size(); k++) {
+            text << (k ? " " : "") << nodes[levels[level][k]].name;
+        }
+        text << "]";
+    }
+    if (nodes.size() < applied.nodes.size()) {
+        text << " (" << applied.nodes.size() - nodes.size() << " unused nodes skipped)";
+    }
+    return text.str();
+}
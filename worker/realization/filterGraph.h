@@ -0,0 +1,64 @@
+#ifndef _FILTER_GRAPH_H_
+#define _FILTER_GRAPH_H_
+
+#include <functional>
+#include <string>
+#include <vector>
+#include <opencv2/opencv.hpp>
+
+#include "configSnapshot.h"
+
+class BandPool;
+
+// Граф фильтров из config.yaml (секция graph у worker и pipeline).
+//
+// Узлы:
+//   grayscale                          BGR -> оттенки серого
+//   blur      ksize=3 sigma=0          размытие по Гауссу
+//   canny     low=50 high=150          маска контуров, 255 - контур (цветной вход переводится в серый)
+//   quantize  levels=8                 пастеризация
+//   compose   mode=overlay             два входа: изображение и маска, контуры маски закрашиваются черным
+//             mode=side_by_side        два входа рядом по горизонтали
+//   resize    width/height или scale, interpolation=linear|nearest|area|cubic
+//
+// Граф собирается в расписание по уровням: узлы одного уровня не зависят друг от друга
+// и выполняются параллельно. Промежуточные буферы распределяются по времени жизни -
+// узел получает буфер, который больше никому не нужен и имеет ту же форму кадра,
+// и буферы живут между кадрами, поэтому в установившемся режиме память не выделяется.
+class FilterGraph {
+public:
+    // Сборка графа; false - ошибка в описании (причина в error), прежний граф остается.
+    // Повторный вызов с тем же описанием ничего не делает
+    bool configure(const FilterGraphConfig& config, std::string& error);
+
+    // Граф не задан - используется встроенный эффект
+    bool empty() const { return nodes.empty(); }
+
+    // Прогон кадра; pool - параллельные ветви одного уровня (nullptr - по очереди)
+    void run(const cv::Mat& source, cv::Mat& output, BandPool* pool = nullptr);
+
+    // Расписание по уровням и число буферов - для вывода при запуске
+    std::string describe() const;
+
+private:
+    typedef std::function<void(const std::vector<const cv::Mat*>&, cv::Mat&)> Filter;
+
+    struct Node {
+        std::string name;
+        Filter apply;
+        std::vector<int> inputs; // индексы узлов, -1 - входной кадр
+        int buffer = -1;         // -1 - узел-результат, пишет в output
+    };
+
+    std::vector<Node> nodes;               // только узлы, от которых зависит результат
+    std::vector<std::vector<int>> levels;  // уровни расписания
+    std::vector<cv::Mat> buffers;          // промежуточные кадры, переживают кадр
+    int output_node = -1;
+
+    FilterGraphConfig applied;   // описание собранного графа
+    FilterGraphConfig attempted; // последнее описание, переданное в configure
+    bool attempted_ok = true;
+    std::string attempted_error;
+};
+
+#endif // _FILTER_GRAPH_H_
@@ -0,0 +1,218 @@
+#include "quantize.h"
+
+#include <algorithm>
+#include <atomic>
+
+#if defined(__x86_64__) || defined(_M_X64) || defined(__i386__) || defined(_M_IX86)
+#define QUANTIZE_X86 1
+#include <immintrin.h>
+#if defined(_MSC_VER) && !defined(__clang__)
+#include <intrin.h>
+#endif
+#endif
+
+// GCC и Clang собирают векторные функции без -mavx2 для всего файла;
+// MSVC разрешает любые intrinsics и так
+#if defined(__GNUC__) || defined(__clang__)
+#define QUANTIZE_TARGET(isa) __attribute__((target(isa)))
+#else
+#define QUANTIZE_TARGET(isa)
+#endif
+
+// ============================================================================
+// ТАБЛИЦЫ
+// ============================================================================
+
+struct QuantizationLevel {
+    uint8_t lut[256];
+    uint16_t step;       // 256 / levels
+    uint16_t multiplier; // ceil(65536 / step): v / step == (v * multiplier) >> 16 для всех байтов
+    bool exact;          // умножение проверено по таблице; иначе только таблица
+};
+
+struct QuantizationTables {
+    QuantizationLevel levels[257]; // индекс - levels, 0 не используется
+
+    QuantizationTables() {
+        for (int l = 1; l <= 256; l++) {
+            QuantizationLevel& level = levels[l];
+            level.step = (uint16_t)(256 / l);
+            level.multiplier = level.step > 1 ? (uint16_t)((65536 + level.step - 1) / level.step) : 0;
+            level.exact = level.step > 1;
+            for (int v = 0; v < 256; v++) {
+                level.lut[v] = (uint8_t)(v / level.step * level.step);
+                if (level.step > 1 && ((uint32_t)v * level.multiplier >> 16) * level.step != level.lut[v]) {
+                    level.exact = false;
+                }
+            }
+        }
+    }
+};
+
+static const QuantizationLevel& quantizationLevel(int levels) {
+    static const QuantizationTables tables; // Строится один раз, потокобезопасно
+    return tables.levels[std::min(std::max(levels, 1), 256)];
+}
+
+const uint8_t* quantizationLut(int levels) {
+    return quantizationLevel(levels).lut;
+}
+
+// ============================================================================
+// ЯДРА
+// ============================================================================
+
+static void quantizeScalar(const uint8_t* src, uint8_t* dst, size_t count, const QuantizationLevel& level) {
+    const uint8_t* lut = level.lut;
+    for (size_t i = 0; i < count; i++) {
+        dst[i] = lut[src[i]];
+    }
+}
+
+#ifdef QUANTIZE_X86
+// Байты расширяются до 16 бит, делятся умножением и собираются обратно.
+// unpack и packus работают внутри 128-битных половин, поэтому порядок байтов сохраняется
+
+QUANTIZE_TARGET("sse2")
+static size_t quantizeSse2(const uint8_t* src, uint8_t* dst, size_t count, const QuantizationLevel& level) {
+    const __m128i zero = _mm_setzero_si128();
+    const __m128i m = _mm_set1_epi16((short)level.multiplier);
+    const __m128i step = _mm_set1_epi16((short)level.step);
+    size_t i = 0;
+    for (; i + 16 <= count; i += 16) {
+        __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i*>(src + i));
+        __m128i lo = _mm_mullo_epi16(_mm_mulhi_epu16(_mm_unpacklo_epi8(v, zero), m), step);
+        __m128i hi = _mm_mullo_epi16(_mm_mulhi_epu16(_mm_unpackhi_epi8(v, zero), m), step);
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(dst + i), _mm_packus_epi16(lo, hi));
+    }
+    return i;
+}
+
+QUANTIZE_TARGET("avx2")
+static size_t quantizeAvx2(const uint8_t* src, uint8_t* dst, size_t count, const QuantizationLevel& level) {
+    const __m256i zero = _mm256_setzero_si256();
+    const __m256i m = _mm256_set1_epi16((short)level.multiplier);
+    const __m256i step = _mm256_set1_epi16((short)level.step);
+    size_t i = 0;
+    for (; i + 32 <= count; i += 32) {
+        __m256i v = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(src + i));
+        __m256i lo = _mm256_mullo_epi16(_mm256_mulhi_epu16(_mm256_unpacklo_epi8(v, zero), m), step);
+        __m256i hi = _mm256_mullo_epi16(_mm256_mulhi_epu16(_mm256_unpackhi_epi8(v, zero), m), step);
+        _mm256_storeu_si256(reinterpret_cast<__m256i*>(dst + i), _mm256_packus_epi16(lo, hi));
+    }
+    return i;
+}
+
+QUANTIZE_TARGET("avx512f,avx512bw")
+static size_t quantizeAvx512(const uint8_t* src, uint8_t* dst, size_t count, const QuantizationLevel& level) {
+    const __m512i zero = _mm512_setzero_si512();
+    const __m512i m = _mm512_set1_epi16((short)level.multiplier);
+    const __m512i step = _mm512_set1_epi16((short)level.step);
+    size_t i = 0;
+    for (; i + 64 <= count; i += 64) {
+        __m512i v = _mm512_loadu_si512(src + i);
+        __m512i lo = _mm512_mullo_epi16(_mm512_mulhi_epu16(_mm512_unpacklo_epi8(v, zero), m), step);
+        __m512i hi = _mm512_mullo_epi16(_mm512_mulhi_epu16(_mm512_unpackhi_epi8(v, zero), m), step);
+        _mm512_storeu_si512(dst + i, _mm512_packus_epi16(lo, hi));
+    }
+    return i;
+}
+#endif
+
+// ============================================================================
+// ВЫБОР ЯДРА
+// ============================================================================
+
+const char* quantizeKernelName(QuantizeKernel kernel) {
+    switch (kernel) {
+    case QuantizeKernel::Scalar:
+        return "scalar";
+    case QuantizeKernel::Sse2:
+        return "sse2";
+    case QuantizeKernel::Avx2:
+        return "avx2";
+    case QuantizeKernel::Avx512:
+        return "avx512";
+    }
+    return "unknown";
+}
+
+QuantizeKernel detectQuantizeKernel() {
+#if defined(QUANTIZE_X86) && (defined(__GNUC__) || defined(__clang__))
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx512bw")) {
+        return QuantizeKernel::Avx512;
+    }
+    if (__builtin_cpu_supports("avx2")) {
+        return QuantizeKernel::Avx2;
+    }
+    if (__builtin_cpu_supports("sse2")) {
+        return QuantizeKernel::Sse2;
+    }
+#elif defined(QUANTIZE_X86) && defined(_MSC_VER)
+    int info[4];
+    __cpuid(info, 0);
+    int max_leaf = info[0];
+    __cpuid(info, 1);
+    bool sse2 = (info[3] & (1 << 26)) != 0;
+    // Регистры AVX должны сохраняться ОС (OSXSAVE + XCR0)
+    bool os_avx = (info[2] & (1 << 27)) != 0 && (_xgetbv(0) & 0x6) == 0x6;
+    bool os_avx512 = os_avx && (_xgetbv(0) & 0xE6) == 0xE6;
+    if (max_leaf >= 7) {
+        __cpuidex(info, 7, 0);
+        if (os_avx512 && (info[1] & (1 << 16)) && (info[1] & (1 << 30))) {
+            return QuantizeKernel::Avx512;
+        }
+        if (os_avx && (info[1] & (1 << 5))) {
+            return QuantizeKernel::Avx2;
+        }
+    }
+    if (sse2) {
+        return QuantizeKernel::Sse2;
+    }
+#endif
+    return QuantizeKernel::Scalar;
+}
+
+static std::atomic<QuantizeKernel>& currentKernel() {
+    static std::atomic<QuantizeKernel> kernel(detectQuantizeKernel());
+    return kernel;
+}
+
+QuantizeKernel getQuantizeKernel() {
+    return currentKernel().load(std::memory_order_relaxed);
+}
+
+bool setQuantizeKernel(QuantizeKernel kernel) {
+    if (kernel > detectQuantizeKernel()) {
+        return false;
+    }
+    currentKernel().store(kernel, std::memory_order_relaxed);
+    return true;
+}
+
+void quantizeBytes(const uint8_t* src, uint8_t* dst, size_t count, int levels) {
+    const QuantizationLevel& level = quantizationLevel(levels);
+    size_t done = 0;
+
+#ifdef QUANTIZE_X86
+    if (level.exact) {
+        switch (getQuantizeKernel()) {
+        case QuantizeKernel::Avx512:
+            done = quantizeAvx512(src, dst, count, level);
+            break;
+        case QuantizeKernel::Avx2:
+            done = quantizeAvx2(src, dst, count, level);
+            break;
+        case QuantizeKernel::Sse2:
+            done = quantizeSse2(src, dst, count, level);
+            break;
+        case QuantizeKernel::Scalar:
+            break;
+        }
+    }
+#endif
+
+    // Хвост строки и шаг 1 (levels = 256, таблица - тождество)
+    quantizeScalar(src + done, dst + done, count - done, level);
+}
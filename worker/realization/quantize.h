@@ -0,0 +1,35 @@
+#ifndef _QUANTIZE_H_
+#define _QUANTIZE_H_
+
+#include <cstddef>
+#include <cstdint>
+
+// Квантование яркости канала: v -> (v / step) * step, step = 256 / levels.
+// Для каждого levels таблица на 256 значений строится один раз; векторные ядра
+// считают то же самое умножением (v * m) >> 16, результат совпадает с таблицей побайтно.
+// Ядро выбирается при первом вызове по CPUID: AVX-512BW, AVX2, SSE2, иначе таблица.
+
+enum class QuantizeKernel {
+    Scalar, // таблица, любой процессор
+    Sse2,
+    Avx2,
+    Avx512
+};
+
+const char* quantizeKernelName(QuantizeKernel kernel);
+
+// Лучшее ядро, поддерживаемое процессором
+QuantizeKernel detectQuantizeKernel();
+
+// Текущее ядро; setQuantizeKernel - принудительный выбор (сравнение и замеры),
+// false - процессор его не поддерживает
+QuantizeKernel getQuantizeKernel();
+bool setQuantizeKernel(QuantizeKernel kernel);
+
+// Таблица квантования для levels (1..256, вне диапазона - ближайшее допустимое)
+const uint8_t* quantizationLut(int levels);
+
+// Квантование count байт; src и dst могут совпадать
+void quantizeBytes(const uint8_t* src, uint8_t* dst, size_t count, int levels);
+
+#endif // _QUANTIZE_H_
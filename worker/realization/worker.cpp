@@ -2,232 +2,155 @@
 #include <thread>
 #include <chrono>
 #include "utils.h"
+#include "effects.h"
+#include "bandPool.h"
+#include "filterGraph.h"
+#include "metrics.h"
+#include "frameTrace.h"
+#include "quantize.h"
 
-
-// Функция для пастеризации (квантования цвета)
-cv::Mat applyColorQuantization(const cv::Mat& image, int levels = 8) {
-    if (image.empty()) return cv::Mat();
-    
-    cv::Mat result = image.clone();
-    
-    // Если изображение уже в оттенках серого
-    if (image.channels() == 1) {
-        for (int i = 0; i < result.rows; i++) {
-            for (int j = 0; j < result.cols; j++) {
-                uchar pixel = result.at<uchar>(i, j);
-                // Квантование для градаций серого
-                uchar new_value = (pixel / (256 / levels)) * (256 / levels);
-                result.at<uchar>(i, j) = new_value;
-            }
-        }
-    } 
-    // Если цветное изображение (3 канала)
-    else if (image.channels() == 3) {
-        for (int i = 0; i < result.rows; i++) {
-            for (int j = 0; j < result.cols; j++) {
-                cv::Vec3b pixel = result.at<cv::Vec3b>(i, j);
-                // Квантование для каждого цветового канала
-                for (int ch = 0; ch < 3; ch++) {
-                    pixel[ch] = (pixel[ch] / (256 / levels)) * (256 / levels);
-                }
-                result.at<cv::Vec3b>(i, j) = pixel;
-            }
-        }
-    }
+int main() {
+    Utils worker;
+    worker.loadConfig();
     
-    return result;
-}
+    std::shared_ptr<const ConfigSnapshot> settings = worker.getConfigSnapshot();
 
+    // Параметры эффекта можно менять без перезапуска: правкой файла или через канал управления
+    worker.watchConfig();
+    worker.startControl(settings->worker.control_port);
+    worker.startMetrics("worker", settings->worker.metrics_port, settings->worker.metrics_file);
 
-// Функция для выделения контуров
-cv::Mat applyEdgeDetection(const cv::Mat& image) {
-    if (image.empty()) return cv::Mat();
-    
-    cv::Mat grayscale, edges;
-    
-    // Если изображение цветное, конвертируем в оттенки серого
-    if (image.channels() == 3) {
-        cv::cvtColor(image, grayscale, cv::COLOR_BGR2GRAY);
-    } else {
-        grayscale = image.clone();
-    }
-    
-    // Применяем размытие для уменьшения шума
-    cv::GaussianBlur(grayscale, grayscale, cv::Size(3, 3), 0);
-    
-    // Детектор Кэнни для выделения контуров
-    cv::Canny(grayscale, edges, 50, 150);
-    
-    // Инвертируем: контуры становятся белыми (255) на чёрном фоне (0)
-    cv::bitwise_not(edges, edges);
-    
-    // Конвертируем в 3 канала для совместимости с цветным изображением
-    cv::Mat edges_bgr;
-    cv::cvtColor(edges, edges_bgr, cv::COLOR_GRAY2BGR);
-    
-    return edges_bgr;
-}
-
+    Counter& processed_frames = MetricsRegistry::instance().counter("worker_frames_total");
+    Counter& effect_mismatches = MetricsRegistry::instance().counter("worker_effect_mismatch_total");
+    LatencyHistogram& process_time = MetricsRegistry::instance().histogram("worker_process_us");
 
-cv::Mat applyEffect(const cv::Mat& image, int levels = 8) {
-    if (image.empty()) return cv::Mat();
+    std::string server_ip = settings->server.ip;
+    int server_port = settings->server.port;
+    std::string output_dir = settings->worker.output_dir;
     
-    cv::Mat eff = applyColorQuantization(image, levels);
-    cv::Mat edges_mask = applyEdgeDetection(image);
-    cv::Mat result = eff.clone();
+    std::cout << "1 Real Worker started..." << std::endl;
+    std::cout << "Server: " << server_ip << ":" << server_port << std::endl;
+    std::cout << "Output directory: " << output_dir << std::endl;
+    std::cout << "Quantization kernel: " << quantizeKernelName(getQuantizeKernel()) << std::endl;
     
-    // Проходим по всем пикселям
-    for (int i = 0; i < result.rows; i++) {
-        for (int j = 0; j < result.cols; j++) {
-            // Если в маске контуров пиксель чёрный (0,0,0) - делаем контур чёрным
-            cv::Vec3b edge_pixel = edges_mask.at<cv::Vec3b>(i, j);
-            if (edge_pixel[0] == 0 && edge_pixel[1] == 0 && edge_pixel[2] == 0) {
-                result.at<cv::Vec3b>(i, j) = cv::Vec3b(0, 0, 0); // Чёрный цвет
-            }
-        }
-    }
+    // Потоки обработки кадра полосами; число потоков читается один раз при запуске
+    BandPool effect_pool(settings->worker.effect_threads);
+    std::cout << "Effect threads: " << effect_pool.getThreads() << std::endl;
     
-    return result;
-}
-
+    // Граф фильтров из конфигурации; пустой - встроенный эффект
+    FilterGraph graph;
+    uint64_t graph_version = 0;
 
-cv::Mat combineImagesSideBySide(const cv::Mat& left_image, const cv::Mat& right_image) {
-    if (left_image.empty()) return right_image.clone();
-    if (right_image.empty()) return left_image.clone();
-    
-    cv::Mat right_resized;
-    if (left_image.rows != right_image.rows) {
-        double scale_factor = (double)left_image.rows / right_image.rows;
-        cv::resize(right_image, right_resized, 
-                   cv::Size((int)(right_image.cols * scale_factor), left_image.rows));
-    } else {
-        right_resized = right_image.clone();
+    // Соединение с сервером одно на все циклы: heartbeat обнаруживает обрыв, ZeroMQ переподключается сам
+    if (!worker.initializeClient(server_ip, server_port)) {
+        return -1;
     }
-
-    int total_width = left_image.cols + right_resized.cols;
-    int height = left_image.rows;
     
-    cv::Mat combined;
-
-    if (left_image.channels() == 3 && right_resized.channels() == 3) {
-        combined = cv::Mat(height, total_width, CV_8UC3, cv::Scalar(0, 0, 0));
-        left_image.copyTo(combined(cv::Rect(0, 0, left_image.cols, height)));
-        right_resized.copyTo(combined(cv::Rect(left_image.cols, 0, right_resized.cols, height)));
-    }
-    else if (left_image.channels() == 1 && right_resized.channels() == 1) {
-        combined = cv::Mat(height, total_width, CV_8UC1, cv::Scalar(0));
-        left_image.copyTo(combined(cv::Rect(0, 0, left_image.cols, height)));
-        right_resized.copyTo(combined(cv::Rect(left_image.cols, 0, right_resized.cols, height)));
-    }
-    else {
-        cv::Mat left_color, right_color;
-        
-        if (left_image.channels() == 1) {
-            cv::cvtColor(left_image, left_color, cv::COLOR_GRAY2BGR);
-        } else {
-            left_color = left_image.clone();
-        }
+    while (true) {
+        std::cout << "\n=== Worker cycle ===" << std::endl;
         
-        if (right_resized.channels() == 1) {
-            cv::cvtColor(right_resized, right_color, cv::COLOR_GRAY2BGR);
-        } else {
-            right_color = right_resized.clone();
+        if (worker.getConnectionState() != ConnectionState::Connected) {
+            std::cout << "Waiting for server connection..." << std::endl;
         }
-        
-        combined = cv::Mat(height, total_width, CV_8UC3, cv::Scalar(0, 0, 0));
-        left_color.copyTo(combined(cv::Rect(0, 0, left_color.cols, height)));
-        right_color.copyTo(combined(cv::Rect(left_color.cols, 0, right_color.cols, height)));
 
-        cv::line(combined, 
-                 cv::Point(left_color.cols, 0), 
-                 cv::Point(left_color.cols, height), 
-                 cv::Scalar(0, 255, 0), 2);
-    }
-    
-    return combined;
-}
-
-int main() {
-    Utils worker;
-    worker.loadConfig();
-    
-    std::string server_ip = worker.getConfig("server.ip");
-    int server_port = std::stoi(worker.getConfig("server.port"));
-    std::string output_dir = worker.getConfig("worker.output_dir");
-    
-    std::cout << "1 Real Worker started..." << std::endl;
-    std::cout << "Server: " << server_ip << ":" << server_port << std::endl;
-    std::cout << "Output directory: " << output_dir << std::endl;
-    
-    // Параметр для пастеризации (количество уровней цвета)
-    int quantization_levels = 4;
-    
-    while (true) {
-        std::cout << "\n=== Worker cycle ===" << std::endl;
+        // 1. Запрашиваем работу
+        worker.sendMessage("READY");
+        std::cout << "Sent READY to server" << std::endl;
         
-        // Подключаемся к серверу
-        if (worker.initializeClient(server_ip, server_port)) {
-            // 1. Запрашиваем работу
-            worker.sendMessage("READY");
-            std::cout << "Sent READY to server" << std::endl;
+        // 2. Получаем изображение от сервера
+        cv::Mat original_image = worker.receiveImage();
+        uint64_t received_us = traceNowUs();
+        FrameTrace trace = worker.getLastTrace(); // Пустая, если сервер не трассирует кадры
+        if (!original_image.empty()) {
+            std::cout << "Image received from server: " 
+                      << original_image.cols << "x" << original_image.rows 
+                      << ", channels: " << original_image.channels() << std::endl;
             
-            // 2. Получаем изображение от сервера
-            cv::Mat original_image = worker.receiveImage();
-            if (!original_image.empty()) {
-                std::cout << "Image received from server: " 
-                          << original_image.cols << "x" << original_image.rows 
-                          << ", channels: " << original_image.channels() << std::endl;
-                
-                // Сохраняем оригинал
-                worker.setCurrentImage(original_image);
-                std::string original_path = output_dir + "worker_original.bmp";
-                worker.saveImage(original_path);
-                std::cout << "Original saved: " << original_path << std::endl;
-                
-                // 3. Обрабатываем изображение: мультипликационный эффект
+            // Сохраняем оригинал (без копии в текущее изображение Utils)
+            std::string original_path = output_dir + "worker_original.bmp";
+            worker.saveImage(original_image, original_path);
+            std::cout << "Original saved: " << original_path << std::endl;
+            
+            // 3. Обрабатываем изображение: мультипликационный эффект
+            // Параметры эффекта берутся из текущего снимка конфигурации
+            std::shared_ptr<const ConfigSnapshot> current = worker.getConfigSnapshot();
+            const WorkerConfig& effect = current->worker;
+            if (current->version != graph_version) {
+                graph_version = current->version;
+                std::string error;
+                if (graph.configure(effect.graph, error)) {
+                    std::cout << "Filter graph: " << graph.describe() << std::endl;
+                } else {
+                    std::cout << "- [FAIL] Filter graph: " << error << ", keeping " << graph.describe() << std::endl;
+                }
+            }
+            if (graph.empty()) {
                 std::cout << "Applying cartoon effect (quantization + edges)..." << std::endl;
-                std::cout << "Quantization levels: " << quantization_levels << std::endl;
-                
-                cv::Mat processed_image = applyEffect(original_image, quantization_levels);
-                
-                std::cout << "Processing completed. Result: " 
-                          << processed_image.cols << "x" << processed_image.rows 
-                          << ", channels: " << processed_image.channels() << std::endl;
-                
-                // Сохраняем обработанное изображение
-                worker.setCurrentImage(processed_image);
-                std::string processed_path = output_dir + "worker_processed.bmp";
-                worker.saveImage(processed_path);
-                std::cout << "Processed saved: " << processed_path << std::endl;
-                
-                // 4. Объединяем исходное и обработанное изображения
-                std::cout << "Creating combined image..." << std::endl;
-                cv::Mat combined_image = combineImagesSideBySide(original_image, processed_image);
-                
-                worker.setCurrentImage(combined_image);
-                std::string combined_path = output_dir + "worker_combined.bmp";
-                worker.saveImage(combined_path);
-                
-                std::cout << "Combined image created: " 
-                          << combined_image.cols << "x" << combined_image.rows
-                          << ", saved: " << combined_path << std::endl;
-                
-                // 5. Отправляем обработанное изображение обратно серверу
-                std::cout << "Sending processed image to server..." << std::endl;
-                worker.sendImage(combined_image);
-                
-                // 6. Ждем подтверждение от сервера
-                std::string ack = worker.receiveMessage();
-                if (ack == "DONE") {
-                    std::cout << "Server confirmed completion" << std::endl;
+                std::cout << "Quantization levels: " << effect.quantization_levels
+                          << ", Canny: " << effect.canny_low << "/" << effect.canny_high << std::endl;
+            } else {
+                std::cout << "Applying filter graph..." << std::endl;
+            }
+            
+            cv::Mat processed_image;
+            {
+                ScopedTimer timer(process_time);
+                uint64_t effect_begin_us = traceNowUs();
+                if (graph.empty()) {
+                    processed_image = applyEffect(original_image, effect.quantization_levels,
+                                                  effect.canny_low, effect.canny_high, &effect_pool);
                 } else {
-                    std::cout << "Server response: " << ack << std::endl;
+                    graph.run(original_image, processed_image, &effect_pool);
+                }
+                trace.addSpan(TraceStage::Effect, effect_begin_us, traceNowUs());
+            }
+            processed_frames.add();
+            
+            // Сверка с эталоном имеет смысл только для встроенного эффекта
+            if (graph.empty() && effect.verify_effect_every > 0
+                && processed_frames.get() % effect.verify_effect_every == 0) {
+                int differ = verifyEffect(original_image, processed_image, effect.quantization_levels,
+                                          effect.canny_low, effect.canny_high);
+                if (differ != 0) {
+                    effect_mismatches.add();
+                    std::cout << "- [FAIL] Effect differs from reference: " << differ << " bytes" << std::endl;
                 }
+            }
+            
+            std::cout << "Processing completed. Result: " 
+                      << processed_image.cols << "x" << processed_image.rows 
+                      << ", channels: " << processed_image.channels() << std::endl;
+            
+            // Сохраняем обработанное изображение
+            std::string processed_path = output_dir + "worker_processed.bmp";
+            worker.saveImage(processed_image, processed_path);
+            std::cout << "Processed saved: " << processed_path << std::endl;
+            
+            // 4. Объединяем исходное и обработанное изображения
+            std::cout << "Creating combined image..." << std::endl;
+            cv::Mat combined_image = combineImagesSideBySide(original_image, processed_image);
+            
+            std::string combined_path = output_dir + "worker_combined.bmp";
+            worker.saveImage(combined_image, combined_path);
+            
+            std::cout << "Combined image created: " 
+                      << combined_image.cols << "x" << combined_image.rows
+                      << ", saved: " << combined_path << std::endl;
+            
+            // 5. Отправляем обработанное изображение обратно серверу
+            std::cout << "Sending processed image to server..." << std::endl;
+            trace.addSpan(TraceStage::Worker, received_us, traceNowUs());
+            worker.sendImage(combined_image, worker.getLastFrameId(), trace); // Номер кадра и трасса сохраняются для сервера
+            
+            // 6. Ждем подтверждение от сервера
+            std::string ack = worker.receiveMessage();
+            if (ack == "DONE") {
+                std::cout << "Server confirmed completion" << std::endl;
             } else {
-                std::cout << "Received empty image from server" << std::endl;
+                std::cout << "Server response: " << ack << std::endl;
             }
         } else {
-            std::cout << "Failed to connect to server" << std::endl;
+            std::cout << "Received empty image from server" << std::endl;
         }
         
         std::cout << "=== Worker cycle completed ===" << std::endl;